@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "utils/strings.h"
+
+// Helpers shared by the benchmark programs. See `benchmarks/README.md` for how to build them.
+
+namespace Benchmark
+{
+    // Runs `func` `repeat` times and returns the best time, in seconds.
+    template <typename F> [[nodiscard]] double Measure(int repeat, F &&func)
+    {
+        double best = 0;
+        for (int i = 0; i < repeat; i++)
+        {
+            auto begin = std::chrono::steady_clock::now();
+            func();
+            double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            best = i == 0 ? time : std::min(best, time);
+        }
+        return best;
+    }
+
+    // Prevents the compiler from optimizing away the computation of `value`.
+    template <typename T> void Use(const T &value)
+    {
+        asm volatile("" : : "g"(&value) : "memory");
+    }
+
+    // Prints a message and exits with a non-zero status if `condition` is false.
+    template <typename ...P> void Check(bool condition, const P &... params)
+    {
+        if (condition)
+            return;
+        std::fprintf(stderr, "Check failed: %s\n", Str(params...).c_str());
+        std::exit(1);
+    }
+
+    inline void Print(const std::string &name, double seconds, const std::string &extra = "")
+    {
+        std::printf("%-48s %10.3f ms%s%s\n", name.c_str(), seconds * 1000, extra.empty() ? "" : "  ", extra.c_str());
+    }
+
+    // A deterministic random number generator (splitmix64), so the results don't depend on the standard library.
+    class Random
+    {
+        uint64_t state = 0;
+
+      public:
+        Random(uint64_t seed = 0) : state(seed) {}
+
+        uint64_t operator()()
+        {
+            uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+
+        // Returns a value in `[min, max]`.
+        int Int(int min, int max)
+        {
+            return min + int((*this)() % uint64_t(max - min + 1));
+        }
+    };
+}
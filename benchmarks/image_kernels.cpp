@@ -0,0 +1,148 @@
+// Measures `Graphics::ImageKernels` with each instruction set on atlas-sized images, and checks that all instruction sets give bit-identical results.
+// Usage: `image_kernels [image_size]`. The default size is 2048, i.e. 2048x2048 pixels.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include "benchmark.h"
+#include "graphics/image_kernels.h"
+
+namespace
+{
+    namespace IK = Graphics::ImageKernels;
+
+    constexpr IK::Isa all_isas[] = {IK::Isa::scalar, IK::Isa::sse2, IK::Isa::avx2};
+
+    // A kernel reads from `src` and `gray_src`, and writes to `dst` and `gray_dst`. `dst` is reset to `dst_init` before each call.
+    struct Buffers
+    {
+        std::vector<u8vec4> src, dst_init, dst;
+        std::vector<uint8_t> gray_src, gray_dst;
+    };
+
+    struct Kernel
+    {
+        const char *name = nullptr;
+        std::function<void(Buffers &buffers, std::size_t offset, std::size_t count)> func;
+    };
+
+    const std::vector<Kernel> kernels = {
+        {"Fill",          [](Buffers &b, std::size_t o, std::size_t n){IK::Fill(b.dst.data() + o, n, u8vec4(12, 34, 56, 78));}},
+        {"Copy",          [](Buffers &b, std::size_t o, std::size_t n){IK::Copy(b.dst.data() + o, b.src.data() + o, n);}},
+        {"Blend",         [](Buffers &b, std::size_t o, std::size_t n){IK::Blend(b.dst.data() + o, b.src.data() + o, n);}},
+        {"Premultiply",   [](Buffers &b, std::size_t o, std::size_t n){IK::Premultiply(b.dst.data() + o, n);}},
+        {"Unpremultiply", [](Buffers &b, std::size_t o, std::size_t n){IK::Unpremultiply(b.dst.data() + o, n);}},
+        {"GrayToRgba",    [](Buffers &b, std::size_t o, std::size_t n){IK::GrayToRgba(b.dst.data() + o, b.gray_src.data() + o, n);}},
+        {"AlphaToRgba",   [](Buffers &b, std::size_t o, std::size_t n){IK::AlphaToRgba(b.dst.data() + o, b.gray_src.data() + o, n);}},
+        {"RgbaToGray",    [](Buffers &b, std::size_t o, std::size_t n){IK::RgbaToGray(b.gray_dst.data() + o, b.src.data() + o, n);}},
+    };
+
+    // Random pixels, with a lot of fully transparent and fully opaque ones, since the kernels often treat those specially.
+    [[nodiscard]] Buffers MakeBuffers(std::size_t count, uint64_t seed)
+    {
+        Benchmark::Random random(seed);
+        auto RandomPixel = [&]
+        {
+            int alpha_kind = random.Int(0, 3);
+            int alpha = alpha_kind == 0 ? 0 : alpha_kind == 1 ? 255 : random.Int(0, 255);
+            return u8vec4(random.Int(0, 255), random.Int(0, 255), random.Int(0, 255), alpha);
+        };
+
+        Buffers ret;
+        ret.src.resize(count);
+        ret.dst_init.resize(count);
+        ret.gray_src.resize(count);
+        for (std::size_t i = 0; i < count; i++)
+        {
+            ret.src[i] = RandomPixel();
+            ret.dst_init[i] = RandomPixel();
+            ret.gray_src[i] = random.Int(0, 255);
+        }
+        ret.dst = ret.dst_init;
+        ret.gray_dst.assign(count, 0);
+        return ret;
+    }
+
+    void Reset(Buffers &buffers)
+    {
+        buffers.dst = buffers.dst_init;
+        std::fill(buffers.gray_dst.begin(), buffers.gray_dst.end(), 0);
+    }
+
+    [[nodiscard]] bool SameOutput(const Buffers &a, const Buffers &b)
+    {
+        return std::memcmp(a.dst.data(), b.dst.data(), a.dst.size() * sizeof(u8vec4)) == 0 && a.gray_dst == b.gray_dst;
+    }
+
+    // Runs every kernel on every instruction set, for all small sizes and offsets (to cover the unaligned heads and the tails), and compares the results with scalar.
+    void CheckIdentical()
+    {
+        Buffers buffers = MakeBuffers(256, 1);
+
+        for (const Kernel &kernel : kernels)
+        {
+            for (std::size_t offset = 0; offset < 8; offset++)
+            for (std::size_t count = 0; count <= 150; count++)
+            {
+                Reset(buffers);
+                IK::SetIsa(IK::Isa::scalar);
+                kernel.func(buffers, offset, count);
+                Buffers expected = buffers;
+
+                for (IK::Isa isa : all_isas)
+                {
+                    IK::SetIsa(isa);
+                    Reset(buffers);
+                    kernel.func(buffers, offset, count);
+                    Benchmark::Check(SameOutput(buffers, expected), kernel.name, " with ", IK::IsaName(IK::CurrentIsa()), " differs from scalar, offset ", offset, ", count ", count, ".");
+                }
+            }
+        }
+
+        std::printf("All instruction sets give the same results as scalar. The best supported one is %s.\n", IK::IsaName(IK::BestSupportedIsa()));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int size = argc > 1 ? std::atoi(argv[1]) : 2048;
+
+    CheckIdentical();
+
+    std::size_t count = std::size_t(size) * size;
+    Buffers buffers = MakeBuffers(count, 2);
+    double megapixels = count / 1e6;
+    std::printf("Image size: %dx%d\n", size, size);
+
+    for (const Kernel &kernel : kernels)
+    {
+        Buffers expected;
+        for (IK::Isa isa : all_isas)
+        {
+            IK::SetIsa(isa);
+            if (IK::CurrentIsa() != isa)
+                continue; // Not supported on this CPU.
+
+            double time = 0;
+            for (int i = 0; i < 5; i++)
+            {
+                Reset(buffers);
+                double this_time = Benchmark::Measure(1, [&]{kernel.func(buffers, 0, count);});
+                time = i == 0 ? this_time : std::min(time, this_time);
+            }
+
+            if (isa == IK::Isa::scalar)
+                expected = buffers;
+            else
+                Benchmark::Check(SameOutput(buffers, expected), kernel.name, " with ", IK::IsaName(isa), " differs from scalar on the large image.");
+
+            Benchmark::Print(Str(kernel.name, ", ", IK::IsaName(isa)), time, Str(int(megapixels / time), " Mpx/s"));
+        }
+    }
+
+    IK::SetIsa(IK::BestSupportedIsa());
+}
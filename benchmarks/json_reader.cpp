@@ -0,0 +1,215 @@
+// Compares `JsonReader` against `Json` on a large generated document, and checks that the chunk size doesn't affect the results.
+// Usage: `json_reader [size_in_mb]`. The default size is 100 MB.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "benchmark.h"
+#include "utils/json.h"
+#include "utils/json_reader.h"
+
+namespace
+{
+    // Generates a document that resembles a large Tiled map: a few small fields, big arrays of tile numbers, and a lot of objects.
+    [[nodiscard]] std::string GenerateDocument(std::size_t target_size, uint64_t seed)
+    {
+        Benchmark::Random random(seed);
+        std::string ret = "{\n    \"name\": \"generated\",\n    \"version\": 1.5,\n    \"layers\": [";
+
+        for (int layer = 0; ret.size() < target_size / 2; layer++)
+        {
+            if (layer != 0)
+                ret += ',';
+            ret += Str("\n        {\"name\": \"layer ", layer, "\", \"visible\": ", layer % 2 ? "true" : "false", ", \"width\": 256, \"height\": 256, \"data\": [");
+            for (int i = 0; i < 256 * 256; i++)
+            {
+                if (i != 0)
+                    ret += ',';
+                ret += Str(random.Int(0, 3) == 0 ? 0 : random.Int(1, 4000));
+            }
+            ret += "]}";
+        }
+
+        ret += "\n    ],\n    \"objects\": [";
+        for (int object = 0; ret.size() < target_size; object++)
+        {
+            if (object != 0)
+                ret += ',';
+            ret += Str("\n        {\"id\": ", object, ", \"x\": ", random.Int(-100000, 100000) / 8.0, ", \"y\": ", random.Int(-100000, 100000) / 8.0,
+                       ", \"text\": \"Object \\\"", object, "\\\" \\u00e9\\n\", \"tags\": [\"a\", \"b\", {\"nested\": [[], {}, null]}], \"extra\": null}");
+        }
+        ret += "\n    ]\n}\n";
+        return ret;
+    }
+
+    // A reader that returns the input in chunks of the specified size, to exercise the chunk boundaries.
+    [[nodiscard]] JsonReader MakeChunkedReader(std::string_view text, std::size_t chunk_size)
+    {
+        return JsonReader([text, pos = std::size_t(0)](char *buffer, std::size_t size) mutable -> std::size_t
+        {
+            size = std::min(size, text.size() - pos);
+            std::memcpy(buffer, text.data() + pos, size);
+            pos += size;
+            return size;
+        }, 64, chunk_size);
+    }
+
+    // Converts every token to a string, for comparison. If `skip_data` is true, the values of the `data` keys are skipped.
+    [[nodiscard]] std::vector<std::string> ReadAllTokens(JsonReader &reader, bool skip_data)
+    {
+        std::vector<std::string> ret;
+        while (true)
+        {
+            JsonReader::token_t token = reader.Next();
+            switch (token)
+            {
+              case JsonReader::null:         ret.push_back("null"); break;
+              case JsonReader::boolean:      ret.push_back(reader.GetBool() ? "true" : "false"); break;
+              case JsonReader::num_int:      ret.push_back(Str("i", reader.GetInt())); break;
+              case JsonReader::num_real:     ret.push_back(Str("r", Str(reader.GetReal()))); break;
+              case JsonReader::string:       ret.push_back(Str("s", reader.GetStringView())); break;
+              case JsonReader::begin_array:  ret.push_back("["); break;
+              case JsonReader::end_array:    ret.push_back("]"); break;
+              case JsonReader::begin_object: ret.push_back("{"); break;
+              case JsonReader::end_object:   ret.push_back("}"); break;
+              case JsonReader::key:
+                ret.push_back(Str("k", reader.GetStringView()));
+                if (skip_data && reader.GetStringView() == "data")
+                {
+                    reader.SkipValue();
+                    ret.push_back(Str("skipped to ", reader.Offset()));
+                }
+                break;
+              case JsonReader::end:
+                return ret;
+            }
+        }
+    }
+
+    void CheckChunkSizes()
+    {
+        std::string text = GenerateDocument(1 << 16, 1);
+
+        for (bool skip_data : {false, true})
+        {
+            JsonReader reference_reader = JsonReader::FromString(text);
+            std::vector<std::string> reference = ReadAllTokens(reference_reader, skip_data);
+
+            for (std::size_t chunk_size = 1; chunk_size <= 4096; chunk_size = chunk_size < 64 ? chunk_size + 1 : chunk_size * 2 + 1)
+            {
+                JsonReader reader = MakeChunkedReader(text, chunk_size);
+                Benchmark::Check(ReadAllTokens(reader, skip_data) == reference, "Chunk size ", chunk_size, (skip_data ? " with skipping" : ""), " gives different tokens.");
+            }
+        }
+
+        std::printf("Chunk sizes 1..64 and up to 4 KB give the same tokens as the in-memory reader, with and without skipping.\n");
+    }
+
+    // Reads every token, without storing anything.
+    [[nodiscard]] std::size_t CountTokens(JsonReader &reader)
+    {
+        std::size_t count = 0;
+        while (reader.Next() != JsonReader::end)
+            count++;
+        return count;
+    }
+
+    // Reads the layer names and skips everything else.
+    [[nodiscard]] std::size_t ReadLayerNames(JsonReader &reader)
+    {
+        std::size_t total_length = 0;
+        reader.Expect(JsonReader::begin_object);
+        while (reader.Next() == JsonReader::key)
+        {
+            if (reader.GetStringView() != "layers")
+            {
+                reader.SkipValue();
+                continue;
+            }
+
+            reader.Expect(JsonReader::begin_array);
+            while (reader.Next() == JsonReader::begin_object)
+            {
+                while (reader.Next() == JsonReader::key)
+                {
+                    if (reader.GetStringView() == "name")
+                        total_length += reader.ReadStringView().size();
+                    else
+                        reader.SkipValue();
+                }
+            }
+        }
+        return total_length;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::size_t size_mb = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100;
+
+    CheckChunkSizes();
+
+    std::string text = GenerateDocument(size_mb << 20, 2);
+    double mb = text.size() / double(1 << 20);
+    std::printf("Document size: %.1f MB\n", mb);
+
+    auto Throughput = [&](double seconds) {return Str(int(mb / seconds), " MB/s");};
+
+    const std::string file_name = "json_reader_benchmark.tmp.json";
+    {
+        FILE *file = std::fopen(file_name.c_str(), "wb");
+        Benchmark::Check(file && std::fwrite(text.data(), 1, text.size(), file) == text.size(), "Unable to write `", file_name, "`.");
+        std::fclose(file);
+    }
+
+    std::size_t token_count = 0;
+    double time = Benchmark::Measure(3, [&]
+    {
+        Json json(text, 64);
+        Benchmark::Use(json);
+    });
+    Benchmark::Print("Json, the whole document", time, Throughput(time));
+
+    time = Benchmark::Measure(3, [&]
+    {
+        JsonReader reader = JsonReader::FromString(text);
+        token_count = CountTokens(reader);
+    });
+    Benchmark::Print("JsonReader, from memory, every token", time, Throughput(time) + Str(", ", token_count, " tokens"));
+
+    time = Benchmark::Measure(3, [&]
+    {
+        JsonReader reader = MakeChunkedReader(text, JsonReader::default_chunk_size);
+        Benchmark::Check(CountTokens(reader) == token_count, "Chunked reader gives a different token count.");
+    });
+    Benchmark::Print("JsonReader, 64 KB chunks, every token", time, Throughput(time));
+
+    time = Benchmark::Measure(3, [&]
+    {
+        JsonReader reader = JsonReader::FromFile(file_name);
+        Benchmark::Check(CountTokens(reader) == token_count, "File reader gives a different token count.");
+    });
+    Benchmark::Print("JsonReader, from file, every token", time, Throughput(time));
+
+    std::size_t name_length = 0;
+    time = Benchmark::Measure(3, [&]
+    {
+        JsonReader reader = JsonReader::FromString(text);
+        name_length = ReadLayerNames(reader);
+    });
+    Benchmark::Print("JsonReader, from memory, layer names only", time, Throughput(time));
+
+    time = Benchmark::Measure(3, [&]
+    {
+        JsonReader reader = JsonReader::FromFile(file_name);
+        Benchmark::Check(ReadLayerNames(reader) == name_length, "File reader gives different layer names.");
+    });
+    Benchmark::Print("JsonReader, from file, layer names only", time, Throughput(time));
+
+    std::remove(file_name.c_str());
+}
@@ -0,0 +1,163 @@
+// Compares the skyline packer from `utils/packing.h` against `stb_rect_pack`, which `Packing::PackRects()` used before, on 10k-100k glyph-sized rectangles.
+// For each packer, measures the time to pack into a fixed box, and the smallest square box that fits everything. Also checks that the results don't overlap.
+// Usage: `packing`.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#define STB_RECT_PACK_IMPLEMENTATION
+#include <stb_rect_pack.h>
+
+#include "benchmark.h"
+#include "utils/packing.h"
+
+namespace
+{
+    constexpr int gaps = 1; // Same as in font atlases.
+
+    // `Packing::PackRects()` as it was implemented before, on top of `stb_rect_pack`.
+    int StbPackRects(ivec2 target_size, Packing::Rect *data, int count, int inner_gaps)
+    {
+        target_size += inner_gaps;
+
+        std::vector<stbrp_rect> rects(count);
+        for (int i = 0; i < count; i++)
+        {
+            ivec2 rect_size = data[i].size + inner_gaps;
+            rects[i].w = rect_size.x;
+            rects[i].h = rect_size.y;
+        }
+
+        auto nodes = std::make_unique<stbrp_node[]>(target_size.x);
+        stbrp_context context;
+        stbrp_init_target(&context, target_size.x, target_size.y, nodes.get(), target_size.x);
+        bool ok = stbrp_pack_rects(&context, rects.data(), rects.size());
+
+        for (int i = 0; i < count; i++)
+        {
+            data[i].pos = ivec2(rects[i].x, rects[i].y);
+            data[i].was_packed = rects[i].was_packed;
+        }
+        return ok ? 0 : std::count_if(rects.begin(), rects.end(), [](const stbrp_rect &rect){return !rect.was_packed;});
+    }
+
+    int NativePackRects(ivec2 target_size, Packing::Rect *data, int count, int inner_gaps)
+    {
+        return Packing::PackRects(target_size, data, count, inner_gaps);
+    }
+
+    // Sizes similar to glyphs of several fonts: mostly small, some large.
+    [[nodiscard]] std::vector<Packing::Rect> GenerateRects(int count)
+    {
+        Benchmark::Random random(count);
+        std::vector<Packing::Rect> ret;
+        ret.reserve(count);
+        for (int i = 0; i < count; i++)
+        {
+            int height = random.Int(0, 9) == 0 ? random.Int(24, 64) : random.Int(6, 24);
+            ret.emplace_back(ivec2(random.Int(height / 3, height), height));
+        }
+        return ret;
+    }
+
+    // Checks that all rectangles are packed, in bounds, and don't overlap (including the gaps).
+    void CheckPacking(const char *packer_name, ivec2 target_size, const std::vector<Packing::Rect> &rects)
+    {
+        std::vector<bool> used(target_size.prod());
+        for (const Packing::Rect &rect : rects)
+        {
+            Benchmark::Check(rect.was_packed, packer_name, ": a rectangle wasn't packed.");
+            Benchmark::Check((rect.pos >= 0).all() && (rect.pos + rect.size <= target_size).all(), packer_name, ": a rectangle is out of bounds.");
+            ivec2 end = min(rect.pos + rect.size + gaps, target_size);
+            for (int y = rect.pos.y; y < end.y; y++)
+            for (int x = rect.pos.x; x < end.x; x++)
+            {
+                Benchmark::Check(!used[y * target_size.x + x], packer_name, ": rectangles overlap at ", x, ',', y, '.');
+                used[y * target_size.x + x] = true;
+            }
+        }
+    }
+
+    // Returns the side of the smallest square box that fits all rectangles, using a binary search.
+    template <typename F> [[nodiscard]] int SmallestSquare(const std::vector<Packing::Rect> &rects, F &&pack)
+    {
+        long long area = 0;
+        for (const Packing::Rect &rect : rects)
+            area += (rect.size + gaps).prod();
+
+        int low = std::sqrt(area), high = low * 2; // `low` never fits, unless there's no waste at all. `high` always fits.
+        while (high - low > 1)
+        {
+            int mid = (low + high) / 2;
+            std::vector<Packing::Rect> copy = rects;
+            if (pack(ivec2(mid), copy.data(), copy.size(), gaps) == 0)
+                high = mid;
+            else
+                low = mid;
+        }
+        return high;
+    }
+
+    void Measure(int count)
+    {
+        std::vector<Packing::Rect> rects = GenerateRects(count);
+
+        long long area = 0;
+        for (const Packing::Rect &rect : rects)
+            area += (rect.size + gaps).prod();
+        ivec2 box_size(std::sqrt(area * 1.2)); // Leave some space, so that both packers succeed.
+        Benchmark::Check((box_size <= 0xffff).all(), "The box is too large for `stb_rect_pack`.");
+
+        std::printf("%d rectangles, box %dx%d:\n", count, box_size.x, box_size.y);
+
+        auto MeasurePacker = [&](const char *packer_name, auto &&pack)
+        {
+            std::vector<Packing::Rect> result;
+            double time = Benchmark::Measure(3, [&]
+            {
+                result = rects;
+                Benchmark::Check(pack(box_size, result.data(), result.size(), gaps) == 0, packer_name, ": packing failed.");
+            });
+            CheckPacking(packer_name, box_size, result);
+
+            int side = SmallestSquare(rects, pack);
+            Benchmark::Print(Str("  ", packer_name), time, Str("smallest square box: ", side, "x", side, ", ", int(area * 100 / (side * (long long)side)), "% used"));
+        };
+
+        MeasurePacker("stb_rect_pack", StbPackRects);
+        MeasurePacker("Packing::PackRects", NativePackRects);
+
+        // Online insertion into several pages, in the original order.
+        ivec2 page_size(1024);
+        Packing::MultiPagePacker packer;
+        std::vector<Packing::Rect> result;
+        double time = Benchmark::Measure(3, [&]
+        {
+            packer = Packing::MultiPagePacker(page_size, gaps);
+            result = rects;
+            for (Packing::Rect &rect : result)
+                Benchmark::Check(packer.Insert(rect), "MultiPagePacker: insertion failed.");
+        });
+        Benchmark::Print("  MultiPagePacker, one at a time", time, Str(packer.PageCount(), " pages of ", page_size.x, "x", page_size.y, ", ",
+            int(area * 100 / (page_size.prod() * (long long)packer.PageCount())), "% used"));
+
+        // Free every other rectangle and insert them again, which reuses the freed regions.
+        time = Benchmark::Measure(1, [&]
+        {
+            for (std::size_t i = 0; i < result.size(); i += 2)
+                packer.Free(result[i]);
+            for (std::size_t i = 0; i < result.size(); i += 2)
+                Benchmark::Check(packer.Insert(result[i]), "MultiPagePacker: reinsertion failed.");
+        });
+        Benchmark::Print("  MultiPagePacker, free and reinsert half", time, Str(packer.PageCount(), " pages"));
+    }
+}
+
+int main()
+{
+    for (int count : {10'000, 30'000, 100'000})
+        Measure(count);
+}
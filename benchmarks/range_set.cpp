@@ -0,0 +1,174 @@
+// Checks `RangeSet` with every storage against `std::set` on random data, then measures `Add()`, `Contains()`, set operations and iteration for each storage.
+// Usage: `range_set [iterations]`. The default is 2000 iterations of the randomized comparison.
+
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "benchmark.h"
+#include "utils/range_set.h"
+
+namespace
+{
+    using Ranges = std::vector<std::pair<int, int>>;
+
+    [[nodiscard]] Ranges ReferenceRanges(const std::set<int> &set)
+    {
+        Ranges ret;
+        for (int value : set)
+        {
+            if (ret.size() > 0 && ret.back().second + 1 == value)
+                ret.back().second = value;
+            else
+                ret.emplace_back(value, value);
+        }
+        return ret;
+    }
+
+    template <template <typename> typename Storage> void CheckStorage(const char *storage_name, int iterations)
+    {
+        Benchmark::Random random(1);
+
+        for (int iteration = 0; iteration < iterations; iteration++)
+        {
+            int max_value = random.Int(50, 3000);
+            RangeSet<int, Storage> set, other;
+            std::set<int> reference, other_reference;
+
+            // Mostly short ranges, so that they get merged often.
+            auto RandomRange = [&]
+            {
+                int first = random.Int(0, max_value);
+                int length = random.Int(0, 3) == 0 ? random.Int(0, 40) : random.Int(0, 2);
+                return std::pair<int, int>(first, std::min(first + length, max_value));
+            };
+
+            int count = random.Int(0, 400);
+            for (int i = 0; i < count; i++)
+            {
+                auto [first, last] = RandomRange();
+                set.Add(first, last);
+                for (int value = first; value <= last; value++)
+                    reference.insert(value);
+
+                Benchmark::Check(set.Ranges() == ReferenceRanges(reference), storage_name, ": `Add()` gives wrong ranges.");
+                Benchmark::Check(set.ValueCount() == int(reference.size()), storage_name, ": `ValueCount()` is wrong.");
+                Benchmark::Check(set.RangeCount() == int(ReferenceRanges(reference).size()), storage_name, ": `RangeCount()` is wrong.");
+
+                auto [other_first, other_last] = RandomRange();
+                other.Add(other_first, other_last);
+                for (int value = other_first; value <= other_last; value++)
+                    other_reference.insert(value);
+            }
+
+            for (int value = -1; value <= max_value + 1; value++)
+                Benchmark::Check(set.Contains(value) == bool(reference.count(value)), storage_name, ": `Contains(", value, ")` is wrong.");
+
+            std::set<int> union_reference = reference, intersection_reference, difference_reference;
+            union_reference.insert(other_reference.begin(), other_reference.end());
+            for (int value : reference)
+                (other_reference.count(value) ? intersection_reference : difference_reference).insert(value);
+
+            // Mix the storages, since the operators accept any storage on the right.
+            RangeSet<int> other_map = RangeSet<int>::FromSorted(other.Ranges());
+            Benchmark::Check((set + other_map).Ranges() == ReferenceRanges(union_reference), storage_name, ": union is wrong.");
+            Benchmark::Check((set & other).Ranges() == ReferenceRanges(intersection_reference), storage_name, ": intersection is wrong.");
+            Benchmark::Check((set - other).Ranges() == ReferenceRanges(difference_reference), storage_name, ": difference is wrong.");
+            Benchmark::Check((set - other).ValueCount() == int(difference_reference.size()), storage_name, ": `ValueCount()` after difference is wrong.");
+
+            RangeSet<int, Storage> copy = set;
+            copy += other;
+            copy -= set;
+            std::set<int> copy_reference;
+            for (int value : union_reference)
+            {
+                if (!reference.count(value))
+                    copy_reference.insert(value);
+            }
+            Benchmark::Check(copy.Ranges() == ReferenceRanges(copy_reference), storage_name, ": compound assignment is wrong.");
+
+            // Unsorted and overlapping input.
+            Ranges shuffled = (set + other).Ranges();
+            for (std::size_t i = shuffled.size(); i > 1; i--)
+                std::swap(shuffled[i - 1], shuffled[random() % i]);
+            if (shuffled.size() > 0)
+                shuffled.push_back(shuffled.front());
+            Benchmark::Check(RangeSet<int, Storage>::FromSorted(shuffled).Ranges() == ReferenceRanges(union_reference), storage_name, ": `FromSorted()` is wrong.");
+        }
+
+        // Ranges ending at the max value of the type.
+        RangeSet<unsigned char, Storage> full{{250, 255}, {0, 2}, {3, 3}};
+        int value_count = 0;
+        full.ForEachValue([&](unsigned char){value_count++;});
+        Benchmark::Check(value_count == 10 && full.RangeCount() == 2, storage_name, ": `ForEachValue()` is wrong near the max value.");
+
+        std::printf("%s: matches std::set in %d random iterations.\n", storage_name, iterations);
+    }
+
+    template <template <typename> typename Storage> void MeasureStorage(const char *storage_name, int insert_count)
+    {
+        constexpr int max_value = 10'000'000;
+
+        Benchmark::Random random(2);
+        std::vector<int> values(insert_count);
+        for (int &value : values)
+            value = random.Int(0, max_value);
+
+        RangeSet<int, Storage> set;
+        double time = Benchmark::Measure(3, [&]
+        {
+            set.Clear();
+            for (int value : values)
+                set.Add(value, value + 2);
+        });
+        Benchmark::Print(Str(storage_name, ", ", insert_count, " random `Add()`s"), time, Str(set.RangeCount(), " ranges"));
+
+        int found = 0;
+        time = Benchmark::Measure(3, [&]
+        {
+            found = 0;
+            for (int value : values)
+                found += set.Contains(value + 3);
+        });
+        Benchmark::Print(Str(storage_name, ", ", insert_count, " `Contains()`"), time, Str(found, " found"));
+
+        RangeSet<int, Storage> other = RangeSet<int, Storage>::FromSorted(set.Ranges());
+        other.Add(0, max_value / 2);
+        time = Benchmark::Measure(3, [&]
+        {
+            Benchmark::Use(set + other);
+            Benchmark::Use(set & other);
+            Benchmark::Use(set - other);
+        });
+        Benchmark::Print(Str(storage_name, ", union + intersection + difference"), time);
+
+        long long sum = 0;
+        time = Benchmark::Measure(3, [&]
+        {
+            sum = 0;
+            set.ForEachRange([&](int first, int last){sum += last - first;});
+        });
+        Benchmark::Print(Str(storage_name, ", `ForEachRange()`"), time);
+        Benchmark::Use(sum);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 2000;
+
+    CheckStorage<RangeSetStorage::Map>("Map", iterations);
+    CheckStorage<RangeSetStorage::Vector>("Vector", iterations);
+    CheckStorage<RangeSetStorage::BTree>("BTree", iterations);
+
+    for (int insert_count : {10'000, 300'000})
+    {
+        MeasureStorage<RangeSetStorage::Map>("Map", insert_count);
+        if (insert_count <= 10'000) // `Add()` is linear for this storage.
+            MeasureStorage<RangeSetStorage::Vector>("Vector", insert_count);
+        MeasureStorage<RangeSetStorage::BTree>("BTree", insert_count);
+    }
+}
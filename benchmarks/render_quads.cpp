@@ -0,0 +1,70 @@
+// Measures the CPU-side cost of submitting a quad to `Render`: building 4 vertices in `Quad_t::~Quad_t()` and `RenderQueue::Add()`,
+// against filling a single `QuadInstance` and `InstanceQueue::Add()` in the instanced mode.
+// The queues are large enough to hold all quads of one iteration, so the timed loops don't include uploads and draw calls.
+// Usage: `render_quads [quad_count]`. The default is 100000 quads. Needs a window with an OpenGL context.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+#include "benchmark.h"
+#include "gameutils/render.h"
+#include "graphics/complete.h"
+#include "interface/window.h"
+
+namespace
+{
+    struct QuadKind
+    {
+        const char *name = nullptr;
+        std::function<void(Render &render, int index)> func;
+    };
+
+    // Typical uses: glyphs of a text, colored rectangles, and rotated sprites.
+    const std::vector<QuadKind> quad_kinds = {
+        {"Textured (glyph)",  [](Render &r, int i){r.iquad(ivec2(i % 1000, i / 1000 % 1000), ivec2(8, 12)).tex(ivec2(i % 100 * 8, 0)).color(fvec3(1)).mix(0);}},
+        {"Colored",           [](Render &r, int i){r.iquad(ivec2(i % 1000, i / 1000 % 1000), ivec2(16)).color(fvec3(0.2f, 0.4f, 0.6f)).alpha(0.5f);}},
+        {"Textured, rotated", [](Render &r, int i){r.fquad(fvec2(i % 1000, i / 1000 % 1000), fvec2(32)).tex(fvec2(64, 0)).center().rotate(i * 0.01f);}},
+    };
+}
+
+int main(int argc, char **argv)
+{
+    int quad_count = argc > 1 ? std::atoi(argv[1]) : 100'000;
+
+    Interface::Window window("Render benchmark", ivec2(64));
+    Graphics::DummyVertexArray dummy_vao;
+    Render render(quad_count, Graphics::ShaderConfig::Core());
+    render.SetTextureSize(ivec2(1024));
+    render.BindShader();
+
+    std::printf("%d quads per iteration.\n", quad_count);
+
+    for (const QuadKind &kind : quad_kinds)
+    {
+        for (bool instanced : {false, true})
+        {
+            if (!render.SetInstancedQuads(instanced))
+            {
+                std::printf("Instancing is not supported.\n");
+                continue;
+            }
+
+            double time = 0;
+            for (int i = 0; i < 5; i++)
+            {
+                double this_time = Benchmark::Measure(1, [&]
+                {
+                    for (int j = 0; j < quad_count; j++)
+                        kind.func(render, j);
+                });
+                render.Finish(); // Not timed.
+                time = i == 0 ? this_time : std::min(time, this_time);
+            }
+
+            Benchmark::Print(Str(kind.name, instanced ? ", instanced" : ", vertices"), time, Str(time / quad_count * 1e9, " ns per quad"));
+        }
+    }
+}
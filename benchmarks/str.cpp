@@ -0,0 +1,93 @@
+// Compares `Str()` against `std::ostringstream`: checks that the results are the same, and counts heap allocations and time per call for typical calls.
+// Usage: `str [iterations]`. The default is 1000000 iterations per call.
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <string>
+
+#include "benchmark.h"
+#include "utils/strings.h"
+
+namespace
+{
+    std::size_t allocation_count = 0;
+}
+
+// Count every allocation in the program.
+void *operator new(std::size_t size)
+{
+    allocation_count++;
+    if (void *ret = std::malloc(size ? size : 1))
+        return ret;
+    throw std::bad_alloc{};
+}
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+void operator delete(void *ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+namespace
+{
+    template <typename ...P> [[nodiscard]] std::string StreamStr(const P &... params)
+    {
+        std::ostringstream stream;
+        (stream << ... << params);
+        return stream.str();
+    }
+
+    template <typename ...P> void CheckSame(const P &... params)
+    {
+        std::string expected = StreamStr(params...);
+        std::string result = Str(params...);
+        Benchmark::Check(result == expected, "`Str()` gives `", result, "` instead of `", expected, "`.");
+    }
+
+    // Prints the allocations and the time per call, for `Str()` and for the stream.
+    template <typename ...P> void Measure(const char *name, int iterations, const P &... params)
+    {
+        CheckSame(params...);
+
+        auto MeasureFunc = [&](auto &&func, const char *func_name)
+        {
+            std::size_t allocations = 0;
+            double time = Benchmark::Measure(3, [&]
+            {
+                std::size_t allocations_before = allocation_count;
+                for (int i = 0; i < iterations; i++)
+                    Benchmark::Use(func());
+                allocations = allocation_count - allocations_before;
+            });
+            std::printf("%-40s %8.1f ns, %.2f allocations per call\n", Str(name, ", ", func_name).c_str(), time / iterations * 1e9, double(allocations) / iterations);
+        };
+
+        MeasureFunc([&]{return Str(params...);}, "Str");
+        MeasureFunc([&]{return StreamStr(params...);}, "ostringstream");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 1'000'000;
+
+    // Make sure the output is the same as with a stream.
+    CheckSame(0, -1, 123456789, -2147483647 - 1, 18446744073709551615ull, (short)-5, (unsigned char)'x', (signed char)'y');
+    CheckSame(0.0, -0.0, 1.0, 0.1, 1.5, 123456.0, 1234567.0, 1e-5, 1e-4, 3.14159265358979, 1e100, -2.5e-300);
+    CheckSame(0.1f, 1e20f, 16777216.0f, 1.0L / 3);
+    CheckSame(true, false, 'a', "literal", std::string("string"), std::string_view("view"), (const char *)"pointer");
+    CheckSame(std::string(300, 'x'), 42, std::string(1000, 'y'));
+    std::printf("`Str()` matches `std::ostringstream`.\n");
+
+    // Typical per-frame calls: tab labels, a version string, an error message.
+    // Results up to 15 bytes fit into the small string buffer of libstdc++ and don't allocate at all.
+    Measure("Tab label, 8 bytes", iterations, std::string("a.gps"), "###", 3);
+    Measure("Tab label, 24 bytes", iterations, std::string("untitled model.gps"), "###", 12);
+    Measure("Version string", iterations, "Версия: ", 1, '.', 4, '.', 2);
+    Measure("Error message", iterations, "Unable to load font `", "assets/fonts/Roboto-Regular.ttf", "`, size ", 16, ".");
+    Measure("Long string (400 bytes)", iterations / 10, std::string(200, 'a'), 1.5, std::string(200, 'b'));
+}
@@ -6,11 +6,36 @@
 #define STBI_ASSERT(expr) DebugAssert("Somewhere in STB Image.", expr)
 #include <stb_image.h>
 
+#include <cstdlib>
+#include <zlib.h>
+
+namespace Graphics::Detail
+{
+    thread_local int png_compression_level = -1;
+
+    // Unlike the built-in compressor, this lets `Graphics::Image::Save()` choose the compression level per thread, and is faster too.
+    unsigned char *ZlibCompressForStbImageWrite(unsigned char *data, int data_len, int *out_len, int quality)
+    {
+        int level = png_compression_level >= 0 ? png_compression_level : quality;
+        if (level > 9)
+            level = 9;
+
+        uLongf size = compressBound(data_len);
+        unsigned char *ret = (unsigned char *)std::malloc(size); // `stb_image_write` frees this with `free()`.
+        if (!ret)
+            return 0;
+        if (compress2(ret, &size, data, data_len, level) != Z_OK)
+        {
+            std::free(ret);
+            return 0;
+        }
+        *out_len = size;
+        return ret;
+    }
+}
+
 #define STB_IMAGE_WRITE_IMPLEMENTATION
+#define STBIW_ZLIB_COMPRESS ::Graphics::Detail::ZlibCompressForStbImageWrite
 #define STBIW_ASSERT(expr) DebugAssert("Somewhere in STB Image Write.", expr)
 #include <stb_image_write.h>
 
-#define STB_RECT_PACK_IMPLEMENTATION
-#define STBRP_ASSERT(expr) DebugAssert("Somewhere in STB Rect Pack.", expr)
-#include <stb_rect_pack.h>
-
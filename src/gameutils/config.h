@@ -88,7 +88,7 @@ template <typename T> class Config
                 refl.for_each_field([&](auto index)
                 {
                     constexpr int i = index.value;
-                    DisplayGuiLow(refl.template field_value<i>(), refl.field_name(i));
+                    DisplayGuiLow(refl.template field_value<i>(), std::string(refl.field_name(i)));
                 });
                 ImGui::Unindent();
             }
@@ -199,7 +199,7 @@ template <typename T> class Config
             refl.for_each_field([&](auto index)
             {
                 constexpr int i = index.value;
-                DisplayGuiLow(refl.template field_value<i>(), refl.field_name(i));
+                DisplayGuiLow(refl.template field_value<i>(), std::string(refl.field_name(i)));
             });
             ImGui::PopItemWidth();
         }
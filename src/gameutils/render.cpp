@@ -1,6 +1,9 @@
 #include "render.h"
 
 #include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <vector>
 
 #include "graphics/complete.h"
 #include "reflection/complete.h"
@@ -48,16 +51,282 @@ void main()
     gl_FragColor.a *= v_factors.z;
 })";
 
-    Graphics::RenderQueue<Attribs, 3> queue = nullptr; // Note that the queue has to be the first field.
+    // For the instanced mode. Each quad is a single instance of a mesh made of 4 `QuadCorner`s.
+    ReflectStruct(QuadCorner, (
+        (fvec4)(corner), // One of the corners is set to 1, and others are set to 0.
+    ))
+
+    ReflectStruct(QuadInstance, (
+        (fvec2)(origin), // The position of the first corner.
+        (fvec2)(axis_x), // From the first corner to the second one.
+        (fvec2)(axis_y), // From the first corner to the fourth one.
+        (fvec4)(tex_rect), // Position and size.
+        (u8vec4)(color0),
+        (u8vec4)(color1),
+        (u8vec4)(color2),
+        (u8vec4)(color3),
+        // Those store a factor for each corner.
+        (u8vec4)(mix),
+        (u8vec4)(alpha),
+        (u8vec4)(beta),
+    ))
+
+    static constexpr const char *instanced_vertex_source = R"(
+varying vec4 v_color;
+varying vec2 v_texcoord;
+varying vec3 v_factors;
+void main()
+{
+    vec2 corner = vec2(a_corner.y + a_corner.z, a_corner.z + a_corner.w);
+    gl_Position = u_matrix * vec4(a_origin + a_axis_x * corner.x + a_axis_y * corner.y, 0, 1);
+    v_color     = mat4(a_color0, a_color1, a_color2, a_color3) * a_corner;
+    v_texcoord  = (a_tex_rect.xy + a_tex_rect.zw * corner) / u_tex_size;
+    v_factors   = vec3(dot(a_mix, a_corner), dot(a_alpha, a_corner), dot(a_beta, a_corner));
+})";
+
+    enum class Batch {none, triangles, quads, instanced_quads};
+
+    // Triangles, quads, and instanced quads go to separate queues. Quads only store 4 vertices each, and are drawn with a shared index buffer.
+    // Only one of the queues can be non-empty at a time, to preserve the draw order.
+    Graphics::RenderQueue<Attribs, 3> queue = nullptr;
+    Graphics::RenderQueue<Attribs, 4> quad_queue = nullptr;
     Uniforms uni;
     Graphics::Shader shader = nullptr;
 
-    Data(int queue_size, const Graphics::ShaderConfig &config) : queue(queue_size), shader("Main", config, Graphics::ShaderPreferences{}, Meta::tag<Attribs>{}, uni, vertex_source, fragment_source) {}
+    // Those are null if instancing is not supported.
+    Graphics::InstanceQueue<QuadCorner, QuadInstance> instance_queue = nullptr;
+    Uniforms instanced_uni;
+    Graphics::Shader instanced_shader = nullptr;
+
+    Batch batch = Batch::none;
+    bool instanced_quads = false;
+
+    struct State
+    {
+        int texture_unit = -1; // -1 means not set.
+        fvec2 tex_size = fvec2(0);
+        fmat4 matrix, color_matrix;
+
+        [[nodiscard]] static bool Equal(const fmat4 &a, const fmat4 &b)
+        {
+            return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w;
+        }
+
+        [[nodiscard]] bool operator==(const State &other) const
+        {
+            return texture_unit == other.texture_unit && tex_size == other.tex_size && Equal(matrix, other.matrix) && Equal(color_matrix, other.color_matrix);
+        }
+    };
+    State state; // The state set by the user.
+    std::optional<State> applied_state; // The state that's currently stored in the uniforms. Null if unknown.
+
+    // For the deferred mode.
+    struct Command
+    {
+        // From the high bits to the low bits: 16 bits of the layer, 2 bits of the batch type, 7 bits of the texture unit, and the state index.
+        uint64_t key = 0;
+        uint32_t first = 0; // Index of the first vertex in `command_vertices`, or the instance in `command_instances`.
+    };
+    bool deferred = false;
+    int layer = 0;
+    std::vector<State> command_states;
+    int command_state_index = -1; // Index of `state` in `command_states`, or -1 if it's not there yet.
+    std::vector<Command> commands;
+    std::vector<Attribs> command_vertices;
+    std::vector<QuadInstance> command_instances;
+
+    Stats stats;
+    int base_draw_call_count = 0;
+
+    Data(int queue_size, const Graphics::ShaderConfig &config) : queue(queue_size, Graphics::StreamingMode::automatic), quad_queue(queue_size, Graphics::StreamingMode::automatic), shader("Main", config, Graphics::ShaderPreferences{}, Meta::tag<Attribs>{}, uni, vertex_source, fragment_source)
+    {
+        if (Graphics::Extensions::InstancedArrays())
+        {
+            std::vector<QuadCorner> corners(4);
+            for (int i = 0; i < 4; i++)
+                corners[i].corner[i] = 1;
+            instance_queue = decltype(instance_queue)(Graphics::triangles, corners, {0, 1, 3, 3, 1, 2}, queue_size, Graphics::StreamingMode::automatic);
+            instanced_shader = Graphics::Shader("Main instanced", config, Graphics::ShaderPreferences{}, Meta::tag<Meta::type_list<QuadCorner, QuadInstance>>{}, instanced_uni, instanced_vertex_source, fragment_source);
+        }
+    }
+
+    void Flush()
+    {
+        switch (batch)
+        {
+          case Batch::none:
+            break;
+          case Batch::triangles:
+            queue.Flush();
+            break;
+          case Batch::quads:
+            quad_queue.Flush();
+            break;
+          case Batch::instanced_quads:
+            instance_queue.Flush();
+            break;
+        }
+        batch = Batch::none;
+    }
+
+    // Flushes the previous batch if it has a different type, and binds the appropriate shader.
+    void BeginBatch(Batch new_batch)
+    {
+        if (batch == new_batch)
+            return;
+        Flush();
+        batch = new_batch;
+        if (new_batch == Batch::instanced_quads)
+            instanced_shader.Bind();
+        else
+            shader.Bind();
+    }
+
+    [[nodiscard]] int DrawCallCount() const
+    {
+        return queue.DrawCallCount() + quad_queue.DrawCallCount() + instance_queue.DrawCallCount();
+    }
+
+    // Updates the uniforms that differ from `applied_state`. Flushes if there are any.
+    void ApplyState(const State &new_state)
+    {
+        bool force = !applied_state;
+        if (!force && new_state == *applied_state)
+            return;
+
+        Flush();
+        stats.state_changes++;
+
+        for (Uniforms *u : {&uni, &instanced_uni})
+        {
+            if (new_state.texture_unit != -1 && (force || new_state.texture_unit != applied_state->texture_unit))
+                u->texture.set(&new_state.texture_unit, 1);
+            if (force || new_state.tex_size != applied_state->tex_size)
+                u->tex_size = new_state.tex_size;
+            if (force || !State::Equal(new_state.matrix, applied_state->matrix))
+                u->matrix = new_state.matrix;
+            if (force || !State::Equal(new_state.color_matrix, applied_state->color_matrix))
+                u->color_matrix = new_state.color_matrix;
+        }
+
+        applied_state = new_state;
+    }
+
+    // Call this after modifying `state`.
+    void StateChanged()
+    {
+        if (deferred)
+            command_state_index = -1;
+        else
+            ApplyState(state);
+    }
+
+    void RecordCommand(Batch command_batch, uint32_t first)
+    {
+        if (command_state_index == -1)
+        {
+            // Reuse an existing state if possible, so that equivalent draws get the same key. There are usually only a few different states per frame.
+            auto it = std::find(command_states.begin(), command_states.end(), state);
+            command_state_index = it - command_states.begin();
+            if (it == command_states.end())
+                command_states.push_back(state);
+        }
+
+        Command &command = commands.emplace_back();
+        command.key = uint64_t(layer + 0x8000) << 48 | (uint64_t(command_batch) - 1) << 46 | uint64_t((state.texture_unit + 1) & 0x7f) << 39 | uint64_t(command_state_index);
+        command.first = first;
+        stats.draws++;
+    }
+
+    void AddTriangle(const Attribs (&vertices)[3])
+    {
+        if (deferred)
+        {
+            RecordCommand(Batch::triangles, command_vertices.size());
+            command_vertices.insert(command_vertices.end(), std::begin(vertices), std::end(vertices));
+            return;
+        }
+        BeginBatch(Batch::triangles);
+        queue.Add(vertices[0], vertices[1], vertices[2]);
+    }
+
+    void AddQuad(const Attribs (&vertices)[4])
+    {
+        if (deferred)
+        {
+            RecordCommand(Batch::quads, command_vertices.size());
+            command_vertices.insert(command_vertices.end(), std::begin(vertices), std::end(vertices));
+            return;
+        }
+        BeginBatch(Batch::quads);
+        quad_queue.Add(vertices[0], vertices[1], vertices[2], vertices[3]);
+    }
+
+    void AddQuadInstance(const QuadInstance &instance)
+    {
+        if (deferred)
+        {
+            RecordCommand(Batch::instanced_quads, command_instances.size());
+            command_instances.push_back(instance);
+            return;
+        }
+        BeginBatch(Batch::instanced_quads);
+        instance_queue.Add(instance);
+    }
+
+    // Sorts the recorded commands and sends them to the queues.
+    void SubmitCommands()
+    {
+        std::stable_sort(commands.begin(), commands.end(), [](const Command &a, const Command &b){return a.key < b.key;});
+
+        for (const Command &command : commands)
+        {
+            ApplyState(command_states[command.key & 0x7fffffffff]);
+
+            Batch command_batch = Batch((command.key >> 46 & 3) + 1);
+            BeginBatch(command_batch);
+
+            const Attribs *v = command_vertices.data() + command.first;
+            switch (command_batch)
+            {
+              case Batch::none:
+                break;
+              case Batch::triangles:
+                queue.Add(v[0], v[1], v[2]);
+                break;
+              case Batch::quads:
+                quad_queue.Add(v[0], v[1], v[2], v[3]);
+                break;
+              case Batch::instanced_quads:
+                instance_queue.Add(command_instances[command.first]);
+                break;
+            }
+        }
+
+        commands.clear();
+        command_vertices.clear();
+        command_instances.clear();
+        command_states.clear();
+        command_state_index = -1;
+
+        Flush();
+        ApplyState(state); // So that the uniforms match the last values set by the user.
+    }
+
+    [[nodiscard]] static u8vec4 PackUnorm(fvec4 value)
+    {
+        // This is on the hot path of instanced quads, so it avoids `iround()` (which calls `std::lround()`) and the generic vector `clamp()`.
+        // After clamping the values are non-negative, so adding 0.5 and truncating rounds them.
+        u8vec4 ret;
+        for (int i = 0; i < 4; i++)
+            ret[i] = std::clamp(value[i], 0.f, 1.f) * 255 + 0.5f;
+        return ret;
+    }
 };
 
 void *Render::GetRenderQueuePtr()
 {
-    return &data->queue;
+    return data.get();
 }
 
 Render::Render(decltype(nullptr)) {}
@@ -80,24 +349,28 @@ Render::operator bool() const
 
 void Render::BindShader() const
 {
+    data->Flush(); // This also resets the batch type, so the next batch binds its shader again.
     data->shader.Bind();
 }
 
 void Render::Finish()
 {
-    data->queue.Flush();
+    if (data->deferred)
+        data->SubmitCommands();
+    else
+        data->Flush();
 }
 
 void Render::SetTextureUnit(const Graphics::TexUnit &unit)
 {
-    Finish();
-    data->uni.texture = unit;
+    data->state.texture_unit = unit.Index();
+    data->StateChanged();
 }
 
 void Render::SetTextureSize(ivec2 size)
 {
-    Finish();
-    data->uni.tex_size = size;
+    data->state.tex_size = size;
+    data->StateChanged();
 }
 
 void Render::SetTexture(const Graphics::Texture &tex)
@@ -108,14 +381,67 @@ void Render::SetTexture(const Graphics::Texture &tex)
 
 void Render::SetMatrix(const fmat4 &m)
 {
-    Finish();
-    data->uni.matrix = m;
+    data->state.matrix = m;
+    data->StateChanged();
 }
 
 void Render::SetColorMatrix(const fmat4 &m)
 {
+    data->state.color_matrix = m;
+    data->StateChanged();
+}
+
+bool Render::SetInstancedQuads(bool enable)
+{
+    if (enable && !data->instanced_shader)
+        return false;
+    if (enable != data->instanced_quads)
+    {
+        Finish();
+        data->instanced_quads = enable;
+    }
+    return true;
+}
+
+bool Render::InstancedQuads() const
+{
+    return data->instanced_quads;
+}
+
+void Render::SetDeferred(bool enable)
+{
+    if (enable == data->deferred)
+        return;
     Finish();
-    data->uni.color_matrix = m;
+    data->deferred = enable;
+}
+
+bool Render::Deferred() const
+{
+    return data->deferred;
+}
+
+void Render::SetLayer(int layer)
+{
+    data->layer = std::clamp(layer, -0x8000, 0x7fff);
+}
+
+int Render::Layer() const
+{
+    return data->layer;
+}
+
+Render::Stats Render::GetStats() const
+{
+    Stats ret = data->stats;
+    ret.draw_calls = data->DrawCallCount() - data->base_draw_call_count;
+    return ret;
+}
+
+void Render::ResetStats()
+{
+    data->stats = {};
+    data->base_draw_call_count = data->DrawCallCount();
 }
 
 Render::Quad_t::~Quad_t()
@@ -134,37 +460,14 @@ Render::Quad_t::~Quad_t()
     if (data.abs_tex_pos)
         data.tex_size -= data.tex_pos;
 
-    Render::Data::Attribs out[4];
-
-    if (data.has_texture)
-    {
-        for (int i = 0; i < 4; i++)
-        {
-            out[i].color = data.colors[i].to_vec4(0);
-            out[i].factors.x = data.tex_color_factors[i];
-            out[i].factors.y = data.alpha[i];
-        }
-
-        if (data.center_pos_tex)
-        {
-            if (data.tex_size.x)
-                data.center.x *= data.size.x / data.tex_size.x;
-            if (data.tex_size.y)
-                data.center.y *= data.size.y / data.tex_size.y;
-        }
-    }
-    else
+    if (data.has_texture && data.center_pos_tex)
     {
-        for (int i = 0; i < 4; i++)
-        {
-            out[i].color = data.colors[i].to_vec4(data.alpha[i]);
-            out[i].factors.x = out[i].factors.y = 0;
-        }
+        if (data.tex_size.x)
+            data.center.x *= data.size.x / data.tex_size.x;
+        if (data.tex_size.y)
+            data.center.y *= data.size.y / data.tex_size.y;
     }
 
-    for (int i = 0; i < 4; i++)
-        out[i].factors.z = data.beta[i];
-
     if (data.flip_x)
     {
         data.tex_pos.x += data.tex_size.x;
@@ -180,6 +483,62 @@ Render::Quad_t::~Quad_t()
             data.center.y = data.size.y - data.center.y;
     }
 
+    auto render_data = (Render::Data *)queue;
+
+    if (render_data->instanced_quads)
+    {
+        Render::Data::QuadInstance instance;
+
+        if (data.has_matrix)
+        {
+            instance.origin = data.pos + (data.matrix * (-data.center).to_vec3(1)).to_vec2();
+            instance.axis_x = (data.matrix * fvec3(data.size.x, 0, 0)).to_vec2();
+            instance.axis_y = (data.matrix * fvec3(0, data.size.y, 0)).to_vec2();
+        }
+        else
+        {
+            instance.origin = data.pos - data.center;
+            instance.axis_x = fvec2(data.size.x, 0);
+            instance.axis_y = fvec2(0, data.size.y);
+        }
+
+        instance.tex_rect = data.tex_pos.to_vec4(data.tex_size.x, data.tex_size.y);
+
+        u8vec4 *colors[4] = {&instance.color0, &instance.color1, &instance.color2, &instance.color3};
+        fvec4 mix, alpha, beta;
+        for (int i = 0; i < 4; i++)
+        {
+            *colors[i] = Render::Data::PackUnorm(data.colors[i].to_vec4(data.has_texture ? 0 : data.alpha[i]));
+            mix[i] = data.has_texture ? data.tex_color_factors[i] : 0;
+            alpha[i] = data.has_texture ? data.alpha[i] : 0;
+            beta[i] = data.beta[i];
+        }
+        instance.mix = Render::Data::PackUnorm(mix);
+        instance.alpha = Render::Data::PackUnorm(alpha);
+        instance.beta = Render::Data::PackUnorm(beta);
+
+        render_data->AddQuadInstance(instance);
+        return;
+    }
+
+    Render::Data::Attribs out[4];
+
+    for (int i = 0; i < 4; i++)
+    {
+        if (data.has_texture)
+        {
+            out[i].color = data.colors[i].to_vec4(0);
+            out[i].factors.x = data.tex_color_factors[i];
+            out[i].factors.y = data.alpha[i];
+        }
+        else
+        {
+            out[i].color = data.colors[i].to_vec4(data.alpha[i]);
+            out[i].factors.x = out[i].factors.y = 0;
+        }
+        out[i].factors.z = data.beta[i];
+    }
+
     out[0].pos = -data.center;
     out[2].pos = data.size - data.center;
     out[1].pos = fvec2(out[2].pos.x, out[0].pos.y);
@@ -201,7 +560,7 @@ Render::Quad_t::~Quad_t()
     out[1].texcoord = {out[2].texcoord.x, out[0].texcoord.y};
     out[3].texcoord = {out[0].texcoord.x, out[2].texcoord.y};
 
-    ((decltype(Render::Data::queue) *)queue)->Add(out[0], out[1], out[2], out[3]);
+    render_data->AddQuad(out);
 }
 
 Render::Triangle_t::~Triangle_t()
@@ -247,7 +606,8 @@ Render::Triangle_t::~Triangle_t()
             it.pos = (data.matrix * it.pos.to_vec3(1)).to_vec2();
     }
 
-    ((decltype(Render::Data::queue) *)queue)->Add(out[0], out[1], out[2]);
+    auto render_data = (Render::Data *)queue;
+    render_data->AddTriangle(out);
 }
 
 Render::Text_t::~Text_t()
@@ -255,7 +615,8 @@ Render::Text_t::~Text_t()
     if (!renderer)
         return;
 
-    Graphics::Text::Stats stats = data.text.ComputeStats();
+    const Graphics::Text &text = GetText();
+    const Graphics::Text::Stats &stats = text.GetStats();
 
     ivec2 align_box(data.has_box_alignment ? data.align_box_x : data.align.x, data.align.y);
 
@@ -266,9 +627,9 @@ Render::Text_t::~Text_t()
 
     float line_start_offset_x = offset.x;
 
-    for (size_t line_index = 0; line_index < data.text.lines.size(); line_index++)
+    for (size_t line_index = 0; line_index < text.lines.size(); line_index++)
     {
-        const Graphics::Text::Line &line = data.text.lines[line_index];
+        const Graphics::Text::Line &line = text.lines[line_index];
         const Graphics::Text::Stats::Line &line_stats = stats.lines[line_index];
 
         offset.x = line_start_offset_x - line_stats.width * (1 + data.align.x) / 2;
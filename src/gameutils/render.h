@@ -32,7 +32,7 @@ class Render
 
     explicit operator bool() const;
 
-    void BindShader() const;
+    void BindShader() const; // Flushes the pending geometry first.
 
     void Finish();
 
@@ -48,13 +48,40 @@ class Render
 
     void SetColorMatrix(const fmat4 &m);
 
+    // In the instanced mode, each quad is sent to the GPU as a single compact record, and its corners are computed in the vertex shader.
+    // Colors and factors are stored with 8-bit precision in this mode, and are clamped to [0;1].
+    // Returns false if the mode can't be enabled because instancing is not supported. Disabled by default.
+    bool SetInstancedQuads(bool enable);
+    [[nodiscard]] bool InstancedQuads() const;
+
+    // In the deferred mode, draws are recorded instead of being sent to the GPU immediately, and state changes don't cause flushes.
+    // On `Finish()`, the recorded draws are sorted by layer, then by shader and state (texture, matrices), and merged into as few draw calls as possible.
+    // Draws on the same layer can be reordered, so they shouldn't overlap unless they have the same state. The order of equivalent draws is preserved.
+    // Disabled by default. You must call `Finish()` at the end of each frame in this mode.
+    void SetDeferred(bool enable);
+    [[nodiscard]] bool Deferred() const;
+
+    void SetLayer(int layer); // Layers are drawn in the increasing order. Clamped to the range of `int16_t`.
+    [[nodiscard]] int Layer() const;
+
+    struct Stats
+    {
+        int draws = 0; // The amount of recorded quads and triangles, only in the deferred mode.
+        int draw_calls = 0;
+        int state_changes = 0; // The amount of times the uniforms were changed between draw calls.
+    };
+
+    // Call `ResetStats()` at the beginning of each frame to get per-frame numbers.
+    [[nodiscard]] Stats GetStats() const;
+    void ResetStats();
+
     class Quad_t
     {
         friend class Render;
 
         using ref = Quad_t &&;
 
-        void *queue = 0; // Actually the type should be `Graphics::RenderQueue<Attribs, 3> *`, but we don't include "graphics/render_queue.h" for better compilation times.
+        void *queue = 0; // Actually the type should be `Render::Data *`, which owns the render queues, but it's incomplete here.
 
         struct Data
         {
@@ -273,7 +300,7 @@ class Render
 
         using ref = Triangle_t &&;
 
-        void *queue = 0; // Actually the type should be `Graphics::RenderQueue<Attribs, 3> *`, but we don't include "graphics/render_queue.h" for better compilation times.
+        void *queue = 0; // Actually the type should be `Render::Data *`, which owns the render queues, but it's incomplete here.
 
         struct Data
         {
@@ -425,7 +452,8 @@ class Render
         {
             // The constructor sets those:
             fvec2 pos;
-            Graphics::Text text;
+            Graphics::Text owned_text;
+            const Graphics::Text *text_ref = 0; // If not null, this is used instead of `owned_text`.
 
             ivec2 align = ivec2(0);
 
@@ -441,10 +469,20 @@ class Render
         };
         Data data;
 
-        Text_t(Render *renderer, fvec2 pos, Graphics::Text text) : renderer(renderer)
+        Text_t(Render *renderer, fvec2 pos, Graphics::Text &&text) : renderer(renderer)
         {
             data.pos = pos;
-            data.text = std::move(text);
+            data.owned_text = std::move(text);
+        }
+        Text_t(Render *renderer, fvec2 pos, const Graphics::Text &text) : renderer(renderer) // `text` must outlive this object, which is normally the case since this object is a temporary.
+        {
+            data.pos = pos;
+            data.text_ref = &text;
+        }
+
+        const Graphics::Text &GetText() const
+        {
+            return data.text_ref ? *data.text_ref : data.owned_text;
         }
       public:
         Text_t(Text_t &&other) noexcept : renderer(std::exchange(other.renderer, {})), data(std::move(other.data)) {}
@@ -573,13 +611,23 @@ class Render
         return Triangle_t(GetRenderQueuePtr(), a, b, c);
     }
 
-    Text_t ftext(fvec2 pos, Graphics::Text text)
+    // The `const Graphics::Text &` overloads don't copy the text. Use them with `Graphics::TextLayoutCache` to avoid allocations.
+    Text_t ftext(fvec2 pos, Graphics::Text &&text)
     {
         return Text_t(this, pos, std::move(text));
     }
-    Text_t itext(fvec2 pos, Graphics::Text text) = delete;
-    Text_t itext(ivec2 pos, Graphics::Text text)
+    Text_t ftext(fvec2 pos, const Graphics::Text &text)
+    {
+        return Text_t(this, pos, text);
+    }
+    Text_t itext(fvec2 pos, Graphics::Text &&text) = delete;
+    Text_t itext(fvec2 pos, const Graphics::Text &text) = delete;
+    Text_t itext(ivec2 pos, Graphics::Text &&text)
     {
         return Text_t(this, pos, std::move(text));
     }
+    Text_t itext(ivec2 pos, const Graphics::Text &text)
+    {
+        return Text_t(this, pos, text);
+    }
 };
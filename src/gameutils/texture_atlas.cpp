@@ -95,15 +95,12 @@ TextureAtlas::TextureAtlas(ivec2 target_size, const std::string &source_dir, con
         image_count++;
     });
 
-    // Load images and construct rectangle list for packing.
+    // Collect image names and paths.
     std::vector<std::string> name_list;
     name_list.reserve(image_count);
 
-    std::vector<Graphics::Image> image_list;
-    image_list.reserve(image_count);
-
-    std::vector<Packing::Rect> rect_list;
-    rect_list.reserve(image_count);
+    std::vector<std::string> path_list;
+    path_list.reserve(image_count);
 
     Filesystem::ForEachObject(source_tree, [&](const Filesystem::TreeNode &node)
     {
@@ -112,13 +109,17 @@ TextureAtlas::TextureAtlas(ivec2 target_size, const std::string &source_dir, con
 
         // Save image name, but first strip source director name from it.
         name_list.push_back(node.path.substr(source_dir.size() + 1)); // `+ 1` is for `/`.
+        path_list.push_back(node.path);
+    });
 
-        // Load image.
-        image_list.push_back(Graphics::Image(node.path));
+    // Load images in parallel.
+    std::vector<Graphics::Image> image_list = Graphics::Image::LoadBatch(path_list);
 
-        // Make rectangle.
-        rect_list.emplace_back(image_list.back().Size());
-    });
+    // Construct rectangle list for packing.
+    std::vector<Packing::Rect> rect_list;
+    rect_list.reserve(image_count);
+    for (const Graphics::Image &source_image : image_list)
+        rect_list.emplace_back(source_image.Size());
 
     // Try packing rectangles.
     if (Packing::PackRects(target_size, rect_list.data(), rect_list.size(), add_gaps))
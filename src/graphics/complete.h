@@ -3,13 +3,24 @@
 #include "graphics/blending.h"
 #include "graphics/clear.h"
 #include "graphics/errors.h"
+#include "graphics/extensions.h"
+#include "graphics/fence.h"
 #include "graphics/font.h"
 #include "graphics/font_file.h"
 #include "graphics/framebuffer.h"
+#include "graphics/glyph_cache.h"
 #include "graphics/image.h"
+#include "graphics/image_kernels.h"
+#include "graphics/instance_queue.h"
+#include "graphics/kerning_table.h"
+#include "graphics/pixel_buffer.h"
+#include "graphics/readback.h"
 #include "graphics/render_queue.h"
 #include "graphics/shader.h"
+#include "graphics/streaming_buffer.h"
 #include "graphics/text.h"
+#include "graphics/text_layout_cache.h"
 #include "graphics/texture.h"
+#include "graphics/texture_uploader.h"
 #include "graphics/vertex_buffer.h"
 #include "graphics/viewport.h"
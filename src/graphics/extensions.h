@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <unordered_set>
+
+#include <GLFL/glfl.h>
+
+namespace Graphics::Extensions
+{
+    // Those functions must only be called after the OpenGL functions are loaded, i.e. after the window is created.
+    // The results are cached, so they are cheap to call repeatedly.
+
+    // Returns true if the context reports the extension.
+    [[nodiscard]] inline bool Reported(const std::string &name)
+    {
+        static const std::unordered_set<std::string> list = []{
+            std::unordered_set<std::string> ret;
+            if (glGetStringi)
+            {
+                GLint count = 0;
+                glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+                for (GLint i = 0; i < count; i++)
+                {
+                    if (auto str = (const char *)glGetStringi(GL_EXTENSIONS, i))
+                        ret.insert(str);
+                }
+            }
+            else if (auto str = (const char *)glGetString(GL_EXTENSIONS)) // Older contexts only have a single space-separated string.
+            {
+                while (*str)
+                {
+                    const char *end = std::strchr(str, ' ');
+                    if (!end)
+                        end = str + std::strlen(str);
+                    if (end != str)
+                        ret.insert(std::string(str, end));
+                    str = *end ? end + 1 : end;
+                }
+            }
+            return ret;
+        }();
+        return list.count(name) > 0;
+    }
+
+    // Those return true if the corresponding functions are available, either from the core profile or from an extension.
+    // If necessary, the extension functions are loaded.
+
+    [[nodiscard]] inline bool Sync() // `glFenceSync()` and friends. Core since 3.2.
+    {
+        static const bool ret = []{
+            if (!glFenceSync && Reported("GL_ARB_sync"))
+                glfl::load_extension_GL_ARB_sync();
+            return glFenceSync && glClientWaitSync && glDeleteSync;
+        }();
+        return ret;
+    }
+
+    [[nodiscard]] inline bool BufferStorage() // `glBufferStorage()` and persistent mapping. Core since 4.4.
+    {
+        static const bool ret = []{
+            if (!glBufferStorage && Reported("GL_ARB_buffer_storage"))
+                glfl::load_extension_GL_ARB_buffer_storage();
+            return glBufferStorage && glMapBufferRange && glUnmapBuffer;
+        }();
+        return ret;
+    }
+
+    [[nodiscard]] inline bool ProgramBinary() // `glGetProgramBinary()` and `glProgramBinary()`. Core since 4.1.
+    {
+        static const bool ret = []{
+            if (!glProgramBinary && Reported("GL_ARB_get_program_binary"))
+                glfl::load_extension_GL_ARB_get_program_binary();
+            if (!glProgramBinary || !glGetProgramBinary || !glProgramParameteri)
+                return false;
+            // Some drivers support the functions, but no binary formats.
+            GLint format_count = 0;
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+            return format_count > 0;
+        }();
+        return ret;
+    }
+
+    [[nodiscard]] inline bool InstancedArrays() // `glVertexAttribDivisor()` and `glDrawElementsInstanced()`. Core since 3.3.
+    {
+        static const bool ret = []{
+            if (!glVertexAttribDivisor && !glVertexAttribDivisorARB && Reported("GL_ARB_instanced_arrays"))
+                glfl::load_extension_GL_ARB_instanced_arrays();
+            return (glVertexAttribDivisor || glVertexAttribDivisorARB) && glDrawElementsInstanced;
+        }();
+        return ret;
+    }
+
+    // Calls either the core function or the extension one. Requires `InstancedArrays()`.
+    inline void VertexAttribDivisor(GLuint index, GLuint divisor)
+    {
+        if (glVertexAttribDivisor)
+            glVertexAttribDivisor(index, divisor);
+        else
+            glVertexAttribDivisorARB(index, divisor);
+    }
+}
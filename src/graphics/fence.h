@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+
+#include <GLFL/glfl.h>
+
+#include "graphics/extensions.h"
+#include "program/errors.h"
+
+namespace Graphics
+{
+    // A GPU fence. It becomes signaled when the GPU finishes all commands issued before it was created.
+    // Use `Extensions::Sync()` to check if fences are supported.
+    class Fence
+    {
+        struct Data
+        {
+            GLsync handle = 0;
+        };
+
+        Data data;
+
+      public:
+        Fence(decltype(nullptr)) {}
+
+        Fence()
+        {
+            data.handle = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            if (!data.handle)
+                Program::Error("Unable to create a fence.");
+        }
+
+        Fence(Fence &&other) noexcept : data(std::exchange(other.data, {})) {}
+        Fence &operator=(Fence other) noexcept
+        {
+            std::swap(data, other.data);
+            return *this;
+        }
+
+        ~Fence()
+        {
+            if (data.handle)
+                glDeleteSync(data.handle);
+        }
+
+        explicit operator bool() const
+        {
+            return bool(data.handle);
+        }
+
+        GLsync Handle() const
+        {
+            return data.handle;
+        }
+
+        // Returns true if the fence is signaled, without blocking. Null fences are considered signaled.
+        [[nodiscard]] bool IsSignaled() const
+        {
+            if (!data.handle)
+                return true;
+            GLenum status = glClientWaitSync(data.handle, 0, 0);
+            return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+        }
+
+        // Blocks until the fence is signaled or the timeout expires. Returns false on timeout. Null fences are considered signaled.
+        bool Wait(uint64_t timeout_ns = uint64_t(-1)) const
+        {
+            if (!data.handle)
+                return true;
+            // The flush bit makes sure the fence actually reaches the GPU, otherwise we could wait forever.
+            GLenum status = glClientWaitSync(data.handle, GL_SYNC_FLUSH_COMMANDS_BIT, timeout_ns);
+            if (status == GL_WAIT_FAILED)
+                Program::Error("Unable to wait for a fence.");
+            return status != GL_TIMEOUT_EXPIRED;
+        }
+    };
+}
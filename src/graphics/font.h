@@ -1,9 +1,11 @@
 #pragma once
 
+#include <cstdint>
 #include <functional>
 #include <unordered_map>
 #include <utility>
 
+#include "graphics/kerning_table.h"
 #include "utils/mat.h"
 
 namespace Graphics
@@ -24,13 +26,17 @@ namespace Graphics
         int descent = 0;
         int line_skip = 0;
 
-        using kerning_func_t = std::function<int(uint32_t, uint32_t)>;
-        kerning_func_t kerning_func = 0;
+        KerningTable kerning;
+
+        using missing_glyph_func_t = std::function<const Glyph *(uint32_t)>; // Returns null if the glyph can't be provided.
+        missing_glyph_func_t missing_glyph_func = 0;
 
         // Some code might rely on references not being invalidated on insertion. Keep that in mind if you decide to change the container.
         std::unordered_map<uint32_t, Glyph> glyphs;
         Glyph default_glyph;
 
+        uint64_t generation = 0;
+
       public:
         void SetAscent(int new_ascent)
         {
@@ -44,9 +50,16 @@ namespace Graphics
         {
             line_skip = new_line_skip;
         }
-        void SetKerningFunc(kerning_func_t new_kerning_func) // You can use null function if you don't want kerning.
+        void SetKerning(KerningTable new_kerning) // You can use an empty table if you don't want kerning.
+        {
+            kerning = std::move(new_kerning);
+            generation++;
+        }
+        // `Get()` calls this for glyphs that weren't inserted, before falling back to the default glyph. See `GlyphCache`.
+        void SetMissingGlyphFunc(missing_glyph_func_t new_missing_glyph_func)
         {
-            kerning_func = std::move(new_kerning_func);
+            missing_glyph_func = std::move(new_missing_glyph_func);
+            generation++;
         }
 
         int Ascent() const
@@ -70,20 +83,17 @@ namespace Graphics
             return line_skip - Height();
         }
 
-        const kerning_func_t KerningFunc() const
+        const KerningTable &GetKerningTable() const
         {
-            return kerning_func;
+            return kerning;
         }
         bool HasKerning() const
         {
-            return bool(kerning_func);
+            return !kerning.IsEmpty();
         }
         int Kerning(uint32_t a, uint32_t b) const
         {
-            if (kerning_func)
-                return kerning_func(a, b);
-            else
-                return 0;
+            return kerning.Get(a, b);
         }
 
         Glyph &DefaultGlyph()
@@ -96,16 +106,37 @@ namespace Graphics
         }
 
         // Note that returned references remain valid even after insertions.
+        // References to glyphs provided by the missing glyph function remain valid until the next `Generation()` change.
         const Glyph &Get(uint32_t ch) const
         {
             if (auto it = glyphs.find(ch); it != glyphs.end())
                 return it->second;
-            else
-                return default_glyph;
+            if (missing_glyph_func)
+            {
+                if (const Glyph *glyph = missing_glyph_func(ch))
+                    return *glyph;
+            }
+            return default_glyph;
         }
         Glyph &Insert(uint32_t ch) // If the glyph already exists, returns a reference to it instead of creating a new one.
         {
+            generation++;
             return glyphs.insert({ch, {}}).first->second;
         }
+        void Erase(uint32_t ch)
+        {
+            generation++;
+            glyphs.erase(ch);
+        }
+
+        // This changes whenever previously returned glyph data might become outdated. Use it to invalidate anything computed from the glyphs.
+        uint64_t Generation() const
+        {
+            return generation;
+        }
+        void BumpGeneration()
+        {
+            generation++;
+        }
     };
 }
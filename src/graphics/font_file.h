@@ -1,21 +1,26 @@
 #pragma once
 
 #include <algorithm>
-#include <functional>
+#include <atomic>
 #include <exception>
 #include <utility>
+#include <vector>
 
 #include <ft2build.h>
 #include FT_FREETYPE_H // Ugh.
+#include FT_TRUETYPE_TABLES_H
+#include FT_TRUETYPE_TAGS_H
 
 #include "graphics/font.h"
 #include "graphics/image.h"
+#include "graphics/kerning_table.h"
 #include "program/errors.h"
 #include "utils/finally.h"
 #include "utils/mat.h"
 #include "utils/memory_file.h"
 #include "utils/packing.h"
 #include "utils/strings.h"
+#include "utils/thread_pool.h"
 #include "utils/unicode.h"
 #include "utils/unicode_ranges.h"
 
@@ -28,45 +33,33 @@ namespace Graphics
     {
         inline static bool ft_initialized = 0;
         inline static FT_Library ft_context = 0;
-        inline static int open_font_count = 0;
+        inline static std::atomic<int> open_font_count = 0; // Only counts fonts using `ft_context`.
 
         struct Data
         {
             FT_Face ft_font = 0;
+            FT_Library own_context = 0; // Only set for fonts created with `MakeIndependentCopy()`.
             MemoryFile file;
+            ivec2 size = ivec2(0);
+            int index = 0;
         };
 
         Data data;
 
-      public:
-        FontFile(decltype(nullptr)) {}
-
-        // File is copied into the font, since FreeType requires original data to be available when the font is used. (Since files are ref-counted, file contents aren't copied.)
-        // `size` is measured in pixels. Normally you only provide height, but you can also provide width. In this case, `[x,0]` and `[0,x]` are equivalent to `[x,x]` due to how FreeType operates.
-        // Some font files contain several fonts; `index` determines which one of them is loaded. Upper 16 bits of `index` contain so-called "variation" (sub-font?) index, which starts from 1. Use 0 to load the default one.
-
-        FontFile(MemoryFile file, int size, int index = 0) : FontFile(file, ivec2(0, size), index) {}
-
-        FontFile(MemoryFile file, ivec2 size, int index = 0)
+        void Open(FT_Library context, MemoryFile file, ivec2 size, int index)
         {
-            if (!ft_initialized)
-            {
-                ft_initialized = !FT_Init_FreeType(&ft_context);
-                if (!ft_initialized)
-                    Program::Error("Unable to initialize FreeType.");
-                // We don't unload the library if this constructor throws after this point.
-            }
-
             data.file = std::move(file); // Memory files are ref-counted, but moving won't hurt.
+            data.size = size;
+            data.index = index;
 
             FT_Open_Args args{};
             args.flags = FT_OPEN_MEMORY;
             args.memory_base = data.file.data();
             args.memory_size = data.file.size();
 
-            if (FT_Open_Face(ft_context, &args, index, &data.ft_font))
+            if (FT_Open_Face(context, &args, index, &data.ft_font))
                 Program::Error("Unable to load font `", data.file.name(), "`.");
-            FINALLY_ON_THROW( FT_Done_Face(data.ft_font); )
+            FINALLY_ON_THROW( FT_Done_Face(data.ft_font); data.ft_font = 0; )
 
             if (FT_Set_Pixel_Sizes(data.ft_font, size.x, size.y))
             {
@@ -101,6 +94,28 @@ namespace Graphics
                 Program::Error("Bitmap font `", data.file.name(), "`", index != 0 ? Str("[",index,"]") : "", " doesn't support size ", requested_size, ".",
                                size_list.empty() ? "" : Str("\nAvailable sizes are: ", size_list, "."));
             }
+        }
+
+      public:
+        FontFile(decltype(nullptr)) {}
+
+        // File is copied into the font, since FreeType requires original data to be available when the font is used. (Since files are ref-counted, file contents aren't copied.)
+        // `size` is measured in pixels. Normally you only provide height, but you can also provide width. In this case, `[x,0]` and `[0,x]` are equivalent to `[x,x]` due to how FreeType operates.
+        // Some font files contain several fonts; `index` determines which one of them is loaded. Upper 16 bits of `index` contain so-called "variation" (sub-font?) index, which starts from 1. Use 0 to load the default one.
+
+        FontFile(MemoryFile file, int size, int index = 0) : FontFile(file, ivec2(0, size), index) {}
+
+        FontFile(MemoryFile file, ivec2 size, int index = 0)
+        {
+            if (!ft_initialized)
+            {
+                ft_initialized = !FT_Init_FreeType(&ft_context);
+                if (!ft_initialized)
+                    Program::Error("Unable to initialize FreeType.");
+                // We don't unload the library if this constructor throws after this point.
+            }
+
+            Open(ft_context, std::move(file), size, index);
 
             open_font_count++; // This must remain at the bottom of the constructor in case something throws.
         }
@@ -117,14 +132,28 @@ namespace Graphics
             if (data.ft_font)
             {
                 FT_Done_Face(data.ft_font);
-                open_font_count--;
+                if (!data.own_context)
+                    open_font_count--;
             }
+            if (data.own_context)
+                FT_Done_FreeType(data.own_context);
+        }
+
+        // FreeType faces can't be used from several threads at once. This opens the same font (sharing the file contents) with a separate FreeType library instance,
+        // so the copy can be used on a different thread than the original. Throws on failure.
+        [[nodiscard]] FontFile MakeIndependentCopy() const
+        {
+            FontFile ret = nullptr;
+            if (FT_Init_FreeType(&ret.data.own_context))
+                Program::Error("Unable to initialize FreeType.");
+            ret.Open(ret.data.own_context, data.file, data.size, data.index); // If this throws, `ret`'s destructor unloads the library.
+            return ret;
         }
 
         static void UnloadLibrary() // Use this to unload freetype. This function throws if you have opened fonts.
         {
             if (open_font_count > 0)
-                Program::Error("Unable to unload FreeType: ", open_font_count, " fonts are still in use.");
+                Program::Error("Unable to unload FreeType: ", open_font_count.load(), " fonts are still in use.");
             if (ft_initialized)
                 return;
             FT_Done_FreeType(ft_context);
@@ -170,19 +199,169 @@ namespace Graphics
             return (vec.x + (1 << 5)) >> 6; // The kerning is measured in 26.6 fixed point pixels, so we round it.
         }
 
-        // Constructs a functor to return kerning. Freetype font handle is copied into the functior, you should keep corresponding object alive as long as you need it.
-        // If the font doesn't support kerning, null functor is returned.
-        std::function<int(uint32_t, uint32_t)> KerningFunc() const
+      private:
+        // Returns the glyph pairs listed in the TrueType `kern` table, the one `FT_Get_Kerning()` reads. The values are looked up separately, since FreeType scales them.
+        // Returns false if the font has no such table (e.g. if the kerning comes from somewhere else), then `pairs` is left empty.
+        bool GetKerningGlyphPairs(std::vector<std::pair<FT_UInt, FT_UInt>> &pairs) const
+        {
+            pairs.clear();
+            if (!FT_IS_SFNT(data.ft_font))
+                return false;
+
+            FT_ULong table_size = 0;
+            if (FT_Load_Sfnt_Table(data.ft_font, TTAG_kern, 0, nullptr, &table_size) || table_size < 4)
+                return false;
+            std::vector<unsigned char> table(table_size);
+            if (FT_Load_Sfnt_Table(data.ft_font, TTAG_kern, 0, table.data(), &table_size))
+                return false;
+
+            // All values are big-endian. We only support the Microsoft version 0 of the table, same as FreeType.
+            const unsigned char *cur = table.data(), *table_end = table.data() + table.size();
+            auto ReadU16 = [](const unsigned char *ptr) {return FT_UInt(ptr[0] << 8 | ptr[1]);};
+
+            if (ReadU16(cur) != 0)
+                return false;
+            FT_UInt subtable_count = ReadU16(cur + 2);
+            cur += 4;
+
+            for (FT_UInt i = 0; i < subtable_count && table_end - cur >= 14; i++)
+            {
+                FT_UInt length = ReadU16(cur + 2);
+                FT_UInt coverage = ReadU16(cur + 4);
+                FT_UInt pair_count = ReadU16(cur + 6);
+
+                // Only horizontal format 0 subtables are used by FreeType.
+                if ((coverage & 1) && (coverage >> 8) == 0)
+                {
+                    // Don't trust `length`, it overflows in large tables. The pairs are clamped to the table size instead.
+                    const unsigned char *pair_data = cur + 14;
+                    pair_count = std::min(pair_count, FT_UInt((table_end - pair_data) / 6));
+                    for (FT_UInt j = 0; j < pair_count; j++)
+                        pairs.emplace_back(ReadU16(pair_data + j * 6), ReadU16(pair_data + j * 6 + 2));
+                }
+
+                if (length < 14)
+                    break;
+                cur += std::min(std::ptrdiff_t(length), table_end - cur);
+            }
+
+            return true;
+        }
+
+      public:
+        // Extracts kerning for all pairs of the specified characters. Returns an empty table if the font doesn't support kerning.
+        // If the font has a `kern` table, only the pairs listed in it are queried. Otherwise every pair is queried, on `pool` threads, each using its own copy of the font.
+        KerningTable MakeKerningTable(const std::vector<uint32_t> &chars, ThreadPool &pool = ThreadPool::Global()) const
         {
+            KerningTable ret;
             if (!HasKerning())
-                return 0;
-            return [ft_font = data.ft_font](uint16_t a, uint16_t b) -> int
+                return ret;
+
+            // Look up the glyph indices once, rather than once per pair.
+            std::vector<FT_UInt> glyph_indices;
+            glyph_indices.reserve(chars.size());
+            for (uint32_t ch : chars)
+                glyph_indices.push_back(FT_Get_Char_Index(data.ft_font, ch));
+
+            auto GetKerning = [](FT_Face ft_font, FT_UInt a, FT_UInt b) -> int
             {
                 FT_Vector vec;
-                if (FT_Get_Kerning(ft_font, FT_Get_Char_Index(ft_font, a), FT_Get_Char_Index(ft_font, b), FT_KERNING_DEFAULT, &vec))
+                if (FT_Get_Kerning(ft_font, a, b, FT_KERNING_DEFAULT, &vec))
                     return 0;
                 return (vec.x + (1 << 5)) >> 6; // See `Kerning()` for why we bit-shift.
             };
+
+            std::vector<std::pair<FT_UInt, FT_UInt>> glyph_pairs;
+            if (GetKerningGlyphPairs(glyph_pairs))
+            {
+                // Several characters can share a glyph, so we map each glyph to a range of characters.
+                std::vector<std::pair<FT_UInt, uint32_t>> glyph_to_char; // Sorted by glyph index.
+                glyph_to_char.reserve(chars.size());
+                for (std::size_t i = 0; i < chars.size(); i++)
+                {
+                    if (glyph_indices[i])
+                        glyph_to_char.emplace_back(glyph_indices[i], chars[i]);
+                }
+                std::sort(glyph_to_char.begin(), glyph_to_char.end());
+
+                auto CharsForGlyph = [&](FT_UInt glyph)
+                {
+                    return std::equal_range(glyph_to_char.begin(), glyph_to_char.end(), std::pair<FT_UInt, uint32_t>(glyph, 0),
+                        [](const auto &a, const auto &b){return a.first < b.first;});
+                };
+
+                for (const auto &[first_glyph, second_glyph] : glyph_pairs)
+                {
+                    auto [first_begin, first_end] = CharsForGlyph(first_glyph);
+                    if (first_begin == first_end)
+                        continue;
+                    auto [second_begin, second_end] = CharsForGlyph(second_glyph);
+                    if (second_begin == second_end)
+                        continue;
+
+                    int value = GetKerning(data.ft_font, first_glyph, second_glyph);
+                    for (auto a = first_begin; a != first_end; a++)
+                    {
+                        for (auto b = second_begin; b != second_end; b++)
+                            ret.Set(a->second, b->second, value);
+                    }
+                }
+
+                return ret;
+            }
+
+            // There's no pair list to read, so query every pair. Characters without glyphs have no kerning.
+            std::vector<std::size_t> char_indices;
+            for (std::size_t i = 0; i < chars.size(); i++)
+            {
+                if (glyph_indices[i])
+                    char_indices.push_back(i);
+            }
+
+            constexpr int min_rows_per_chunk = 64; // Copying a font is not free, so we don't split the work too finely.
+            int chunk_count = std::clamp(int(char_indices.size()) / min_rows_per_chunk, 1, pool.ThreadCount() + 1); // `+ 1` because the calling thread participates too.
+
+            std::vector<std::vector<KerningTable::Pair>> chunk_pairs(chunk_count);
+
+            auto ProcessChunk = [&](FT_Face ft_font, int chunk_index)
+            {
+                std::size_t chunk_begin = char_indices.size() * chunk_index / chunk_count;
+                std::size_t chunk_end = char_indices.size() * (chunk_index + 1) / chunk_count;
+                for (std::size_t i = chunk_begin; i < chunk_end; i++)
+                {
+                    for (std::size_t j : char_indices)
+                    {
+                        int value = GetKerning(ft_font, glyph_indices[char_indices[i]], glyph_indices[j]);
+                        if (value != 0)
+                            chunk_pairs[chunk_index].push_back({chars[char_indices[i]], chars[j], value});
+                    }
+                }
+            };
+
+            if (chunk_count == 1)
+            {
+                ProcessChunk(data.ft_font, 0);
+            }
+            else
+            {
+                pool.ForEach(chunk_count, [&](int chunk_index)
+                {
+                    FontFile copy = MakeIndependentCopy();
+                    ProcessChunk(copy.data.ft_font, chunk_index);
+                });
+            }
+
+            std::size_t pair_count = 0;
+            for (const auto &pairs : chunk_pairs)
+                pair_count += pairs.size();
+            ret.Reserve(pair_count);
+            for (const auto &pairs : chunk_pairs)
+            {
+                for (const KerningTable::Pair &pair : pairs)
+                    ret.Set(pair.first, pair.second, pair.value);
+            }
+
+            return ret;
         }
 
         // This always returns `true` for 0xFFFD `Unicode::default_char`, since freetype itself seems to able to draw it if it's not included in the font.
@@ -236,16 +415,14 @@ namespace Graphics
                 ivec2 size = ivec2(bitmap.width, bitmap.rows);
                 ret.offset = ivec2(glyph->bitmap_left, -glyph->bitmap_top);
                 ret.advance = (glyph->advance.x + (1 << 5)) >> 6; // Advance is measured in 26.6 fixed point pixels, so we round it.
-                ret.image = Image(size);
 
                 if (is_antialiased)
                 {
-                    for (int y = 0; y < size.y; y++)
-                    for (int x = 0; x < size.x; x++)
-                        ret.image.UnsafeAt(ivec2(x,y)) = u8vec3(255).to_vec4(bitmap.buffer[bitmap.pitch * y + x]);
+                    ret.image = Image::FromAlpha(size, bitmap.buffer, bitmap.pitch);
                 }
                 else
                 {
+                    ret.image = Image(size);
                     for (int y = 0; y < size.y; y++)
                     {
                         uint8_t *byte_ptr = bitmap.buffer + bitmap.pitch * y;
@@ -291,19 +468,20 @@ namespace Graphics
             : target(&target), source(&source), glyphs(&glyphs), render_mode(render_mode), flags(flags) {}
     };
 
-    inline void MakeFontAtlas(Image &image, ivec2 pos, ivec2 size, const std::vector<FontAtlasEntry> &entries, bool add_gaps = 1) // Throws on failure.
+    // Glyphs are rendered on `pool` threads, each using its own copies of the source fonts. The results don't depend on the amount of threads.
+    inline void MakeFontAtlas(Image &image, ivec2 pos, ivec2 size, const std::vector<FontAtlasEntry> &entries, bool add_gaps = 1, ThreadPool &pool = ThreadPool::Global()) // Throws on failure.
     {
         if (!image.RectInBounds(pos, size))
             Program::Error("Invalid target rectangle for a font atlas.");
 
-        struct Glyph
+        struct Job
         {
-            Font::Glyph *target = 0;
-            Image image;
+            const FontAtlasEntry *entry = 0;
+            uint32_t ch = 0;
+            FontFile::GlyphData glyph_data;
         };
 
-        std::vector<Glyph> glyphs;
-        std::vector<Packing::Rect> rects;
+        std::vector<Job> jobs;
 
         for (const FontAtlasEntry &entry : entries)
         {
@@ -311,25 +489,12 @@ namespace Graphics
             entry.target->SetAscent(entry.source->Ascent());
             entry.target->SetDescent(entry.source->Descent());
             entry.target->SetLineSkip(entry.flags & entry.no_line_gap ? entry.source->Height() : entry.source->LineSkip());
-            entry.target->SetKerningFunc(entry.source->KerningFunc());
 
             auto AddGlyph = [&](uint32_t ch)
             {
                 if (!entry.source->HasGlyph(ch))
                     return;
-
-                // Copy glyph to the font.
-                FontFile::GlyphData glyph_data = entry.source->GetGlyph(ch, entry.render_mode);
-                Font::Glyph &font_glyph = (ch != Unicode::default_char ? entry.target->Insert(ch) : entry.target->DefaultGlyph());
-                font_glyph.size = glyph_data.image.Size();
-                font_glyph.offset = glyph_data.offset;
-                font_glyph.advance = glyph_data.advance;
-
-                // Save it into the glyph vector.
-                glyphs.push_back({&font_glyph, std::move(glyph_data.image)}); // We rely on the fact that Graphics::Font doesn't invalidate references on insertions.
-
-                // Save it into the rect vector.
-                rects.emplace_back(font_glyph.size);
+                jobs.push_back({&entry, ch, {}});
             };
 
             // Save the default glyph.
@@ -343,6 +508,77 @@ namespace Graphics
             });
         }
 
+        // Extract kerning for the baked characters.
+        for (const FontAtlasEntry &entry : entries)
+        {
+            std::vector<uint32_t> chars;
+            for (const Job &job : jobs)
+            {
+                if (job.entry == &entry && job.ch != Unicode::default_char)
+                    chars.push_back(job.ch);
+            }
+            entry.target->SetKerning(entry.source->MakeKerningTable(chars, pool));
+        }
+
+        // Render the glyphs.
+        // Each chunk of glyphs is rendered with its own copies of the fonts, since FreeType faces aren't thread-safe.
+        constexpr int min_glyphs_per_chunk = 64; // Copying a font is not free, so we don't split the work too finely.
+        int chunk_count = std::clamp(int(jobs.size()) / min_glyphs_per_chunk, 1, pool.ThreadCount() + 1); // `+ 1` because the calling thread participates too.
+
+        if (chunk_count == 1)
+        {
+            for (Job &job : jobs)
+                job.glyph_data = job.entry->source->GetGlyph(job.ch, job.entry->render_mode);
+        }
+        else
+        {
+            pool.ForEach(chunk_count, [&](int chunk_index)
+            {
+                std::vector<std::pair<const FontFile *, FontFile>> font_copies;
+
+                auto GetFontCopy = [&](const FontFile *source) -> const FontFile &
+                {
+                    for (const auto &[original, copy] : font_copies)
+                    {
+                        if (original == source)
+                            return copy;
+                    }
+                    return font_copies.emplace_back(source, source->MakeIndependentCopy()).second;
+                };
+
+                std::size_t chunk_begin = jobs.size() * chunk_index / chunk_count;
+                std::size_t chunk_end = jobs.size() * (chunk_index + 1) / chunk_count;
+                for (std::size_t i = chunk_begin; i < chunk_end; i++)
+                    jobs[i].glyph_data = GetFontCopy(jobs[i].entry->source).GetGlyph(jobs[i].ch, jobs[i].entry->render_mode);
+            });
+        }
+
+        // Copy glyphs to the fonts, in the original order.
+        struct Glyph
+        {
+            Font::Glyph *target = 0;
+            Image image;
+        };
+
+        std::vector<Glyph> glyphs;
+        glyphs.reserve(jobs.size());
+        std::vector<Packing::Rect> rects;
+        rects.reserve(jobs.size());
+
+        for (Job &job : jobs)
+        {
+            Font::Glyph &font_glyph = (job.ch != Unicode::default_char ? job.entry->target->Insert(job.ch) : job.entry->target->DefaultGlyph());
+            font_glyph.size = job.glyph_data.image.Size();
+            font_glyph.offset = job.glyph_data.offset;
+            font_glyph.advance = job.glyph_data.advance;
+
+            // Save it into the glyph vector.
+            glyphs.push_back({&font_glyph, std::move(job.glyph_data.image)}); // We rely on the fact that Graphics::Font doesn't invalidate references on insertions.
+
+            // Save it into the rect vector.
+            rects.emplace_back(font_glyph.size);
+        }
+
         // Pack rectangles.
         if (Packing::PackRects(size, rects.data(), rects.size(), add_gaps))
             Program::Error("Unable to fit the font atlas for into ", size.x, 'x', size.y, " rectangle.");
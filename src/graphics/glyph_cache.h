@@ -0,0 +1,282 @@
+#pragma once
+
+#include <cstdint>
+#include <exception>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "graphics/font.h"
+#include "graphics/font_file.h"
+#include "graphics/image.h"
+#include "graphics/image_kernels.h"
+#include "graphics/texture.h"
+#include "program/errors.h"
+#include "utils/mat.h"
+#include "utils/meta.h"
+#include "utils/packing.h"
+
+namespace Graphics
+{
+    /* Renders glyphs missing from a `Font` on first use, into a region of an atlas image.
+     *
+     * The region is split into pages. When all pages are full, the least recently used page is cleared, unless it was used during the current frame.
+     * If every page was used during the current frame, the font falls back to its default glyph.
+     *
+     * Example usage:
+     *
+     *     Graphics::GlyphCache cache(font, font_file, Graphics::FontFile::normal, atlas_image, region_pos, region_size, ivec2(256));
+     *
+     *     // Every frame:
+     *     cache.NextFrame();
+     *     ... // Draw text using `font`.
+     *     cache.Upload(texture); // `texture` must contain `atlas_image`. Only the changed parts are uploaded.
+     *
+     * When glyphs are evicted, `font.Generation()` changes. Texts constructed before that might refer to stale glyphs and should be rebuilt.
+ * It also changes when the default glyph is used because all pages are busy, so that such texts are rebuilt with the proper glyphs later.
+     */
+
+    class GlyphCache : Meta::stationary<GlyphCache>
+    {
+      public:
+        struct Stats
+        {
+            uint64_t hits = 0;
+            uint64_t misses = 0; // The amount of rendered glyphs.
+            uint64_t evictions = 0; // The amount of cleared pages.
+            uint64_t fallbacks = 0; // The amount of times a glyph couldn't be cached because all pages were used during the current frame.
+        };
+
+      private:
+        struct Entry
+        {
+            Font::Glyph glyph;
+            int page = 0;
+        };
+
+        struct Page
+        {
+            Packing::Page packer;
+            ivec2 pos = ivec2(0);
+            uint64_t last_used_frame = 0;
+            std::vector<uint32_t> chars;
+
+            bool fully_dirty = true;
+            std::vector<std::pair<ivec2, ivec2>> dirty_rects; // Position and size.
+        };
+
+        Font *font = 0;
+        const FontFile *source = 0;
+        FontFile::RenderMode render_mode = FontFile::normal;
+        Image *image = 0;
+        ivec2 page_size = ivec2(0);
+
+        std::vector<Page> pages;
+        std::unordered_map<uint32_t, Entry> entries;
+        std::unordered_set<uint32_t> unavailable_chars; // Chars that the font doesn't have, or that are too large for a page.
+        uint64_t frame = 1;
+        Stats stats;
+
+        std::vector<u8vec4> upload_buffer;
+
+        void EvictPage(Page &page)
+        {
+            for (uint32_t ch : page.chars)
+                entries.erase(ch);
+            page.chars.clear();
+            page.packer.Clear();
+            image->UnsafeFill(page.pos, page_size, u8vec4(0));
+            page.fully_dirty = true;
+            page.dirty_rects.clear();
+
+            stats.evictions++;
+            font->BumpGeneration();
+        }
+
+        void UploadRect(Texture &texture, ivec2 pos, ivec2 size)
+        {
+            if (size.x <= 0 || size.y <= 0)
+                return;
+            upload_buffer.resize(size.prod());
+            for (int y = 0; y < size.y; y++)
+                ImageKernels::Copy(upload_buffer.data() + size.x * y, &image->UnsafeAt(pos.add_y(y)), size.x);
+            texture.SetDataPart(pos, size, (const uint8_t *)upload_buffer.data());
+        }
+
+      public:
+        // The cache registers itself as `font`'s missing glyph function. `font`, `source` and `image` must outlive it.
+        // `region_size` is rounded down to a multiple of `page_size`.
+        GlyphCache(Font &font, const FontFile &source, FontFile::RenderMode render_mode, Image &image, ivec2 region_pos, ivec2 region_size, ivec2 page_size, bool add_gaps = 1)
+            : font(&font), source(&source), render_mode(render_mode), image(&image), page_size(page_size)
+        {
+            if (!image.RectInBounds(region_pos, region_size))
+                Program::Error("Invalid target rectangle for a glyph cache.");
+            if ((page_size <= 0).any() || (region_size < page_size).any())
+                Program::Error("Invalid page size for a glyph cache.");
+
+            ivec2 page_count = region_size / page_size;
+            for (int y = 0; y < page_count.y; y++)
+            for (int x = 0; x < page_count.x; x++)
+            {
+                Page &page = pages.emplace_back();
+                page.packer = Packing::Page(page_size, add_gaps);
+                page.pos = region_pos + page_size * ivec2(x,y);
+                image.UnsafeFill(page.pos, page_size, u8vec4(0));
+            }
+
+            font.SetMissingGlyphFunc([this](uint32_t ch){return Get(ch);});
+        }
+
+        ~GlyphCache()
+        {
+            font->SetMissingGlyphFunc(0);
+        }
+
+        // Returns null if the glyph can't be provided. You normally don't need to call this manually, since `Font::Get()` does it.
+        const Font::Glyph *Get(uint32_t ch)
+        {
+            if (auto it = entries.find(ch); it != entries.end())
+            {
+                stats.hits++;
+                pages[it->second.page].last_used_frame = frame;
+                return &it->second.glyph;
+            }
+
+            if (unavailable_chars.count(ch) || !source->HasGlyph(ch))
+            {
+                unavailable_chars.insert(ch);
+                return 0;
+            }
+
+            FontFile::GlyphData glyph_data;
+            try
+            {
+                glyph_data = source->GetGlyph(ch, render_mode);
+            }
+            catch (std::exception &)
+            {
+                unavailable_chars.insert(ch);
+                return 0;
+            }
+
+            Packing::Rect rect(glyph_data.image.Size());
+
+            // Check this before evicting anything, since no amount of free space would help.
+            if (!pages.front().packer.CanEverFit(rect.size))
+            {
+                unavailable_chars.insert(ch);
+                return 0;
+            }
+
+            int page_index = -1;
+            for (std::size_t i = 0; i < pages.size(); i++)
+            {
+                if (pages[i].packer.Insert(rect))
+                {
+                    page_index = i;
+                    break;
+                }
+            }
+
+            if (page_index == -1)
+            {
+                // Find the least recently used page that wasn't used during this frame.
+                for (std::size_t i = 0; i < pages.size(); i++)
+                {
+                    if (pages[i].last_used_frame < frame && (page_index == -1 || pages[i].last_used_frame < pages[page_index].last_used_frame))
+                        page_index = i;
+                }
+
+                if (page_index == -1)
+                {
+                    stats.fallbacks++;
+                    font->BumpGeneration(); // Anything shaped with the default glyph in place of this one should be rebuilt later, when there's space.
+                    return 0;
+                }
+
+                EvictPage(pages[page_index]);
+                if (!pages[page_index].packer.Insert(rect))
+                {
+                    unavailable_chars.insert(ch); // Shouldn't happen, since we've checked the size above.
+                    return 0;
+                }
+            }
+
+            stats.misses++;
+
+            Page &page = pages[page_index];
+            ivec2 glyph_pos = page.pos + rect.pos;
+            image->UnsafeDrawImage(glyph_data.image, glyph_pos);
+            if (!page.fully_dirty)
+                page.dirty_rects.push_back({glyph_pos, glyph_data.image.Size()});
+            page.chars.push_back(ch);
+            page.last_used_frame = frame;
+
+            Entry &entry = entries[ch];
+            entry.page = page_index;
+            entry.glyph.texture_pos = glyph_pos;
+            entry.glyph.size = glyph_data.image.Size();
+            entry.glyph.offset = glyph_data.offset;
+            entry.glyph.advance = glyph_data.advance;
+            return &entry.glyph;
+        }
+
+        // Call this once per frame. Pages used during the current frame are never evicted.
+        void NextFrame()
+        {
+            frame++;
+        }
+
+        [[nodiscard]] bool NeedsUpload() const
+        {
+            for (const Page &page : pages)
+            {
+                if (page.fully_dirty || page.dirty_rects.size() > 0)
+                    return true;
+            }
+            return false;
+        }
+
+        // Uploads the changed parts of the image to `texture`, which must have the same layout as the image.
+        void Upload(Texture &texture)
+        {
+            for (Page &page : pages)
+            {
+                if (page.fully_dirty)
+                {
+                    UploadRect(texture, page.pos, page_size);
+                }
+                else
+                {
+                    for (const auto &[pos, size] : page.dirty_rects)
+                        UploadRect(texture, pos, size);
+                }
+
+                page.fully_dirty = false;
+                page.dirty_rects.clear();
+            }
+        }
+
+        // Removes all glyphs from the cache.
+        void Clear()
+        {
+            for (Page &page : pages)
+                EvictPage(page);
+            unavailable_chars.clear();
+        }
+
+        [[nodiscard]] int GlyphCount() const
+        {
+            return entries.size();
+        }
+        [[nodiscard]] int PageCount() const
+        {
+            return pages.size();
+        }
+        [[nodiscard]] const Stats &GetStats() const
+        {
+            return stats;
+        }
+    };
+}
@@ -1,19 +1,27 @@
 #pragma once
 
 #include <algorithm>
+#include <string>
 #include <vector>
 #include <utility>
 
+#include "graphics/image_kernels.h"
 #include "program/errors.h"
 #include "utils/finally.h"
 #include "utils/mat.h"
 #include "utils/memory_file.h"
+#include "utils/thread_pool.h"
 
 #include <stb_image.h>
 #include <stb_image_write.h>
 
 namespace Graphics
 {
+    namespace Detail
+    {
+        extern thread_local int png_compression_level; // Defined in `lib/implementation.cpp`. Negative means `stbi_write_png_compression_level`.
+    }
+
     class Image
     {
         // Note that moved-from instance is left in an invalid (yet destructable) state.
@@ -39,13 +47,27 @@ namespace Graphics
         }
         Image(MemoryFile file, FlipMode flip_mode = no_flip) // Throws on failure.
         {
-            stbi_set_flip_vertically_on_load(flip_mode == flip_y);
+            // We don't use `stbi_set_flip_vertically_on_load()`, since it's a global setting and we want to be able to load images from several threads.
             ivec2 img_size;
             uint8_t *bytes = stbi_load_from_memory(file.data(), file.size(), &img_size.x, &img_size.y, 0, 4);
             if (!bytes)
                 Program::Error("Unable to parse image: ", file.name());
             FINALLY( stbi_image_free(bytes); )
             *this = Image(img_size, bytes);
+            if (flip_mode == flip_y)
+                FlipY();
+        }
+
+        // Loads several images in parallel. Throws on failure, in that case the first error is reported.
+        // At most one file per thread is kept in memory at a time, in addition to the resulting images.
+        [[nodiscard]] static std::vector<Image> LoadBatch(const std::vector<std::string> &file_names, FlipMode flip_mode = no_flip, ThreadPool &pool = ThreadPool::Global())
+        {
+            std::vector<Image> ret(file_names.size());
+            pool.ForEach(file_names.size(), [&](int i)
+            {
+                ret[i] = Image(file_names[i], flip_mode);
+            });
+            return ret;
         }
 
         explicit operator bool() const {return data.size() > 0;}
@@ -63,7 +85,10 @@ namespace Graphics
             return (rect_pos >= 0).all() && (rect_pos + rect_size <= size).all() && (rect_size >= 0).all();
         }
 
-        void Save(std::string file_name, Format format = png) // Throws on failure.
+        // Compression levels range from 0 (fastest, no compression) to 9 (slowest, best compression). Only affect PNG.
+        static constexpr int default_png_compression = 8, fast_png_compression = 1;
+
+        void Save(std::string file_name, Format format = png, int png_compression = default_png_compression) const // Throws on failure.
         {
             if (!*this)
                 Program::Error("Attempt to save an empty image to a file.");
@@ -72,7 +97,12 @@ namespace Graphics
             switch (format)
             {
               case png:
-                ok = stbi_write_png(file_name.c_str(), size.x, size.y, 4, data.data(), 0);
+                {
+                    // `stbi_write_png_compression_level` is global, so we use a thread-local override instead. See `lib/implementation.cpp`.
+                    int old_level = std::exchange(Detail::png_compression_level, png_compression);
+                    FINALLY( Detail::png_compression_level = old_level; )
+                    ok = stbi_write_png(file_name.c_str(), size.x, size.y, 4, data.data(), 0);
+                }
                 break;
               case tga:
                 ok = stbi_write_tga(file_name.c_str(), size.x, size.y, 4, data.data());
@@ -83,6 +113,28 @@ namespace Graphics
                 Program::Error("Unable to write image to file: ", file_name);
         }
 
+        struct SaveRequest
+        {
+            const Image *image = 0;
+            std::string file_name;
+            Format format = png;
+        };
+
+        // Saves several images in parallel. Throws on failure, in that case the first error is reported.
+        static void SaveBatch(const std::vector<SaveRequest> &requests, int png_compression = default_png_compression, ThreadPool &pool = ThreadPool::Global())
+        {
+            pool.ForEach(requests.size(), [&](int i)
+            {
+                requests[i].image->Save(requests[i].file_name, requests[i].format, png_compression);
+            });
+        }
+
+        void FlipY()
+        {
+            for (int y = 0; y < size.y / 2; y++)
+                std::swap_ranges(data.begin() + y * size.x, data.begin() + (y + 1) * size.x, data.begin() + (size.y - y - 1) * size.x);
+        }
+
         u8vec4 &UnsafeAt(ivec2 pos)
         {
             return const_cast<u8vec4 &>(std::as_const(*this).UnsafeAt(pos));
@@ -107,18 +159,65 @@ namespace Graphics
 
         void UnsafeFill(ivec2 rect_pos, ivec2 rect_size, u8vec4 color)
         {
+            if (rect_size.x <= 0)
+                return;
             for (int y = rect_pos.y; y < rect_pos.y + rect_size.y; y++)
-            for (int x = rect_pos.x; x < rect_pos.x + rect_size.x; x++)
-                UnsafeAt(ivec2(x,y)) = color;
+                ImageKernels::Fill(&UnsafeAt(ivec2(rect_pos.x, y)), rect_size.x, color);
         }
 
         void UnsafeDrawImage(const Image &other, ivec2 pos) // Copies other image into this image, at specified location.
         {
+            if (other.Size().x <= 0)
+                return;
             for (int y = 0; y < other.Size().y; y++)
-            {
-                auto source_address = &other.UnsafeAt(ivec2(0,y));
-                std::copy(source_address, source_address + other.Size().x, &UnsafeAt(pos.add_y(y)));
-            }
+                ImageKernels::Copy(&UnsafeAt(pos.add_y(y)), &other.UnsafeAt(ivec2(0,y)), other.Size().x);
+        }
+
+        void UnsafeBlendImage(const Image &other, ivec2 pos) // Draws other image on top of this image, at specified location. See `ImageKernels::Blend()` for the formula.
+        {
+            if (other.Size().x <= 0)
+                return;
+            for (int y = 0; y < other.Size().y; y++)
+                ImageKernels::Blend(&UnsafeAt(pos.add_y(y)), &other.UnsafeAt(ivec2(0,y)), other.Size().x);
+        }
+
+        void Premultiply()
+        {
+            ImageKernels::Premultiply(data.data(), data.size());
+        }
+        void Unpremultiply()
+        {
+            ImageKernels::Unpremultiply(data.data(), data.size());
+        }
+
+        // Those construct an image from 8-bit single channel data. If `pitch` is 0, the rows are assumed to be tightly packed.
+        [[nodiscard]] static Image FromGrayscale(ivec2 size, const uint8_t *bytes, int pitch = 0) // Produces opaque pixels.
+        {
+            return FromSingleChannel(size, bytes, pitch, ImageKernels::GrayToRgba);
+        }
+        [[nodiscard]] static Image FromAlpha(ivec2 size, const uint8_t *bytes, int pitch = 0) // Produces white pixels with the specified alpha.
+        {
+            return FromSingleChannel(size, bytes, pitch, ImageKernels::AlphaToRgba);
+        }
+
+        [[nodiscard]] std::vector<uint8_t> ToGrayscale() const // Alpha is ignored.
+        {
+            std::vector<uint8_t> ret(data.size());
+            ImageKernels::RgbaToGray(ret.data(), data.data(), data.size());
+            return ret;
+        }
+
+      private:
+        static Image FromSingleChannel(ivec2 size, const uint8_t *bytes, int pitch, void (*convert)(u8vec4 *, const uint8_t *, std::size_t))
+        {
+            if (pitch == 0)
+                pitch = size.x;
+            Image ret(size);
+            if (size.x <= 0)
+                return ret;
+            for (int y = 0; y < size.y; y++)
+                convert(&ret.UnsafeAt(ivec2(0,y)), bytes + pitch * y, size.x);
+            return ret;
         }
     };
 }
@@ -0,0 +1,479 @@
+#include "image_kernels.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define IMAGE_KERNELS_X86
+#include <immintrin.h>
+#define IMAGE_KERNELS_SSE2 __attribute__((target("sse2")))
+#define IMAGE_KERNELS_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace Graphics::ImageKernels
+{
+    namespace
+    {
+        using std::size_t;
+
+        // Divides by 255 with rounding to nearest. Exact for `x <= 255*255`.
+        [[nodiscard]] inline uint32_t Div255(uint32_t x)
+        {
+            x += 128;
+            return (x + (x >> 8)) >> 8;
+        }
+
+        [[nodiscard]] inline uint32_t ToBits(u8vec4 color)
+        {
+            uint32_t ret;
+            std::memcpy(&ret, &color, sizeof ret);
+            return ret;
+        }
+
+
+        // --- Scalar.
+
+        void FillScalar(u8vec4 *dst, size_t count, u8vec4 color)
+        {
+            std::fill_n(dst, count, color);
+        }
+
+        void BlendScalar(u8vec4 *dst, const u8vec4 *src, size_t count)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                u8vec4 s = src[i], d = dst[i];
+                uint32_t inv = 255 - s.a;
+                dst[i] = u8vec4(Div255(s.r * s.a + d.r * inv), Div255(s.g * s.a + d.g * inv), Div255(s.b * s.a + d.b * inv), Div255(s.a * 255 + d.a * inv));
+            }
+        }
+
+        void PremultiplyScalar(u8vec4 *pixels, size_t count)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                u8vec4 &p = pixels[i];
+                p = u8vec4(Div255(p.r * p.a), Div255(p.g * p.a), Div255(p.b * p.a), p.a);
+            }
+        }
+
+        void UnpremultiplyScalar(u8vec4 *pixels, size_t count)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                u8vec4 &p = pixels[i];
+                if (p.a == 0)
+                {
+                    p = u8vec4(0);
+                    continue;
+                }
+                // This matches the vectorized versions exactly, since they perform the same float operations.
+                float factor = 255.f / p.a;
+                auto channel = [&](uint8_t c) -> uint8_t {return std::min(255, int(c * factor + 0.5f));};
+                p = u8vec4(channel(p.r), channel(p.g), channel(p.b), p.a);
+            }
+        }
+
+        void GrayToRgbaScalar(u8vec4 *dst, const uint8_t *src, size_t count)
+        {
+            for (size_t i = 0; i < count; i++)
+                dst[i] = u8vec3(src[i]).to_vec4(255);
+        }
+
+        void AlphaToRgbaScalar(u8vec4 *dst, const uint8_t *src, size_t count)
+        {
+            for (size_t i = 0; i < count; i++)
+                dst[i] = u8vec3(255).to_vec4(src[i]);
+        }
+
+        void RgbaToGrayScalar(uint8_t *dst, const u8vec4 *src, size_t count)
+        {
+            for (size_t i = 0; i < count; i++)
+                dst[i] = (77 * src[i].r + 150 * src[i].g + 29 * src[i].b + 128) >> 8;
+        }
+
+
+        #ifdef IMAGE_KERNELS_X86
+
+        // --- SSE2.
+
+        // Divides 16-bit lanes by 255, see `Div255()`.
+        IMAGE_KERNELS_SSE2 inline __m128i Div255Sse2(__m128i x)
+        {
+            x = _mm_add_epi16(x, _mm_set1_epi16(128));
+            return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+        }
+
+        // Accepts two pixels in 16-bit lanes. Returns `(a,a,a,255)` for each of them.
+        IMAGE_KERNELS_SSE2 inline __m128i AlphaFactorSse2(__m128i pixels)
+        {
+            __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels, 0xff), 0xff);
+            return _mm_or_si128(_mm_and_si128(alpha, _mm_set_epi16(0,-1,-1,-1,0,-1,-1,-1)), _mm_set_epi16(255,0,0,0,255,0,0,0));
+        }
+
+        IMAGE_KERNELS_SSE2 void FillSse2(u8vec4 *dst, size_t count, u8vec4 color)
+        {
+            __m128i value = _mm_set1_epi32(ToBits(color));
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4)
+                _mm_storeu_si128((__m128i *)(dst + i), value);
+            FillScalar(dst + i, count - i, color);
+        }
+
+        IMAGE_KERNELS_SSE2 void BlendSse2(u8vec4 *dst, const u8vec4 *src, size_t count)
+        {
+            __m128i zero = _mm_setzero_si128();
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4)
+            {
+                __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+                __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+
+                __m128i s_lo = _mm_unpacklo_epi8(s, zero), s_hi = _mm_unpackhi_epi8(s, zero);
+                __m128i d_lo = _mm_unpacklo_epi8(d, zero), d_hi = _mm_unpackhi_epi8(d, zero);
+
+                __m128i inv_lo = _mm_sub_epi16(_mm_set1_epi16(255), _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_lo, 0xff), 0xff));
+                __m128i inv_hi = _mm_sub_epi16(_mm_set1_epi16(255), _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_hi, 0xff), 0xff));
+
+                __m128i r_lo = Div255Sse2(_mm_add_epi16(_mm_mullo_epi16(s_lo, AlphaFactorSse2(s_lo)), _mm_mullo_epi16(d_lo, inv_lo)));
+                __m128i r_hi = Div255Sse2(_mm_add_epi16(_mm_mullo_epi16(s_hi, AlphaFactorSse2(s_hi)), _mm_mullo_epi16(d_hi, inv_hi)));
+
+                _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(r_lo, r_hi));
+            }
+            BlendScalar(dst + i, src + i, count - i);
+        }
+
+        IMAGE_KERNELS_SSE2 void PremultiplySse2(u8vec4 *pixels, size_t count)
+        {
+            __m128i zero = _mm_setzero_si128();
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4)
+            {
+                __m128i p = _mm_loadu_si128((const __m128i *)(pixels + i));
+                __m128i lo = _mm_unpacklo_epi8(p, zero), hi = _mm_unpackhi_epi8(p, zero);
+                lo = Div255Sse2(_mm_mullo_epi16(lo, AlphaFactorSse2(lo)));
+                hi = Div255Sse2(_mm_mullo_epi16(hi, AlphaFactorSse2(hi)));
+                _mm_storeu_si128((__m128i *)(pixels + i), _mm_packus_epi16(lo, hi));
+            }
+            PremultiplyScalar(pixels + i, count - i);
+        }
+
+        // Accepts a single pixel in 32-bit lanes.
+        IMAGE_KERNELS_SSE2 inline __m128i UnpremultiplyPixelSse2(__m128i pixel)
+        {
+            __m128 value = _mm_cvtepi32_ps(pixel);
+            __m128 alpha = _mm_shuffle_ps(value, value, 0xff);
+            __m128 nonzero = _mm_cmpneq_ps(alpha, _mm_setzero_ps());
+            __m128 factor = _mm_div_ps(_mm_set1_ps(255), _mm_max_ps(alpha, _mm_set1_ps(1)));
+            factor = _mm_or_ps(_mm_and_ps(factor, _mm_castsi128_ps(_mm_set_epi32(0,-1,-1,-1))), _mm_set_ps(1,0,0,0)); // Leave alpha as is.
+            __m128i ret = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, factor), _mm_set1_ps(0.5f)));
+            return _mm_and_si128(ret, _mm_castps_si128(nonzero));
+        }
+
+        IMAGE_KERNELS_SSE2 void UnpremultiplySse2(u8vec4 *pixels, size_t count)
+        {
+            __m128i zero = _mm_setzero_si128();
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4)
+            {
+                __m128i p = _mm_loadu_si128((const __m128i *)(pixels + i));
+                __m128i lo = _mm_unpacklo_epi8(p, zero), hi = _mm_unpackhi_epi8(p, zero);
+                __m128i p0 = UnpremultiplyPixelSse2(_mm_unpacklo_epi16(lo, zero));
+                __m128i p1 = UnpremultiplyPixelSse2(_mm_unpackhi_epi16(lo, zero));
+                __m128i p2 = UnpremultiplyPixelSse2(_mm_unpacklo_epi16(hi, zero));
+                __m128i p3 = UnpremultiplyPixelSse2(_mm_unpackhi_epi16(hi, zero));
+                _mm_storeu_si128((__m128i *)(pixels + i), _mm_packus_epi16(_mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3)));
+            }
+            UnpremultiplyScalar(pixels + i, count - i);
+        }
+
+        IMAGE_KERNELS_SSE2 void GrayToRgbaSse2(u8vec4 *dst, const uint8_t *src, size_t count)
+        {
+            __m128i opaque = _mm_set1_epi32(0xff000000);
+            size_t i = 0;
+            for (; i + 16 <= count; i += 16)
+            {
+                __m128i g = _mm_loadu_si128((const __m128i *)(src + i));
+                __m128i gg_lo = _mm_unpacklo_epi8(g, g), gg_hi = _mm_unpackhi_epi8(g, g);
+                _mm_storeu_si128((__m128i *)(dst + i     ), _mm_or_si128(_mm_unpacklo_epi16(gg_lo, gg_lo), opaque));
+                _mm_storeu_si128((__m128i *)(dst + i + 4 ), _mm_or_si128(_mm_unpackhi_epi16(gg_lo, gg_lo), opaque));
+                _mm_storeu_si128((__m128i *)(dst + i + 8 ), _mm_or_si128(_mm_unpacklo_epi16(gg_hi, gg_hi), opaque));
+                _mm_storeu_si128((__m128i *)(dst + i + 12), _mm_or_si128(_mm_unpackhi_epi16(gg_hi, gg_hi), opaque));
+            }
+            GrayToRgbaScalar(dst + i, src + i, count - i);
+        }
+
+        IMAGE_KERNELS_SSE2 void AlphaToRgbaSse2(u8vec4 *dst, const uint8_t *src, size_t count)
+        {
+            __m128i ones = _mm_set1_epi32(-1);
+            size_t i = 0;
+            for (; i + 16 <= count; i += 16)
+            {
+                __m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+                __m128i ba_lo = _mm_unpacklo_epi8(ones, a), ba_hi = _mm_unpackhi_epi8(ones, a);
+                _mm_storeu_si128((__m128i *)(dst + i     ), _mm_unpacklo_epi16(ones, ba_lo));
+                _mm_storeu_si128((__m128i *)(dst + i + 4 ), _mm_unpackhi_epi16(ones, ba_lo));
+                _mm_storeu_si128((__m128i *)(dst + i + 8 ), _mm_unpacklo_epi16(ones, ba_hi));
+                _mm_storeu_si128((__m128i *)(dst + i + 12), _mm_unpackhi_epi16(ones, ba_hi));
+            }
+            AlphaToRgbaScalar(dst + i, src + i, count - i);
+        }
+
+        IMAGE_KERNELS_SSE2 void RgbaToGraySse2(uint8_t *dst, const u8vec4 *src, size_t count)
+        {
+            __m128i zero = _mm_setzero_si128();
+            __m128i weights = _mm_set_epi16(0,29,150,77,0,29,150,77);
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4)
+            {
+                __m128i p = _mm_loadu_si128((const __m128i *)(src + i));
+                __m128i sums_lo = _mm_madd_epi16(_mm_unpacklo_epi8(p, zero), weights); // `r*77+g*150, b*29` for two pixels.
+                __m128i sums_hi = _mm_madd_epi16(_mm_unpackhi_epi8(p, zero), weights);
+                __m128 even = _mm_shuffle_ps(_mm_castsi128_ps(sums_lo), _mm_castsi128_ps(sums_hi), _MM_SHUFFLE(2,0,2,0));
+                __m128 odd  = _mm_shuffle_ps(_mm_castsi128_ps(sums_lo), _mm_castsi128_ps(sums_hi), _MM_SHUFFLE(3,1,3,1));
+                __m128i luma = _mm_add_epi32(_mm_castps_si128(even), _mm_castps_si128(odd));
+                luma = _mm_srli_epi32(_mm_add_epi32(luma, _mm_set1_epi32(128)), 8);
+                luma = _mm_packus_epi16(_mm_packs_epi32(luma, zero), zero);
+                uint32_t bytes = _mm_cvtsi128_si32(luma);
+                std::memcpy(dst + i, &bytes, sizeof bytes);
+            }
+            RgbaToGrayScalar(dst + i, src + i, count - i);
+        }
+
+
+        // --- AVX2.
+
+        IMAGE_KERNELS_AVX2 inline __m256i Div255Avx2(__m256i x)
+        {
+            x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+            return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+        }
+
+        IMAGE_KERNELS_AVX2 inline __m256i AlphaFactorAvx2(__m256i pixels)
+        {
+            __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(pixels, 0xff), 0xff);
+            return _mm256_or_si256(_mm256_and_si256(alpha, _mm256_set1_epi64x(0x0000ffffffffffff)), _mm256_set1_epi64x(0x00ff000000000000));
+        }
+
+        IMAGE_KERNELS_AVX2 void FillAvx2(u8vec4 *dst, size_t count, u8vec4 color)
+        {
+            __m256i value = _mm256_set1_epi32(ToBits(color));
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8)
+                _mm256_storeu_si256((__m256i *)(dst + i), value);
+            FillScalar(dst + i, count - i, color);
+        }
+
+        IMAGE_KERNELS_AVX2 void BlendAvx2(u8vec4 *dst, const u8vec4 *src, size_t count)
+        {
+            // Unpacking and packing work within 128-bit lanes, so the pixel order is preserved.
+            __m256i zero = _mm256_setzero_si256();
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                __m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+                __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+
+                __m256i s_lo = _mm256_unpacklo_epi8(s, zero), s_hi = _mm256_unpackhi_epi8(s, zero);
+                __m256i d_lo = _mm256_unpacklo_epi8(d, zero), d_hi = _mm256_unpackhi_epi8(d, zero);
+
+                __m256i inv_lo = _mm256_sub_epi16(_mm256_set1_epi16(255), _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s_lo, 0xff), 0xff));
+                __m256i inv_hi = _mm256_sub_epi16(_mm256_set1_epi16(255), _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s_hi, 0xff), 0xff));
+
+                __m256i r_lo = Div255Avx2(_mm256_add_epi16(_mm256_mullo_epi16(s_lo, AlphaFactorAvx2(s_lo)), _mm256_mullo_epi16(d_lo, inv_lo)));
+                __m256i r_hi = Div255Avx2(_mm256_add_epi16(_mm256_mullo_epi16(s_hi, AlphaFactorAvx2(s_hi)), _mm256_mullo_epi16(d_hi, inv_hi)));
+
+                _mm256_storeu_si256((__m256i *)(dst + i), _mm256_packus_epi16(r_lo, r_hi));
+            }
+            BlendScalar(dst + i, src + i, count - i);
+        }
+
+        IMAGE_KERNELS_AVX2 void PremultiplyAvx2(u8vec4 *pixels, size_t count)
+        {
+            __m256i zero = _mm256_setzero_si256();
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                __m256i p = _mm256_loadu_si256((const __m256i *)(pixels + i));
+                __m256i lo = _mm256_unpacklo_epi8(p, zero), hi = _mm256_unpackhi_epi8(p, zero);
+                lo = Div255Avx2(_mm256_mullo_epi16(lo, AlphaFactorAvx2(lo)));
+                hi = Div255Avx2(_mm256_mullo_epi16(hi, AlphaFactorAvx2(hi)));
+                _mm256_storeu_si256((__m256i *)(pixels + i), _mm256_packus_epi16(lo, hi));
+            }
+            PremultiplyScalar(pixels + i, count - i);
+        }
+
+        IMAGE_KERNELS_AVX2 void UnpremultiplyAvx2(u8vec4 *pixels, size_t count)
+        {
+            size_t i = 0;
+            for (; i + 2 <= count; i += 2)
+            {
+                // Two pixels per iteration, one in each 128-bit lane.
+                __m256i p = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(pixels + i)));
+                __m256 value = _mm256_cvtepi32_ps(p);
+                __m256 alpha = _mm256_shuffle_ps(value, value, 0xff);
+                __m256 nonzero = _mm256_cmp_ps(alpha, _mm256_setzero_ps(), _CMP_NEQ_UQ);
+                __m256 factor = _mm256_div_ps(_mm256_set1_ps(255), _mm256_max_ps(alpha, _mm256_set1_ps(1)));
+                factor = _mm256_blend_ps(factor, _mm256_set1_ps(1), 0b10001000); // Leave alpha as is.
+                __m256i ret = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(value, factor), _mm256_set1_ps(0.5f)));
+                ret = _mm256_and_si256(ret, _mm256_castps_si256(nonzero));
+                __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(ret), _mm256_extracti128_si256(ret, 1));
+                _mm_storel_epi64((__m128i *)(pixels + i), _mm_packus_epi16(packed, packed));
+            }
+            UnpremultiplyScalar(pixels + i, count - i);
+        }
+
+        IMAGE_KERNELS_AVX2 void GrayToRgbaAvx2(u8vec4 *dst, const uint8_t *src, size_t count)
+        {
+            __m256i opaque = _mm256_set1_epi32(0xff000000);
+            __m256i spread = _mm256_set1_epi32(0x010101);
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                __m256i g = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + i)));
+                _mm256_storeu_si256((__m256i *)(dst + i), _mm256_or_si256(_mm256_mullo_epi32(g, spread), opaque));
+            }
+            GrayToRgbaScalar(dst + i, src + i, count - i);
+        }
+
+        IMAGE_KERNELS_AVX2 void AlphaToRgbaAvx2(u8vec4 *dst, const uint8_t *src, size_t count)
+        {
+            __m256i white = _mm256_set1_epi32(0xffffff);
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                __m256i a = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + i)));
+                _mm256_storeu_si256((__m256i *)(dst + i), _mm256_or_si256(_mm256_slli_epi32(a, 24), white));
+            }
+            AlphaToRgbaScalar(dst + i, src + i, count - i);
+        }
+
+        #endif
+
+
+        struct Table
+        {
+            void (*fill)(u8vec4 *, size_t, u8vec4);
+            void (*blend)(u8vec4 *, const u8vec4 *, size_t);
+            void (*premultiply)(u8vec4 *, size_t);
+            void (*unpremultiply)(u8vec4 *, size_t);
+            void (*gray_to_rgba)(u8vec4 *, const uint8_t *, size_t);
+            void (*alpha_to_rgba)(u8vec4 *, const uint8_t *, size_t);
+            void (*rgba_to_gray)(uint8_t *, const u8vec4 *, size_t);
+        };
+
+        constexpr Table scalar_table{FillScalar, BlendScalar, PremultiplyScalar, UnpremultiplyScalar, GrayToRgbaScalar, AlphaToRgbaScalar, RgbaToGrayScalar};
+        #ifdef IMAGE_KERNELS_X86
+        constexpr Table sse2_table{FillSse2, BlendSse2, PremultiplySse2, UnpremultiplySse2, GrayToRgbaSse2, AlphaToRgbaSse2, RgbaToGraySse2};
+        constexpr Table avx2_table{FillAvx2, BlendAvx2, PremultiplyAvx2, UnpremultiplyAvx2, GrayToRgbaAvx2, AlphaToRgbaAvx2, RgbaToGraySse2}; // Luma doesn't benefit from wider registers.
+        #endif
+
+        [[nodiscard]] const Table &TableForIsa(Isa isa)
+        {
+            switch (isa)
+            {
+              #ifdef IMAGE_KERNELS_X86
+              case Isa::avx2:
+                return avx2_table;
+              case Isa::sse2:
+                return sse2_table;
+              #endif
+              default:
+                return scalar_table;
+            }
+        }
+
+        // A function-local static, so that the kernels can be used during static initialization.
+        [[nodiscard]] const Table *&CurrentTable()
+        {
+            static const Table *ret = &TableForIsa(BestSupportedIsa());
+            return ret;
+        }
+
+        [[nodiscard]] Isa &CurrentIsaRef()
+        {
+            static Isa ret = BestSupportedIsa();
+            return ret;
+        }
+    }
+
+    Isa BestSupportedIsa()
+    {
+        static const Isa ret = []{
+            #ifdef IMAGE_KERNELS_X86
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2"))
+                return Isa::avx2;
+            if (__builtin_cpu_supports("sse2"))
+                return Isa::sse2;
+            #endif
+            return Isa::scalar;
+        }();
+        return ret;
+    }
+
+    Isa CurrentIsa()
+    {
+        return CurrentIsaRef();
+    }
+
+    void SetIsa(Isa isa)
+    {
+        isa = std::min(isa, BestSupportedIsa());
+        CurrentIsaRef() = isa;
+        CurrentTable() = &TableForIsa(isa);
+    }
+
+    const char *IsaName(Isa isa)
+    {
+        switch (isa)
+        {
+            case Isa::scalar: return "scalar";
+            case Isa::sse2:   return "SSE2";
+            case Isa::avx2:   return "AVX2";
+        }
+        return "unknown";
+    }
+
+    void Fill(u8vec4 *dst, std::size_t count, u8vec4 color)
+    {
+        CurrentTable()->fill(dst, count, color);
+    }
+
+    void Copy(u8vec4 *dst, const u8vec4 *src, std::size_t count)
+    {
+        // `memcpy` is already vectorized by the standard library, there's nothing to dispatch here.
+        if (count > 0)
+            std::memcpy(dst, src, count * sizeof(u8vec4));
+    }
+
+    void Blend(u8vec4 *dst, const u8vec4 *src, std::size_t count)
+    {
+        CurrentTable()->blend(dst, src, count);
+    }
+
+    void Premultiply(u8vec4 *pixels, std::size_t count)
+    {
+        CurrentTable()->premultiply(pixels, count);
+    }
+
+    void Unpremultiply(u8vec4 *pixels, std::size_t count)
+    {
+        CurrentTable()->unpremultiply(pixels, count);
+    }
+
+    void GrayToRgba(u8vec4 *dst, const uint8_t *src, std::size_t count)
+    {
+        CurrentTable()->gray_to_rgba(dst, src, count);
+    }
+
+    void AlphaToRgba(u8vec4 *dst, const uint8_t *src, std::size_t count)
+    {
+        CurrentTable()->alpha_to_rgba(dst, src, count);
+    }
+
+    void RgbaToGray(uint8_t *dst, const u8vec4 *src, std::size_t count)
+    {
+        CurrentTable()->rgba_to_gray(dst, src, count);
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "utils/mat.h"
+
+namespace Graphics::ImageKernels
+{
+    // Pixel processing routines used by `Image` and the font rasterizer.
+    // Each one has a scalar version and SSE2/AVX2 versions on x86. The best supported one is selected at startup.
+    // All versions of a kernel produce bit-identical results.
+
+    enum class Isa {scalar, sse2, avx2};
+
+    [[nodiscard]] Isa BestSupportedIsa();
+    [[nodiscard]] Isa CurrentIsa();
+    void SetIsa(Isa isa); // If `isa` is not supported, the best supported one below it is used. Not thread-safe, meant for comparing the implementations.
+    [[nodiscard]] const char *IsaName(Isa isa);
+
+    void Fill(u8vec4 *dst, std::size_t count, u8vec4 color);
+    void Copy(u8vec4 *dst, const u8vec4 *src, std::size_t count); // The ranges must not overlap.
+
+    // `dst.rgb = src.rgb * src.a + dst.rgb * (1 - src.a)`, `dst.a = src.a + dst.a * (1 - src.a)`. Rounds to nearest.
+    void Blend(u8vec4 *dst, const u8vec4 *src, std::size_t count);
+    void Premultiply(u8vec4 *pixels, std::size_t count); // `rgb = rgb * a`, rounds to nearest.
+    void Unpremultiply(u8vec4 *pixels, std::size_t count); // `rgb = min(rgb / a, 1)`, rounds to nearest. Pixels with zero alpha become transparent black.
+
+    void GrayToRgba(u8vec4 *dst, const uint8_t *src, std::size_t count); // Produces opaque pixels.
+    void AlphaToRgba(u8vec4 *dst, const uint8_t *src, std::size_t count); // Produces white pixels with the specified alpha.
+    void RgbaToGray(uint8_t *dst, const u8vec4 *src, std::size_t count); // Uses the Rec. 601 luma weights. Alpha is ignored.
+}
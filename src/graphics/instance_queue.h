@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "graphics/streaming_buffer.h"
+#include "vertex_buffer.h"
+
+namespace Graphics
+{
+    /* Collects per-instance records of type `I`, and draws them with instancing.
+     * Each instance is drawn as the same indexed mesh made of vertices of type `V`. The mesh is usually tiny, e.g. a single quad,
+     * and the vertex shader expands it using the per-instance attributes. Attribute locations of `V` come first, then those of `I`,
+     * so the shader should use `Meta::tag<Meta::type_list<V, I>>`.
+     *
+     * Requires `Extensions::InstancedArrays()`. Streaming modes work the same way as in `RenderQueue`.
+     */
+
+    template <typename V, typename I> class InstanceQueue
+    {
+        static_assert(Graphics::VertexBuffer<V>::is_reflected && Graphics::VertexBuffer<I>::is_reflected, "The types must be reflected.");
+
+        int pos = 0, size = 0; // These are measured in instances.
+        DrawMode draw_mode = triangles;
+        Graphics::VertexBuffer<V> vertices = nullptr;
+        Graphics::IndexBuffer<uint32_t> indices = nullptr;
+        StreamingBuffer<I> instances = nullptr; // Holds `size` instances per segment.
+
+      public:
+        InstanceQueue(decltype(nullptr)) {}
+        InstanceQueue(DrawMode draw_mode, const std::vector<V> &vertex_data, const std::vector<uint32_t> &index_data, int size, StreamingMode mode = StreamingMode::sub_data)
+            : size(size), draw_mode(draw_mode), vertices(vertex_data.size(), vertex_data.data()), indices(index_data.size(), index_data.data()), instances(size, mode)
+        {}
+
+        explicit operator bool()
+        {
+            return bool(instances);
+        }
+
+        int Size() const
+        {
+            return size;
+        }
+
+        StreamingMode Mode() const
+        {
+            return instances.Mode();
+        }
+
+        // How many times `Flush()` had to block because the GPU was still reading the next segment. Only changes in the persistent mode.
+        int FenceWaitCount() const
+        {
+            return instances.FenceWaitCount();
+        }
+
+        // How many draw calls were issued so far.
+        int DrawCallCount() const
+        {
+            return instances.DrawCallCount();
+        }
+
+        [[nodiscard]] bool IsEmpty() const
+        {
+            return pos == 0;
+        }
+
+        void Flush()
+        {
+            if (pos <= 0)
+                return;
+
+            instances.Flush(pos, [&](int first_instance){indices.DrawInstanced(vertices, instances.Buffer(), first_instance, pos, draw_mode);});
+            pos = 0;
+        }
+
+        void Add(const I &instance)
+        {
+            if (pos >= size)
+                Flush();
+            instances.WritePointer()[pos] = instance;
+            pos++;
+        }
+    };
+}
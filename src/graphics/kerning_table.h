@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "reflection/complete.h"
+
+namespace Graphics
+{
+    // A flat open-addressing hash table of kerning values for pairs of characters.
+    // Lookups are a single hash computation followed by a short linear probe, with no indirect calls.
+    class KerningTable
+    {
+      public:
+        ReflectStruct(Pair,(
+            (uint32_t)(first),
+            (uint32_t)(second),
+            (int)(value),
+            (using _refl_structure_tuple_tag = void;), // Enable terse string representation.
+        ))
+
+      private:
+        static constexpr uint64_t empty_key = uint64_t(-1); // Code points never exceed 32 bits, so this is never a valid key.
+
+        std::vector<uint64_t> keys;
+        std::vector<int16_t> values;
+        std::size_t count = 0;
+
+        [[nodiscard]] static uint64_t MakeKey(uint32_t a, uint32_t b)
+        {
+            return uint64_t(a) << 32 | b;
+        }
+        [[nodiscard]] static std::size_t Slot(uint64_t key, std::size_t mask)
+        {
+            // Multiplicative hashing. The constant is the 64-bit golden ratio.
+            return (key * 0x9E3779B97F4A7C15ull) >> 32 & mask;
+        }
+
+        void Rehash(std::size_t new_capacity)
+        {
+            std::vector<uint64_t> old_keys = std::move(keys);
+            std::vector<int16_t> old_values = std::move(values);
+
+            keys.assign(new_capacity, empty_key);
+            values.assign(new_capacity, 0);
+
+            std::size_t mask = new_capacity - 1;
+            for (std::size_t i = 0; i < old_keys.size(); i++)
+            {
+                if (old_keys[i] == empty_key)
+                    continue;
+                std::size_t slot = Slot(old_keys[i], mask);
+                while (keys[slot] != empty_key)
+                    slot = (slot + 1) & mask;
+                keys[slot] = old_keys[i];
+                values[slot] = old_values[i];
+            }
+        }
+
+      public:
+        KerningTable() {}
+        KerningTable(const std::vector<Pair> &pairs)
+        {
+            Reserve(pairs.size());
+            for (const Pair &pair : pairs)
+                Set(pair.first, pair.second, pair.value);
+        }
+
+        void Reserve(std::size_t pair_count)
+        {
+            // Keep the load factor at or below 1/2, so that the probes stay short.
+            std::size_t capacity = 16;
+            while (capacity < pair_count * 2)
+                capacity *= 2;
+            if (capacity > keys.size())
+                Rehash(capacity);
+        }
+
+        // Values are clamped to the `int16_t` range. Zero values are ignored, they never overwrite existing ones.
+        void Set(uint32_t a, uint32_t b, int value)
+        {
+            if (value == 0)
+                return;
+            if ((count + 1) * 2 > keys.size())
+                Rehash(std::max(std::size_t(16), keys.size() * 2));
+
+            uint64_t key = MakeKey(a, b);
+            std::size_t mask = keys.size() - 1;
+            std::size_t slot = Slot(key, mask);
+            while (keys[slot] != empty_key && keys[slot] != key)
+                slot = (slot + 1) & mask;
+
+            if (keys[slot] == empty_key)
+            {
+                keys[slot] = key;
+                count++;
+            }
+            values[slot] = std::clamp(value, -32768, 32767);
+        }
+
+        // Returns 0 if there's no kerning for this pair.
+        [[nodiscard]] int Get(uint32_t a, uint32_t b) const
+        {
+            if (count == 0)
+                return 0;
+
+            uint64_t key = MakeKey(a, b);
+            std::size_t mask = keys.size() - 1;
+            std::size_t slot = Slot(key, mask);
+            while (true)
+            {
+                if (keys[slot] == key)
+                    return values[slot];
+                if (keys[slot] == empty_key)
+                    return 0;
+                slot = (slot + 1) & mask;
+            }
+        }
+
+        [[nodiscard]] bool IsEmpty() const
+        {
+            return count == 0;
+        }
+        [[nodiscard]] std::size_t Size() const
+        {
+            return count;
+        }
+
+        // Returns all pairs, sorted. Use this for serialization.
+        [[nodiscard]] std::vector<Pair> ToPairs() const
+        {
+            std::vector<Pair> ret;
+            ret.reserve(count);
+            for (std::size_t i = 0; i < keys.size(); i++)
+            {
+                if (keys[i] == empty_key)
+                    continue;
+                Pair &pair = ret.emplace_back();
+                pair.first = keys[i] >> 32;
+                pair.second = uint32_t(keys[i]);
+                pair.value = values[i];
+            }
+            std::sort(ret.begin(), ret.end(), [](const Pair &a, const Pair &b){return MakeKey(a.first, a.second) < MakeKey(b.first, b.second);});
+            return ret;
+        }
+    };
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <GLFL/glfl.h>
+
+#include "program/errors.h"
+#include "utils/finally.h"
+
+namespace Graphics
+{
+    // A buffer for asynchronous pixel transfers.
+    // An upload buffer is a source for `glTexSubImage2D()`, and a download buffer is a destination for `glReadPixels()`.
+    // A bound pixel buffer changes the meaning of the pointers passed to those functions, so the functions below never leave it bound.
+    class PixelBuffer
+    {
+      public:
+        enum Direction
+        {
+            upload   = GL_PIXEL_UNPACK_BUFFER,
+            download = GL_PIXEL_PACK_BUFFER,
+        };
+
+      private:
+        struct Data
+        {
+            GLuint handle = 0;
+            Direction direction = upload;
+            int size = 0;
+            bool mapped = false;
+        };
+        Data data;
+
+      public:
+        PixelBuffer(decltype(nullptr)) {}
+
+        PixelBuffer(Direction direction, int bytes)
+        {
+            data.direction = direction;
+            glGenBuffers(1, &data.handle);
+            if (!data.handle)
+                Program::Error("Unable to create a pixel buffer.");
+            FINALLY_ON_THROW( glDeleteBuffers(1, &data.handle); )
+            SetSize(bytes);
+        }
+
+        PixelBuffer(PixelBuffer &&other) noexcept : data(std::exchange(other.data, {})) {}
+        PixelBuffer &operator=(PixelBuffer other) noexcept
+        {
+            std::swap(data, other.data);
+            return *this;
+        }
+
+        ~PixelBuffer()
+        {
+            if (data.handle)
+                glDeleteBuffers(1, &data.handle); // This also unmaps the buffer.
+        }
+
+        explicit operator bool() const
+        {
+            return bool(data.handle);
+        }
+
+        GLuint Handle() const
+        {
+            return data.handle;
+        }
+
+        Direction GetDirection() const
+        {
+            return data.direction;
+        }
+
+        int Size() const // In bytes.
+        {
+            return data.size;
+        }
+
+        [[nodiscard]] bool IsMapped() const
+        {
+            return data.mapped;
+        }
+
+        // Reallocates the storage. The contents are lost.
+        void SetSize(int bytes)
+        {
+            if (!*this)
+                return;
+            Bind();
+            glBufferData(data.direction, bytes, 0, data.direction == upload ? GL_STREAM_DRAW : GL_STREAM_READ);
+            Unbind();
+            data.size = bytes;
+            data.mapped = false;
+        }
+
+        // Binds the buffer, so that the pointers passed to the pixel transfer functions are treated as offsets into it.
+        // Don't forget to call `Unbind()` afterwards.
+        void Bind() const
+        {
+            if (!*this)
+                return;
+            glBindBuffer(data.direction, data.handle);
+        }
+        void Unbind() const
+        {
+            glBindBuffer(data.direction, 0);
+        }
+
+        // Maps the whole buffer. Upload buffers are mapped for writing, and their old contents are discarded. Download buffers are mapped for reading.
+        // The returned pointer can be used from any thread, but the buffer must be unmapped on the GL thread before it's used by GL. Throws on failure.
+        [[nodiscard]] uint8_t *Map()
+        {
+            if (!*this)
+                return 0;
+            if (data.mapped)
+                Program::Error("The pixel buffer is already mapped.");
+            Bind();
+            GLbitfield access = data.direction == upload ? GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT : GL_MAP_READ_BIT;
+            void *ret = glMapBufferRange(data.direction, 0, data.size, access);
+            Unbind();
+            if (!ret)
+                Program::Error("Unable to map a pixel buffer.");
+            data.mapped = true;
+            return (uint8_t *)ret;
+        }
+
+        // Returns false if the contents were lost while the buffer was mapped (which is rare, but possible e.g. on a display mode change).
+        bool Unmap()
+        {
+            if (!*this || !data.mapped)
+                return true;
+            Bind();
+            bool ok = glUnmapBuffer(data.direction);
+            Unbind();
+            data.mapped = false;
+            return ok;
+        }
+    };
+
+    // Keeps the pixel buffers that are not in use, so that they can be reused instead of being recreated for every transfer.
+    class PixelBufferPool
+    {
+        PixelBuffer::Direction direction = PixelBuffer::upload;
+        std::vector<PixelBuffer> free_buffers;
+
+      public:
+        PixelBufferPool(PixelBuffer::Direction direction) : direction(direction) {}
+
+        // Returns the smallest free buffer that's at least `bytes` large, or creates a new one if there's none.
+        [[nodiscard]] PixelBuffer Acquire(int bytes)
+        {
+            int best = -1;
+            for (int i = 0; i < int(free_buffers.size()); i++)
+            {
+                if (free_buffers[i].Size() >= bytes && (best == -1 || free_buffers[i].Size() < free_buffers[best].Size()))
+                    best = i;
+            }
+            if (best == -1)
+                return PixelBuffer(direction, bytes);
+
+            PixelBuffer ret = std::move(free_buffers[best]);
+            free_buffers.erase(free_buffers.begin() + best);
+            return ret;
+        }
+
+        // Returns a buffer to the pool. It must be unmapped. Null buffers are ignored.
+        void Release(PixelBuffer buffer)
+        {
+            if (buffer)
+                free_buffers.push_back(std::move(buffer));
+        }
+
+        [[nodiscard]] int FreeCount() const
+        {
+            return free_buffers.size();
+        }
+
+        // Destroys the free buffers.
+        void Clear()
+        {
+            free_buffers.clear();
+        }
+    };
+}
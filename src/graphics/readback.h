@@ -0,0 +1,202 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <string>
+#include <utility>
+
+#include <GLFL/glfl.h>
+
+#include "graphics/extensions.h"
+#include "graphics/fence.h"
+#include "graphics/framebuffer.h"
+#include "graphics/image.h"
+#include "graphics/pixel_buffer.h"
+#include "program/errors.h"
+#include "utils/finally.h"
+#include "utils/mat.h"
+#include "utils/meta.h"
+#include "utils/thread_pool.h"
+
+namespace Graphics
+{
+    /* Reads pixels from framebuffers without stalling the render thread.
+     *
+     * The pixels are copied into a pixel buffer by the GPU. When a fence says the copy is done (usually 1-2 frames later),
+     * the buffer is mapped, and a worker thread converts the pixels to an image and optionally saves it.
+     *
+     * Example usage:
+     *
+     *     Graphics::Readback readback;
+     *     readback.RequestSave(&framebuffer, framebuffer_size, ivec2(0), size, "chart.png"); // Null framebuffer means the default one.
+     *
+     *     // Every frame:
+     *     readback.Update();
+     *
+     * Callbacks are called on the render thread, from `Update()`.
+     */
+
+    class Readback : Meta::stationary<Readback>
+    {
+      public:
+        using ProcessFunc = std::function<void(Image &image)>; // Called on a worker thread, so it can't use GL.
+        using DoneFunc = std::function<void(Image &&image)>;
+
+      private:
+        struct PendingRead
+        {
+            ivec2 size = ivec2(0);
+            ProcessFunc process;
+            DoneFunc on_done;
+
+            PixelBuffer buffer = nullptr;
+            Fence fence = nullptr;
+            std::future<Image> job; // Valid while the buffer is mapped.
+        };
+
+        ThreadPool *pool = 0;
+        std::list<PendingRead> requests;
+        PixelBufferPool buffer_pool = PixelBufferPool(PixelBuffer::download);
+
+      public:
+        Readback(ThreadPool &pool = ThreadPool::Global()) : pool(&pool) {}
+
+        ~Readback()
+        {
+            // The workers read from mapped buffers, so we must wait for them before the buffers are destroyed.
+            for (PendingRead &request : requests)
+            {
+                if (request.job.valid())
+                    request.job.wait();
+            }
+        }
+
+        // Starts copying a rectangle of `framebuffer` (or the default framebuffer if it's null). The rectangle is measured from the top-left corner.
+        // `process` is called on a worker thread, then `on_done` is called from `Update()`. Both are optional.
+        void Request(const FrameBuffer *framebuffer, ivec2 framebuffer_size, ivec2 pos, ivec2 size, ProcessFunc process, DoneFunc on_done)
+        {
+            if ((size <= 0).any())
+                Program::Error("Invalid readback size.");
+
+            PendingRead &request = requests.emplace_back();
+            FINALLY_ON_THROW( requests.pop_back(); )
+            request.size = size;
+            request.process = std::move(process);
+            request.on_done = std::move(on_done);
+            request.buffer = buffer_pool.Acquire(size.prod() * 4);
+
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer ? framebuffer->Handle() : 0);
+            FINALLY( glBindFramebuffer(GL_READ_FRAMEBUFFER, 0); )
+
+            // GL measures the rectangle from the bottom-left corner. We flip the image later.
+            request.buffer.Bind();
+            glReadPixels(pos.x, framebuffer_size.y - pos.y - size.y, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, 0); // With a bound pixel buffer, the pointer is an offset into it.
+            request.buffer.Unbind();
+
+            if (Extensions::Sync())
+                request.fence = Fence();
+        }
+        // Same, but the resulting image is passed to `on_done`.
+        void Request(const FrameBuffer *framebuffer, ivec2 framebuffer_size, ivec2 pos, ivec2 size, DoneFunc on_done)
+        {
+            Request(framebuffer, framebuffer_size, pos, size, 0, std::move(on_done));
+        }
+        // Same, but the image is saved to a file on a worker thread. `on_done` receives an empty image.
+        void RequestSave(const FrameBuffer *framebuffer, ivec2 framebuffer_size, ivec2 pos, ivec2 size, std::string file_name, Image::Format format = Image::png, DoneFunc on_done = 0)
+        {
+            Request(framebuffer, framebuffer_size, pos, size, [file_name = std::move(file_name), format](Image &image)
+            {
+                image.Save(file_name, format);
+                image = {};
+            }, std::move(on_done));
+        }
+
+        // Call this on the render thread, preferably once per frame. Never blocks.
+        // If a worker throws (e.g. when an image can't be saved), the exception is rethrown here, and the corresponding request is cancelled.
+        void Update()
+        {
+            for (auto it = requests.begin(); it != requests.end();)
+            {
+                PendingRead &request = *it;
+
+                if (!request.job.valid())
+                {
+                    if (!request.fence.IsSignaled())
+                    {
+                        it++;
+                        continue;
+                    }
+
+                    const uint8_t *pixels = request.buffer.Map();
+                    request.job = pool->Submit([pixels, size = request.size, process = request.process]
+                    {
+                        Image image(size, pixels);
+                        image.FlipY();
+                        if (process)
+                            process(image);
+                        return image;
+                    });
+                }
+
+                if (request.job.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                {
+                    it++;
+                    continue;
+                }
+
+                request.buffer.Unmap(); // If the contents were lost, the worker has already read garbage, and there's nothing we can do.
+                buffer_pool.Release(std::move(request.buffer));
+
+                Image image;
+                DoneFunc on_done = std::move(request.on_done);
+                try
+                {
+                    image = request.job.get();
+                }
+                catch (...)
+                {
+                    requests.erase(it);
+                    throw;
+                }
+
+                it = requests.erase(it);
+                if (on_done)
+                    on_done(std::move(image));
+            }
+        }
+
+        // Blocks until all requests are finished.
+        void Finish()
+        {
+            while (requests.size() > 0)
+            {
+                for (PendingRead &request : requests)
+                {
+                    if (!request.job.valid())
+                        request.fence.Wait();
+                }
+                Update();
+                for (PendingRead &request : requests)
+                {
+                    if (request.job.valid())
+                        request.job.wait();
+                }
+                Update();
+            }
+        }
+
+        [[nodiscard]] int PendingCount() const
+        {
+            return requests.size();
+        }
+
+        // Destroys the pixel buffers that are not in use.
+        void ReleaseFreeBuffers()
+        {
+            buffer_pool.Clear();
+        }
+    };
+}
@@ -2,10 +2,11 @@
 
 #include <algorithm>
 #include <array>
-#include <memory>
+#include <cstdint>
 #include <type_traits>
 #include <vector>
 
+#include "graphics/streaming_buffer.h"
 #include "vertex_buffer.h"
 
 namespace Graphics
@@ -13,11 +14,24 @@ namespace Graphics
     template <typename T, int N> class RenderQueue
     {
         static_assert(Graphics::VertexBuffer<T>::is_reflected, "The type must be reflected.");
-        static_assert(N >= 1 && N <= 3, "N must be 1 (points), 2 (lines), or 3 (triangles).");
+        static_assert(N >= 1 && N <= 4, "N must be 1 (points), 2 (lines), 3 (triangles), or 4 (quads).");
 
         int pos = 0, size = 0; // These are measured in primitives, not vertices.
-        std::unique_ptr<T[]> storage;
-        Graphics::VertexBuffer<T> buffer = nullptr;
+        StreamingBuffer<T> stream = nullptr; // Holds `size * N` vertices per segment.
+        Graphics::IndexBuffer<uint32_t> indices = nullptr; // Only for quads. Each quad is drawn as two triangles sharing an edge.
+
+        void DrawPrimitives(int first, int count)
+        {
+            if constexpr (N == 4)
+            {
+                indices.Draw(stream.Buffer(), triangles, first * 6, count * 6);
+            }
+            else
+            {
+                constexpr DrawMode draw_mode = std::array{points, lines, triangles}[N-1];
+                stream.Buffer().Draw(draw_mode, first * N, count * N);
+            }
+        }
 
         template <typename ...P> void AddLow(const P &... p)
         {
@@ -25,18 +39,39 @@ namespace Graphics
             static_assert((std::is_same_v<P, T> && ...));
             if (pos >= size)
                 Flush();
-            int offset = 0;
-            (std::copy_n(&p, 1, storage.get() + N * pos + offset++) , ...);
+            T *dst = stream.WritePointer() + N * pos;
+            ((*dst++ = p) , ...);
             pos++;
         }
 
       public:
         RenderQueue(decltype(nullptr)) {}
-        RenderQueue(int size) : size(size), storage(std::make_unique<T[]>(size * N)), buffer(size * N, 0, Graphics::stream_draw) {}
+        RenderQueue(int size, StreamingMode mode = StreamingMode::sub_data) : size(size), stream(size * N, mode)
+        {
+            if constexpr (N == 4)
+            {
+                // The indices never change. In the persistent mode, each segment gets its own range, so we don't need `glDrawElementsBaseVertex()`.
+                int quad_count = size * stream.SegmentCount();
+                std::vector<uint32_t> index_data(quad_count * 6);
+                for (int i = 0; i < quad_count; i++)
+                {
+                    uint32_t *dst = index_data.data() + i * 6;
+                    uint32_t base = i * 4;
+                    // Same triangles as `RenderQueue<T,3>::Add(a,b,c,d)`: (a,b,d) and (d,b,c).
+                    dst[0] = base + 0;
+                    dst[1] = base + 1;
+                    dst[2] = base + 3;
+                    dst[3] = base + 3;
+                    dst[4] = base + 1;
+                    dst[5] = base + 2;
+                }
+                indices = Graphics::IndexBuffer<uint32_t>(quad_count * 6, index_data.data(), Graphics::static_draw);
+            }
+        }
 
         explicit operator bool()
         {
-            return bool(storage);
+            return bool(stream);
         }
 
         int Size() const
@@ -44,12 +79,34 @@ namespace Graphics
             return size;
         }
 
+        StreamingMode Mode() const
+        {
+            return stream.Mode();
+        }
+
+        // How many times `Flush()` had to block because the GPU was still reading the next segment. Only changes in the persistent mode.
+        int FenceWaitCount() const
+        {
+            return stream.FenceWaitCount();
+        }
+
+        // How many draw calls were issued so far.
+        int DrawCallCount() const
+        {
+            return stream.DrawCallCount();
+        }
+
+        [[nodiscard]] bool IsEmpty() const
+        {
+            return pos == 0;
+        }
+
         void Flush()
         {
             if (pos <= 0)
                 return;
-            buffer.SetDataPart(0, pos * N, storage.get());
-            buffer.Draw(std::array{points, lines, triangles}[N-1], pos * N);
+
+            stream.Flush(pos * N, [&](int first_vertex){DrawPrimitives(first_vertex / N, pos);});
             pos = 0;
         }
 
@@ -70,9 +127,16 @@ namespace Graphics
         }
         void Add(const T &a, const T &b, const T &c, const T &d)
         {
-            static_assert(N == 3/*sic*/, "Incorrect parameter count.");
-            AddLow(a, b, d);
-            AddLow(d, b, c);
+            static_assert(N == 3 || N == 4, "Incorrect parameter count.");
+            if constexpr (N == 4)
+            {
+                AddLow(a, b, c, d);
+            }
+            else
+            {
+                AddLow(a, b, d);
+                AddLow(d, b, c);
+            }
         }
     };
 }
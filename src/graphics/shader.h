@@ -1,16 +1,25 @@
 #pragma once
 
+#include <cstdint>
+#include <cstring>
+#include <exception>
 #include <string>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include <GLFL/glfl.h>
 
+#include "graphics/extensions.h"
 #include "texture.h"
 
 #include "reflection/complete.h"
 #include "program/errors.h"
+#include "utils/filesystem.h"
 #include "utils/finally.h"
+#include "utils/hash.h"
+#include "utils/memory_access.h"
+#include "utils/memory_file.h"
 #include "utils/meta.h"
 #include "utils/strings.h"
 
@@ -29,6 +38,7 @@ namespace Graphics
             else if constexpr (std::is_same_v<base, double      >) ret = "d";
             else if constexpr (std::is_same_v<base, int         >) ret = "i";
             else if constexpr (std::is_same_v<base, unsigned int>) ret = "u";
+            else if constexpr (std::is_same_v<base, uint8_t     >) static_assert(is_vec, "No name for this type."); // Normalized attributes are seen as floats.
             else static_assert(std::is_same_v<base, float>, "No name for this type.");
 
             if constexpr (is_vec)
@@ -139,6 +149,11 @@ namespace Graphics
 
     static constexpr struct None_t {} None; // Means no attributes or no uniforms.
 
+    // Attributes can be specified as `Meta::type_list<A, B, ...>` to combine several structures, e.g. per-vertex and per-instance ones.
+    // Attribute locations are assigned in order.
+    template <typename T> struct is_attribute_list : std::false_type {};
+    template <typename ...P> struct is_attribute_list<Meta::type_list<P...>> : std::true_type {};
+
     template <typename T> class Uniform;
 
     class Shader
@@ -153,7 +168,117 @@ namespace Graphics
 
         inline static GLuint binding = 0;
 
+        inline static std::string binary_cache_dir;
+
+        // The layout of the binary cache files. The program binary follows the header.
+        struct BinaryHeader
+        {
+            char magic[8] = {'G','L','P','R','O','G','0','1'};
+            uint64_t key = 0;
+            uint32_t format = 0;
+            uint32_t size = 0;
+        };
+
+        [[nodiscard]] static uint64_t BinaryCacheKey(const std::string &vert_source, const std::string &frag_source, const std::vector<std::string> &attributes)
+        {
+            auto gl_string = [](GLenum name) -> std::string
+            {
+                const char *str = (const char *)glGetString(name);
+                return str ? str : "";
+            };
+
+            // The key is saved in files, so we use a stable hash. Each string is prefixed with its length, to avoid ambiguities.
+            Hash::Stream stream;
+            auto append = [&](std::string_view str)
+            {
+                uint8_t size[8];
+                Memory::WriteLittle<uint64_t>(size, str.size());
+                stream.Append(size, sizeof size);
+                stream.Append(str);
+            };
+
+            append(vert_source);
+            append(frag_source);
+            append(gl_string(GL_VENDOR));
+            append(gl_string(GL_RENDERER));
+            append(gl_string(GL_VERSION));
+            for (const std::string &attrib : attributes)
+                append(attrib);
+            return stream.Get64();
+        }
+
+        // Returns false if the file doesn't exist or the binary is rejected by the driver. Never throws.
+        [[nodiscard]] bool LoadBinary(const std::string &file_name, uint64_t key)
+        {
+            bool ok = true;
+            Filesystem::GetObjectInfo(file_name, &ok);
+            if (!ok)
+                return false;
+
+            MemoryFile file;
+            try
+            {
+                file = MemoryFile(file_name);
+            }
+            catch (std::exception &)
+            {
+                return false;
+            }
+
+            BinaryHeader header, expected_header;
+            if (file.size() < sizeof header)
+                return false;
+            std::memcpy(&header, file.data(), sizeof header);
+            if (std::memcmp(header.magic, expected_header.magic, sizeof header.magic) != 0 || header.key != key || file.size() < sizeof header + header.size)
+                return false;
+
+            glProgramBinary(data.handle, header.format, file.data() + sizeof header, header.size);
+
+            GLint status = 0;
+            glGetProgramiv(data.handle, GL_LINK_STATUS, &status);
+            return status; // Drivers reject binaries after updates, even if the version string didn't change.
+        }
+
+        // Failures are silently ignored, since the cache is optional.
+        void SaveBinary(const std::string &file_name, uint64_t key) const
+        {
+            GLint length = 0;
+            glGetProgramiv(data.handle, GL_PROGRAM_BINARY_LENGTH, &length);
+            if (length <= 0)
+                return;
+
+            std::vector<uint8_t> buffer(sizeof(BinaryHeader) + length);
+            BinaryHeader header;
+            header.key = key;
+            GLsizei written = 0;
+            GLenum format = 0;
+            glGetProgramBinary(data.handle, length, &written, &format, buffer.data() + sizeof header);
+            if (written <= 0)
+                return;
+            header.format = format;
+            header.size = written;
+            std::memcpy(buffer.data(), &header, sizeof header);
+
+            try
+            {
+                MemoryFile::Save(file_name, buffer.data(), buffer.data() + sizeof header + written);
+            }
+            catch (std::exception &) {}
+        }
+
       public:
+        // If set, linked programs are cached in this directory, which must exist. This makes subsequent launches faster.
+        // The cache is keyed by the sources and the driver version, and is ignored if `Extensions::ProgramBinary()` is false.
+        // Pass an empty string to disable the cache. It's disabled by default.
+        static void SetBinaryCacheDirectory(std::string dir)
+        {
+            binary_cache_dir = std::move(dir);
+        }
+        [[nodiscard]] static const std::string &BinaryCacheDirectory()
+        {
+            return binary_cache_dir;
+        }
+
         static void BindHandle(GLuint handle)
         {
             if (binding == handle)
@@ -168,6 +293,15 @@ namespace Graphics
             {
                 return source;
             }
+            else if constexpr (is_attribute_list<T>::value)
+            {
+                return [&]<typename ...P>(Meta::type_list<P...>)
+                {
+                    std::string ret = source;
+                    ((ret = AppendAttributesToSource<P>(ret, cfg, pref)), ...);
+                    return ret;
+                }(T{});
+            }
             else
             {
                 std::string header;
@@ -234,6 +368,20 @@ namespace Graphics
             {
                 return {};
             }
+            else if constexpr (is_attribute_list<T>::value)
+            {
+                return [&]<typename ...P>(Meta::type_list<P...>)
+                {
+                    std::vector<std::string> ret;
+                    (
+                        [&]{
+                            std::vector<std::string> list = MakeAttributeList<P>(pref);
+                            ret.insert(ret.end(), list.begin(), list.end());
+                        }()
+                    , ...);
+                    return ret;
+                }(T{});
+            }
             else
             {
                 std::vector<std::string> ret;
@@ -241,7 +389,7 @@ namespace Graphics
                 using refl = Refl::Interface<T>;
                 refl::for_each_field([&](auto index)
                 {
-                    ret.push_back(pref.attribute_prefix + refl::field_name(index.value));
+                    ret.push_back(pref.attribute_prefix + std::string(refl::field_name(index.value)));
                 });
 
                 return ret;
@@ -258,14 +406,25 @@ namespace Graphics
                 Program::Error("Unable to create shader program: `", name, "`.");
             FINALLY_ON_THROW( glDeleteProgram(data.handle); )
 
+            vert_source = cfg.common_header + "\n" + cfg.vertex_header + "\n" + vert_source;
+            frag_source = cfg.common_header + "\n" + cfg.fragment_header + "\n" + frag_source;
+
+            std::string cache_file_name;
+            uint64_t cache_key = 0;
+            if (binary_cache_dir.size() > 0 && Extensions::ProgramBinary())
+            {
+                cache_key = BinaryCacheKey(vert_source, frag_source, attributes);
+                cache_file_name = Str(binary_cache_dir, "/", std::hex, cache_key, ".glprog");
+                if (LoadBinary(cache_file_name, cache_key))
+                    return;
+                glProgramParameteri(data.handle, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+            }
+
             for (std::string *source_ptr : {&vert_source, &frag_source})
             {
                 bool is_vertex = source_ptr == &vert_source;
                 std::string &source = *source_ptr;
 
-                std::string header = cfg.common_header + "\n" + (is_vertex ? cfg.vertex_header : cfg.fragment_header) + "\n";
-                source = header + source;
-
                 // Uncomment to dump source:
                 // std::cout << "\n==================\n" << source << "\n==================\n";
 
@@ -331,6 +490,9 @@ namespace Graphics
 
                 Program::Error("Unable to link shader program: `", name, "`.\nLog:\n", Strings::Trim(log));
             }
+
+            if (cache_file_name.size() > 0)
+                SaveBinary(cache_file_name, cache_key);
         }
 
         template <typename AttributesT, typename UniformsT>
@@ -349,7 +511,7 @@ namespace Graphics
                 {
                     constexpr int i = index.value;
                     // Note that we don't need to check the return value. Even if a uniform is not found and -1 location is returned, glUniform* will silently no-op on it.
-                    AssignUniformLocation(refl.template field_value<i>(), glGetUniformLocation(data.handle, (pref.uniform_prefix + refl.field_name(i)).c_str()));
+                    AssignUniformLocation(refl.template field_value<i>(), glGetUniformLocation(data.handle, (pref.uniform_prefix + std::string(refl.field_name(i))).c_str()));
                 });
             }
         }
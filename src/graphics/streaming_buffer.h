@@ -0,0 +1,140 @@
+#pragma once
+
+#include <array>
+#include <memory>
+
+#include "graphics/extensions.h"
+#include "graphics/fence.h"
+#include "vertex_buffer.h"
+
+namespace Graphics
+{
+    enum class StreamingMode
+    {
+        sub_data,   // Elements are collected in a temporary storage, then uploaded with `glBufferSubData()` into the buffer that was just drawn from.
+        orphaning,  // Same, but the buffer is orphaned before each upload, so the driver doesn't have to wait for the previous draw call to finish.
+        persistent, // Elements are written directly into a persistently mapped ring buffer. Each segment is reused after its fence is signaled. Requires `Extensions::BufferStorage()` and `Extensions::Sync()`.
+        automatic,  // `persistent` if supported, `orphaning` otherwise.
+    };
+
+    // A vertex buffer that is refilled with up to `capacity` elements of type `T` before each draw call, using one of the streaming modes.
+    // This is shared by `RenderQueue` and `InstanceQueue`, which decide what to draw from it.
+    template <typename T> class StreamingBuffer
+    {
+        static constexpr int segment_count = 3; // For the persistent mode. Three segments let the CPU fill one while the GPU might still be reading the other two.
+
+        int capacity = 0; // Measured in elements, per segment.
+        StreamingMode mode = StreamingMode::sub_data;
+        std::unique_ptr<T[]> storage; // Not used in the persistent mode.
+        Graphics::VertexBuffer<T> buffer = nullptr;
+
+        T *mapped = 0; // Only in the persistent mode.
+        int segment = 0;
+        std::array<Fence, segment_count> fences = {nullptr, nullptr, nullptr};
+        int fence_wait_count = 0;
+        int draw_call_count = 0;
+
+      public:
+        StreamingBuffer(decltype(nullptr)) {}
+        StreamingBuffer(int capacity, StreamingMode mode = StreamingMode::sub_data) : capacity(capacity), buffer()
+        {
+            if (mode == StreamingMode::automatic)
+                mode = Extensions::BufferStorage() && Extensions::Sync() ? StreamingMode::persistent : StreamingMode::orphaning;
+            this->mode = mode;
+
+            if (mode == StreamingMode::persistent)
+            {
+                constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+                buffer.SetImmutableData(capacity * segment_count, 0, flags);
+                mapped = buffer.Map(0, capacity * segment_count, flags);
+            }
+            else
+            {
+                storage = std::make_unique<T[]>(capacity);
+                buffer.SetData(capacity, 0, Graphics::stream_draw);
+            }
+        }
+
+        explicit operator bool() const
+        {
+            return bool(buffer);
+        }
+
+        int Capacity() const
+        {
+            return capacity;
+        }
+
+        StreamingMode Mode() const
+        {
+            return mode;
+        }
+
+        // The amount of segments the buffer is split into, each `Capacity()` elements large. More than one only in the persistent mode.
+        int SegmentCount() const
+        {
+            return mode == StreamingMode::persistent ? segment_count : 1;
+        }
+
+        // How many times `Flush()` had to block because the GPU was still reading the next segment. Only changes in the persistent mode.
+        int FenceWaitCount() const
+        {
+            return fence_wait_count;
+        }
+
+        // How many draw calls were issued so far.
+        int DrawCallCount() const
+        {
+            return draw_call_count;
+        }
+
+        // Returns the pointer to write the next batch of elements to, at most `Capacity()` of them.
+        [[nodiscard]] T *WritePointer()
+        {
+            if (mode == StreamingMode::persistent)
+                return mapped + segment * capacity;
+            else
+                return storage.get();
+        }
+
+        [[nodiscard]] Graphics::VertexBuffer<T> &Buffer()
+        {
+            return buffer;
+        }
+
+        // Makes the first `count` elements written to `WritePointer()` available to the GPU, and calls `draw(first)`,
+        // which should issue a draw call reading them from `Buffer()` starting from the element `first`. Then moves to the next segment if needed.
+        template <typename F> void Flush(int count, F &&draw)
+        {
+            if (count <= 0)
+                return;
+
+            switch (mode)
+            {
+              case StreamingMode::sub_data:
+              case StreamingMode::automatic: // This is never stored, the constructor replaces it.
+                buffer.SetDataPart(0, count, storage.get());
+                draw(0);
+                break;
+              case StreamingMode::orphaning:
+                buffer.SetData(capacity, 0, Graphics::stream_draw);
+                buffer.SetDataPart(0, count, storage.get());
+                draw(0);
+                break;
+              case StreamingMode::persistent:
+                draw(segment * capacity);
+                fences[segment] = Fence();
+                segment = (segment + 1) % segment_count;
+                if (!fences[segment].IsSignaled())
+                {
+                    fence_wait_count++;
+                    fences[segment].Wait();
+                }
+                fences[segment] = nullptr;
+                break;
+            }
+
+            draw_call_count++;
+        }
+    };
+}
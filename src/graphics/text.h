@@ -1,6 +1,7 @@
 #pragma once
 
 #include <limits>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -35,7 +36,7 @@ namespace Graphics
             int default_line_gap = 0;
         };
 
-        std::vector<Line> lines = {{}}; // We start with one line by default.
+        std::vector<Line> lines = {{}}; // We start with one line by default. If you modify this directly, call `InvalidateStats()`.
 
 
         struct Stats
@@ -51,6 +52,8 @@ namespace Graphics
 
             ivec2 size = ivec2(0);
         };
+        mutable std::optional<Stats> cached_stats; // See `GetStats()`.
+
         Stats ComputeStats() const
         {
             Stats ret;
@@ -92,6 +95,18 @@ namespace Graphics
             return ret;
         }
 
+        // Same as `ComputeStats()`, but the result is cached until the text is modified.
+        const Stats &GetStats() const
+        {
+            if (!cached_stats)
+                cached_stats = ComputeStats();
+            return *cached_stats;
+        }
+        void InvalidateStats()
+        {
+            cached_stats.reset();
+        }
+
 
         Text() {}
         Text(const Font &font, const char *begin, const char *end = 0)
@@ -106,6 +121,7 @@ namespace Graphics
 
         void AddSymbol(const Symbol &glyph)
         {
+            InvalidateStats();
             if (glyph.ch == '\n')
             {
                 Line &line = lines.emplace_back();
@@ -120,6 +136,7 @@ namespace Graphics
         }
         void AddSymbol(const Font &font, uint32_t ch)
         {
+            InvalidateStats();
             if (ch == '\n')
             {
                 Line &line = lines.emplace_back();
@@ -149,6 +166,7 @@ namespace Graphics
             auto &symbols = lines.back().symbols;
             if (symbols.size() < 2)
                 return;
+            InvalidateStats();
             symbols[symbols.size() - 2].kerning = font.Kerning(symbols[symbols.size() - 2].ch, symbols[symbols.size() - 1].ch);
         }
 
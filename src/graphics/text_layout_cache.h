@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#include "graphics/font.h"
+#include "graphics/text.h"
+#include "utils/hash.h"
+
+namespace Graphics
+{
+    /* Caches shaped `Text`s, with their `Stats` already computed, for strings that are drawn repeatedly.
+     *
+     * Example usage:
+     *
+     *     Graphics::TextLayoutCache cache;
+     *     render.itext(pos, cache.Get(font, "Hello")); // No allocations if the text is already cached.
+     *
+     * Entries are keyed by the font, its `Generation()` and the string, so changes to the font invalidate them automatically.
+     * If the generation changes while a text is being shaped (e.g. because a `GlyphCache` had no space for a glyph), the text isn't cached, and is shaped again on the next call.
+     * The least recently used entries are evicted when the entry count exceeds the capacity.
+     */
+
+    class TextLayoutCache
+    {
+      public:
+        struct Stats
+        {
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            uint64_t evictions = 0;
+        };
+
+      private:
+        struct Entry
+        {
+            std::size_t hash = 0;
+            const Font *font = 0;
+            uint64_t generation = 0;
+            std::string string;
+            Text text;
+        };
+
+        std::size_t capacity = 0;
+        std::list<Entry> entries; // Most recently used first.
+        std::unordered_multimap<std::size_t, std::list<Entry>::iterator> index;
+        Text uncached_text; // Texts that shouldn't be cached are returned from here.
+        Stats stats;
+
+        void RemoveFromIndex(std::list<Entry>::iterator it)
+        {
+            auto [begin, end] = index.equal_range(it->hash);
+            for (auto index_it = begin; index_it != end; index_it++)
+            {
+                if (index_it->second == it)
+                {
+                    index.erase(index_it);
+                    return;
+                }
+            }
+        }
+
+        void EvictExcess()
+        {
+            while (entries.size() > capacity)
+            {
+                RemoveFromIndex(std::prev(entries.end()));
+                entries.pop_back();
+                stats.evictions++;
+            }
+        }
+
+      public:
+        TextLayoutCache(std::size_t capacity = 1024) : capacity(capacity > 0 ? capacity : 1) {}
+
+        // The returned reference remains valid until the next call to a non-const function.
+        const Text &Get(const Font &font, std::string_view string)
+        {
+            uint64_t generation = font.Generation();
+            std::size_t hash = Hash::Compute(&font, generation, string);
+
+            auto [begin, end] = index.equal_range(hash);
+            for (auto it = begin; it != end; it++)
+            {
+                Entry &entry = *it->second;
+                if (entry.font == &font && entry.generation == generation && entry.string == string)
+                {
+                    stats.hits++;
+                    entries.splice(entries.begin(), entries, it->second);
+                    return entry.text;
+                }
+            }
+
+            stats.misses++;
+
+            // Shaping the text can render missing glyphs, which can evict others or fall back to the default glyph. Both change the generation.
+            // In the latter case the text is incomplete, and caching it would keep it that way, so we don't cache texts if the generation changes.
+            Text text(font, string);
+            text.GetStats(); // Compute the stats in advance.
+            if (font.Generation() != generation)
+            {
+                uncached_text = std::move(text);
+                return uncached_text;
+            }
+
+            Entry &entry = entries.emplace_front();
+            entry.hash = hash;
+            entry.font = &font;
+            entry.generation = generation;
+            entry.string = string;
+            entry.text = std::move(text);
+            index.emplace(hash, entries.begin());
+
+            EvictExcess();
+            return entry.text; // The new entry is never evicted, because the capacity is at least 1.
+        }
+
+        void SetCapacity(std::size_t new_capacity) // The capacity is clamped to at least 1.
+        {
+            capacity = new_capacity > 0 ? new_capacity : 1;
+            EvictExcess();
+        }
+        [[nodiscard]] std::size_t Capacity() const
+        {
+            return capacity;
+        }
+        [[nodiscard]] std::size_t Size() const
+        {
+            return entries.size();
+        }
+
+        void Clear()
+        {
+            entries.clear();
+            index.clear();
+        }
+
+        [[nodiscard]] const Stats &GetStats() const
+        {
+            return stats;
+        }
+        void ResetStats()
+        {
+            stats = {};
+        }
+    };
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <utility>
+
+#include "graphics/extensions.h"
+#include "graphics/fence.h"
+#include "graphics/image.h"
+#include "graphics/pixel_buffer.h"
+#include "graphics/texture.h"
+#include "program/errors.h"
+#include "utils/finally.h"
+#include "utils/mat.h"
+#include "utils/meta.h"
+#include "utils/thread_pool.h"
+
+namespace Graphics
+{
+    /* Uploads texture data without stalling the render thread.
+     *
+     * Pixels are written into a mapped pixel buffer by a worker thread. Then `Update()`, called on the render thread,
+     * starts the transfer from the buffer to the texture, and calls the completion callback when a fence says the transfer is done.
+     *
+     * Example usage:
+     *
+     *     Graphics::TextureUploader uploader;
+     *     texture.SetData(ivec2(4096)); // The storage must be allocated in advance.
+     *     uploader.Upload(texture, ivec2(0), ivec2(4096), [](uint8_t *pixels){...}, []{std::cout << "Done!\n";});
+     *
+     *     // Every frame:
+     *     uploader.Update();
+     *
+     * Textures must outlive the uploads that target them. Callbacks are called on the render thread, from `Update()`.
+     */
+
+    class TextureUploader : Meta::stationary<TextureUploader>
+    {
+      public:
+        using FillFunc = std::function<void(uint8_t *pixels)>; // Must write `size.prod() * 4` bytes of RGBA pixels. Called on a worker thread, so it can't use GL.
+        using DoneFunc = std::function<void()>;
+
+      private:
+        struct Request
+        {
+            Texture *texture = 0;
+            ivec2 pos = ivec2(0), size = ivec2(0);
+            FillFunc fill;
+            DoneFunc on_done;
+
+            PixelBuffer buffer = nullptr;
+            std::future<void> job; // Invalid after the job is finished and the transfer is started.
+            Fence fence = nullptr;
+        };
+
+        ThreadPool *pool = 0;
+        std::list<Request> requests;
+        PixelBufferPool buffer_pool = PixelBufferPool(PixelBuffer::upload);
+
+        void StartJob(Request &request)
+        {
+            uint8_t *pixels = request.buffer.Map();
+            request.job = pool->Submit([fill = request.fill, pixels]{fill(pixels);});
+        }
+
+      public:
+        TextureUploader(ThreadPool &pool = ThreadPool::Global()) : pool(&pool) {}
+
+        ~TextureUploader()
+        {
+            // The workers write into mapped buffers, so we must wait for them before the buffers are destroyed.
+            for (Request &request : requests)
+            {
+                if (request.job.valid())
+                    request.job.wait();
+            }
+        }
+
+        // Copies pixels to a part of `texture`, which must already have a large enough storage.
+        void Upload(Texture &texture, ivec2 pos, ivec2 size, FillFunc fill, DoneFunc on_done = 0)
+        {
+            if ((size <= 0).any())
+                Program::Error("Invalid texture upload size.");
+
+            Request &request = requests.emplace_back();
+            FINALLY_ON_THROW( requests.pop_back(); )
+            request.texture = &texture;
+            request.pos = pos;
+            request.size = size;
+            request.fill = std::move(fill);
+            request.on_done = std::move(on_done);
+            request.buffer = buffer_pool.Acquire(size.prod() * 4);
+            StartJob(request);
+        }
+
+        void Upload(Texture &texture, ivec2 pos, Image image, DoneFunc on_done = 0)
+        {
+            ivec2 size = image.Size();
+            // `std::function` needs a copyable functor, so we don't store the image directly to avoid copying it.
+            Upload(texture, pos, size, [image = std::make_shared<Image>(std::move(image))](uint8_t *pixels)
+            {
+                std::memcpy(pixels, image->Data(), image->Size().prod() * 4);
+            }, std::move(on_done));
+        }
+
+        // Call this on the render thread, preferably once per frame. Never blocks.
+        // If a fill function throws, the exception is rethrown here, and the corresponding upload is cancelled.
+        void Update()
+        {
+            for (auto it = requests.begin(); it != requests.end();)
+            {
+                Request &request = *it;
+
+                if (request.job.valid())
+                {
+                    if (request.job.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                    {
+                        it++;
+                        continue;
+                    }
+
+                    bool contents_ok = request.buffer.Unmap();
+                    try
+                    {
+                        request.job.get();
+                    }
+                    catch (...)
+                    {
+                        buffer_pool.Release(std::move(request.buffer));
+                        requests.erase(it);
+                        throw;
+                    }
+
+                    if (!contents_ok)
+                    {
+                        StartJob(request); // The contents were lost, try again.
+                        it++;
+                        continue;
+                    }
+
+                    request.buffer.Bind();
+                    request.texture->SetDataPart(request.pos, request.size, 0); // With a bound pixel buffer, the pointer is an offset into it.
+                    request.buffer.Unbind();
+
+                    if (Extensions::Sync())
+                        request.fence = Fence();
+                }
+
+                if (!request.fence.IsSignaled())
+                {
+                    it++;
+                    continue;
+                }
+
+                DoneFunc on_done = std::move(request.on_done);
+                buffer_pool.Release(std::move(request.buffer));
+                it = requests.erase(it);
+                if (on_done)
+                    on_done();
+            }
+        }
+
+        // Blocks until all uploads are finished.
+        void Finish()
+        {
+            while (requests.size() > 0)
+            {
+                for (Request &request : requests)
+                {
+                    if (request.job.valid())
+                        request.job.wait();
+                }
+                Update();
+                for (Request &request : requests)
+                {
+                    if (!request.job.valid())
+                        request.fence.Wait();
+                }
+                Update();
+            }
+        }
+
+        [[nodiscard]] int PendingCount() const
+        {
+            return requests.size();
+        }
+
+        // Destroys the pixel buffers that are not in use.
+        void ReleaseFreeBuffers()
+        {
+            buffer_pool.Clear();
+        }
+    };
+}
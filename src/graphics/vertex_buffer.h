@@ -1,14 +1,18 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <type_traits>
 #include <utility>
 
 #include <GLFL/glfl.h>
 
+#include "graphics/extensions.h"
 #include "program/errors.h"
 #include "reflection/complete.h"
 #include "utils/finally.h"
 #include "utils/mat.h"
+#include "utils/meta.h"
 
 namespace Graphics
 {
@@ -30,16 +34,63 @@ namespace Graphics
         stream_draw  = GL_STREAM_DRAW,
     };
 
+    // A compile-time table of vertex attributes, generated from the reflection metadata of `T`.
+    template <typename T> struct AttribLayout
+    {
+        static_assert(Refl::is_reflected<T>, "The type must be reflected.");
+
+        struct Attrib
+        {
+            int size = 0; // The amount of components.
+            GLenum type = 0;
+            bool normalized = false;
+            int offset = 0; // In bytes.
+        };
+
+        using refl = Refl::Interface<T>;
+        static constexpr int count = refl::field_count();
+
+        static constexpr std::array<Attrib, count> attribs = []{
+            std::array<Attrib, count> ret{};
+            int offset = 0;
+            Meta::cexpr_for<count>([&](auto index)
+            {
+                constexpr int i = index.value;
+                using field_type = typename refl::template field_type<i>;
+                using base_type = Math::vec_base_t<field_type>;
+                static_assert(std::is_same_v<base_type, float> || std::is_same_v<base_type, uint8_t>, "Only float and normalized uint8_t attributes are supported.");
+                constexpr bool normalized = std::is_same_v<base_type, uint8_t>;
+                ret[i].size = Math::vec_size_v<field_type>;
+                ret[i].type = normalized ? GL_UNSIGNED_BYTE : GL_FLOAT;
+                ret[i].normalized = normalized;
+                ret[i].offset = offset;
+                offset += sizeof(field_type);
+            });
+            return ret;
+        }();
+
+        static_assert(count == 0 || attribs[count-1].offset + int(sizeof(typename refl::template field_type<count-1>)) == int(sizeof(T)), "Unexpected padding in attribute structure.");
+    };
+
     class Buffers
     {
         Buffers() = delete;
         ~Buffers() = delete;
 
-        // Only one buffer can be bound at a time. Optionally it can be draw-bound at the same time.
+        // Only one buffer can be bound at a time.
         inline static GLuint binding = 0;
-        inline static GLuint binding_draw = 0;
+        // The element array binding is a part of the vertex array state, so it's reset when the vertex array changes.
+        inline static GLuint binding_elements = 0;
+        inline static GLuint binding_vertex_array = 0;
 
+        // Each `VertexBuffer` has its own vertex array, with the attribute layout set up once.
+        // Instanced draws combine attributes from two buffers at a varying offset, so they use this shared vertex array, and set up the attributes as needed.
+        inline static GLuint shared_vertex_array = 0;
+        inline static GLuint binding_draw = 0;
+        inline static GLuint binding_draw_instance = 0;
+        inline static int binding_draw_instance_offset = 0;
         inline static int active_attrib_count = 0;
+        inline static uint32_t instanced_attrib_mask = 0; // Attributes with a non-zero divisor.
 
         static void SetActiveAttribCount(int count)
         {
@@ -51,6 +102,26 @@ namespace Graphics
                 do glDisableVertexAttribArray(--active_attrib_count); while (active_attrib_count > count);
         }
 
+        // Sets attribute pointers for the currently bound buffer, starting from attribute `first_attrib` and element `elem_offset`.
+        // Only touches the divisors if `track_divisors` is true, which is only the case for the shared vertex array.
+        template <typename T> static void SetAttribPointers(int first_attrib, int elem_offset, bool per_instance, bool track_divisors)
+        {
+            using layout = AttribLayout<T>;
+            for (int i = 0; i < layout::count; i++)
+            {
+                const auto &attrib = layout::attribs[i];
+                int index = first_attrib + i;
+                glVertexAttribPointer(index, attrib.size, attrib.type, attrib.normalized, sizeof(T), (void *)(uintptr_t)(elem_offset * sizeof(T) + attrib.offset));
+
+                // Divisors can only be non-zero if instancing is supported, so we don't need to check for it when resetting them.
+                if (track_divisors && bool(instanced_attrib_mask >> index & 1) != per_instance)
+                {
+                    Extensions::VertexAttribDivisor(index, per_instance);
+                    instanced_attrib_mask ^= uint32_t(1) << index;
+                }
+            }
+        }
+
       public:
         // Simply binds the VBO if it's not already bound.
         static void BindStorage(GLuint handle)
@@ -59,69 +130,102 @@ namespace Graphics
                 return;
             glBindBuffer(GL_ARRAY_BUFFER, handle);
             binding = handle;
-            binding_draw = 0;
         }
 
-        // First, binds storage for the same handle if necessary. Then sets attribute pointers if T is reflected, otherwise disables all attributes.
-        // BindDraw(0) is a special case. It disables all attributes, and thus strips draw binding from currently bound buffer (if any).
-        template <typename T> static void BindDraw(GLuint handle)
+        // Binds an index buffer to the current vertex array, if it's not already bound.
+        static void BindElements(GLuint handle)
         {
-            if (handle == 0) // Null handle is a special case.
-            {
-                // Note that we disable attributes unconditionally. We can't insert `if (bind_draw != 0)` here.
-                SetActiveAttribCount(0);
-                binding_draw = 0;
+            if (binding_elements == handle)
                 return;
-            }
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, handle);
+            binding_elements = handle;
+        }
 
-            if (binding_draw == handle)
+        static void BindVertexArray(GLuint handle)
+        {
+            if (binding_vertex_array == handle)
                 return;
-            BindStorage(handle);
+            glBindVertexArray(handle);
+            binding_vertex_array = handle;
+            binding_elements = 0; // We don't know what's bound in the new vertex array.
+        }
 
-            constexpr bool is_reflected = Refl::is_reflected<T>;
-            int field_count;
-            if constexpr (is_reflected)
-                field_count = Refl::Interface<T>::field_count();
-            else
-                field_count = 0;
+        // Creates a vertex array with the attribute layout of `T`, sourced from the buffer `handle`. Binds the buffer and the vertex array.
+        template <typename T> [[nodiscard]] static GLuint CreateVertexArray(GLuint handle)
+        {
+            GLuint vertex_array = 0;
+            glGenVertexArrays(1, &vertex_array);
+            if (!vertex_array)
+                Program::Error("Unable to create a vertex array.");
+
+            BindVertexArray(vertex_array);
+            BindStorage(handle); // The attribute pointers remember the buffer that was bound when they were set.
+            for (int i = 0; i < AttribLayout<T>::count; i++)
+                glEnableVertexAttribArray(i);
+            SetAttribPointers<T>(0, 0, false, false);
+            return vertex_array;
+        }
 
-            SetActiveAttribCount(field_count);
+        static void DeleteVertexArray(GLuint handle)
+        {
+            if (!handle)
+                return;
+            if (binding_vertex_array == handle)
+            {
+                binding_vertex_array = 0; // GL reverts to the default vertex array automatically.
+                binding_elements = 0;
+            }
+            glDeleteVertexArrays(1, &handle);
+        }
 
-            if constexpr (is_reflected)
+        // Binds the shared vertex array, with per-vertex attributes from the first buffer, followed by per-instance attributes from the second one, starting from element `instance_offset`.
+        // Both types must be reflected. Requires `Extensions::InstancedArrays()`. Leaves the second buffer bound as storage.
+        template <typename V, typename I> static void BindDrawInstanced(GLuint vertex_handle, GLuint instance_handle, int instance_offset)
+        {
+            if (!shared_vertex_array)
             {
-                using refl = Refl::Interface<T>;
+                glGenVertexArrays(1, &shared_vertex_array);
+                if (!shared_vertex_array)
+                    Program::Error("Unable to create a vertex array.");
+            }
+            BindVertexArray(shared_vertex_array);
 
-                int offset = 0, attrib = 0;
+            if (binding_draw == vertex_handle && binding_draw_instance == instance_handle && binding_draw_instance_offset == instance_offset)
+                return;
 
-                refl::for_each_field([&](auto index)
-                {
-                    constexpr int i = index.value;
-                    using field_type = typename refl::template field_type<i>;
-                    static_assert(std::is_same_v<Math::vec_base_t<field_type>, float>, "Non-float attributes are not supported.");
-                    glVertexAttribPointer(attrib++, Math::vec_size_v<field_type>, GL_FLOAT, 0, sizeof(T), (void *)(uintptr_t)offset);
-                    offset += sizeof(field_type);
-                });
-
-                if (offset != int(sizeof(T)))
-                    Program::Error("Unexpected padding in attribute structure.");
-            }
+            SetActiveAttribCount(AttribLayout<V>::count + AttribLayout<I>::count);
 
-            binding_draw = handle;
+            BindStorage(vertex_handle);
+            SetAttribPointers<V>(0, 0, false, true);
+            BindStorage(instance_handle);
+            SetAttribPointers<I>(AttribLayout<V>::count, instance_offset, true, true);
+
+            binding_draw = vertex_handle;
+            binding_draw_instance = instance_handle;
+            binding_draw_instance_offset = instance_offset;
         }
 
-        static void ForgetBoundBuffer() // Assume no buffer is bound, but don't actually unbind anything. Useful if currently bound buffer is going to be deleted immediately.
+        static void ForgetBoundBuffer(GLuint handle) // Call this before deleting a buffer. GL unbinds deleted buffers automatically.
         {
-            binding = 0;
-            binding_draw = 0;
+            if (binding == handle)
+                binding = 0;
+            if (binding_elements == handle)
+                binding_elements = 0;
+            if (binding_draw == handle || binding_draw_instance == handle)
+                binding_draw = binding_draw_instance = 0; // Buffer names can be reused, so the shared vertex array must be set up again.
         }
 
         static GLuint StorageBinding()
         {
             return binding;
         }
-        static GLuint DrawBinding()
+        static GLuint ElementsBinding()
         {
-            return binding_draw;
+            return binding_elements;
+        }
+        static GLuint VertexArrayBinding()
+        {
+            return binding_vertex_array;
         }
     };
 
@@ -132,6 +236,7 @@ namespace Graphics
         struct Data
         {
             GLuint handle = 0;
+            GLuint vertex_array = 0; // Only if `T` is reflected.
             int size = 0;
         };
         Data data;
@@ -141,13 +246,15 @@ namespace Graphics
 
         VertexBuffer(decltype(nullptr)) {}
 
-        VertexBuffer()
+        VertexBuffer() // If `T` is reflected, binds storage and the vertex array.
         {
             glGenBuffers(1, &data.handle);
             if (!data.handle)
                 Program::Error("Unable to create a vertex buffer.");
-            // Not needed because there is no code below this point:
-            // FINALLY_ON_THROW( glDeleteBuffers(1, &handle); )
+            FINALLY_ON_THROW( glDeleteBuffers(1, &data.handle); )
+
+            if constexpr (is_reflected)
+                data.vertex_array = Buffers::CreateVertexArray<T>(data.handle);
         }
         VertexBuffer(int count, const T *source = 0, Usage usage = static_draw) : VertexBuffer() // Binds storage.
         {
@@ -163,10 +270,12 @@ namespace Graphics
 
         ~VertexBuffer()
         {
-            if (StorageBound())
-                Buffers::ForgetBoundBuffer(); // GL unbinds the buffer automatically.
+            Buffers::DeleteVertexArray(data.vertex_array);
             if (data.handle)
+            {
+                Buffers::ForgetBoundBuffer(data.handle);
                 glDeleteBuffers(1, &data.handle); // Deleting 0 is a no-op, but GL could be unloaded at this point.
+            }
         }
 
         explicit operator bool() const
@@ -185,7 +294,7 @@ namespace Graphics
                 return;
             Buffers::BindStorage(data.handle);
         }
-        static void UnbindStorage() // Removes draw binding as well. Doesn't disable any attributes for performance reasons.
+        static void UnbindStorage() // Doesn't affect the vertex arrays.
         {
             Buffers::BindStorage(0);
         }
@@ -194,19 +303,20 @@ namespace Graphics
             return data.handle && data.handle == Buffers::StorageBinding();
         }
 
-        void BindDraw() const // If element type is not reflected, disables all attributes.
+        void BindDraw() const // Binds the vertex array of this buffer, which already has the attribute layout set up.
         {
+            static_assert(is_reflected, "Element type of this buffer is not reflected, unable to bind for drawing.");
             if (!*this)
                 return;
-            Buffers::BindDraw<T>(data.handle);
+            Buffers::BindVertexArray(data.vertex_array);
         }
-        static void UnbindDraw() // Disables all attributes. If any buffer is currently bound, this results in stripping draw binding from it.
+        static void UnbindDraw() // Binds the default vertex array.
         {
-            Buffers::BindDraw<void>(0);
+            Buffers::BindVertexArray(0);
         }
         [[nodiscard]] bool DrawBound() const
         {
-            return data.handle && data.handle == Buffers::DrawBinding();
+            return data.vertex_array && data.vertex_array == Buffers::VertexArrayBinding();
         }
 
         int Size() const // This size is measured in elements, not bytes.
@@ -219,7 +329,7 @@ namespace Graphics
             if (!*this)
                 return;
             BindStorage();
-            // It seems that glBufferData doesn't invalidate attribute pointers, so we don't need to get rid of draw binding here.
+            // glBufferData doesn't invalidate attribute pointers, so the vertex array stays valid.
             glBufferData(GL_ARRAY_BUFFER, count * sizeof(T), source, usage);
             data.size = count;
         }
@@ -235,6 +345,37 @@ namespace Graphics
             glBufferSubData(GL_ARRAY_BUFFER, offset, bytes, source);
         }
 
+        // Allocates immutable storage, which can't be resized later. Requires `Extensions::BufferStorage()`. Binds storage.
+        // `flags` are passed to `glBufferStorage()`, e.g. `GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT`.
+        void SetImmutableData(int count, const T *source, GLbitfield flags)
+        {
+            if (!*this)
+                return;
+            BindStorage();
+            glBufferStorage(GL_ARRAY_BUFFER, count * sizeof(T), source, flags);
+            data.size = count;
+        }
+
+        // Maps a range of the buffer. Throws on failure. Binds storage.
+        // Deleting the buffer unmaps it automatically.
+        [[nodiscard]] T *Map(int elem_offset, int elem_count, GLbitfield access)
+        {
+            if (!*this)
+                return 0;
+            BindStorage();
+            void *ret = glMapBufferRange(GL_ARRAY_BUFFER, elem_offset * sizeof(T), elem_count * sizeof(T), access);
+            if (!ret)
+                Program::Error("Unable to map a vertex buffer.");
+            return (T *)ret;
+        }
+        void Unmap() // Binds storage.
+        {
+            if (!*this)
+                return;
+            BindStorage();
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+
         void Draw(DrawMode p, int from, int count) // Binds for drawing.
         {
             static_assert(is_reflected, "Element type of this buffer is not reflected, unable to draw.");
@@ -253,7 +394,121 @@ namespace Graphics
         }
     };
 
-    struct DummyVertexArray // Good for core profile
+    // Holds vertex indices for `glDrawElements()`. `T` must be `uint8_t`, `uint16_t`, or `uint32_t`.
+    template <typename T> class IndexBuffer
+    {
+        static_assert(std::is_same_v<T, uint8_t> || std::is_same_v<T, uint16_t> || std::is_same_v<T, uint32_t>, "Invalid index type.");
+
+        struct Data
+        {
+            GLuint handle = 0;
+            int size = 0;
+        };
+        Data data;
+
+      public:
+        static constexpr GLenum gl_type = std::is_same_v<T, uint8_t> ? GL_UNSIGNED_BYTE : std::is_same_v<T, uint16_t> ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+        IndexBuffer(decltype(nullptr)) {}
+
+        IndexBuffer()
+        {
+            glGenBuffers(1, &data.handle);
+            if (!data.handle)
+                Program::Error("Unable to create an index buffer.");
+        }
+        IndexBuffer(int count, const T *source = 0, Usage usage = static_draw) : IndexBuffer() // Binds the buffer.
+        {
+            SetData(count, source, usage);
+        }
+
+        IndexBuffer(IndexBuffer &&other) noexcept : data(std::exchange(other.data, {})) {}
+        IndexBuffer &operator=(IndexBuffer other) noexcept
+        {
+            std::swap(data, other.data);
+            return *this;
+        }
+
+        ~IndexBuffer()
+        {
+            if (data.handle)
+            {
+                Buffers::ForgetBoundBuffer(data.handle);
+                glDeleteBuffers(1, &data.handle);
+            }
+        }
+
+        explicit operator bool() const
+        {
+            return bool(data.handle);
+        }
+
+        GLuint Handle() const
+        {
+            return data.handle;
+        }
+
+        void Bind() const // The binding is a part of the current vertex array state.
+        {
+            if (!*this)
+                return;
+            Buffers::BindElements(data.handle);
+        }
+        [[nodiscard]] bool Bound() const
+        {
+            return data.handle && data.handle == Buffers::ElementsBinding();
+        }
+
+        int Size() const // This size is measured in elements, not bytes.
+        {
+            return data.size;
+        }
+
+        void SetData(int count, const T *source = 0, Usage usage = static_draw) // Binds the buffer.
+        {
+            if (!*this)
+                return;
+            Bind();
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, count * sizeof(T), source, usage);
+            data.size = count;
+        }
+
+        // Draws vertices from `vertices`, using `count` indices starting from `from`. Binds `vertices` for drawing.
+        template <typename V> void Draw(const VertexBuffer<V> &vertices, DrawMode p, int from, int count) const
+        {
+            static_assert(VertexBuffer<V>::is_reflected, "Element type of the vertex buffer is not reflected, unable to draw.");
+            if (!*this || !vertices)
+                return;
+            vertices.BindDraw();
+            Bind();
+            glDrawElements(p, count, gl_type, (void *)(uintptr_t)(from * sizeof(T)));
+        }
+        template <typename V> void Draw(const VertexBuffer<V> &vertices, DrawMode p, int count) const
+        {
+            Draw(vertices, p, 0, count);
+        }
+        template <typename V> void Draw(const VertexBuffer<V> &vertices, DrawMode p) const
+        {
+            Draw(vertices, p, 0, Size());
+        }
+
+        // Draws `instance_count` instances, using per-instance attributes from `instances` starting from element `first_instance`.
+        // Requires `Extensions::InstancedArrays()`.
+        template <typename V, typename I> void DrawInstanced(const VertexBuffer<V> &vertices, const VertexBuffer<I> &instances, int first_instance, int instance_count, DrawMode p, int from, int count) const
+        {
+            if (!*this || !vertices || !instances)
+                return;
+            Buffers::BindDrawInstanced<V, I>(vertices.Handle(), instances.Handle(), first_instance);
+            Bind();
+            glDrawElementsInstanced(p, count, gl_type, (void *)(uintptr_t)(from * sizeof(T)), instance_count);
+        }
+        template <typename V, typename I> void DrawInstanced(const VertexBuffer<V> &vertices, const VertexBuffer<I> &instances, int first_instance, int instance_count, DrawMode p) const
+        {
+            DrawInstanced(vertices, instances, first_instance, instance_count, p, 0, Size());
+        }
+    };
+
+    struct DummyVertexArray // Good for core profile. Vertex buffers have their own vertex arrays, this one only provides a valid initial binding.
     {
         DummyVertexArray()
         {
@@ -261,7 +516,7 @@ namespace Graphics
             glGenVertexArrays(1, &vao);
             if (!vao)
                 Program::Error("Unable to create the dummy vertex array object.");
-            glBindVertexArray(vao);
+            Buffers::BindVertexArray(vao);
         }
         DummyVertexArray(const DummyVertexArray &) = delete;
         DummyVertexArray &operator=(const DummyVertexArray &) = delete;
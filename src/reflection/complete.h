@@ -2,6 +2,7 @@
 
 #include "reflection/interface.h"
 #include "reflection/containers_std.h"
+#include "reflection/from_json.h"
 #include "reflection/primitives_arithmetic.h"
 #include "reflection/primitives_string.h"
 #include "reflection/structures_array.h"
@@ -0,0 +1,259 @@
+#pragma once
+
+#include <array>
+#include <exception>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "interface.h"
+
+#include "program/errors.h"
+#include "utils/json_reader.h"
+#include "utils/robust_compare.h"
+
+/* Reads reflected objects directly from JSON, without building a `Json` document.
+ *
+ * Structures with named fields are read from JSON objects. Unknown keys are skipped, and missing optional fields keep their values.
+ * Tuple-like structures (vectors, arrays, tuples) and containers are read from JSON arrays.
+ * Maps with `std::string` keys are read from JSON objects. Elements of other maps are pairs, so they're read as `[key, value]` arrays.
+ * Numbers, booleans and strings are read from the corresponding JSON values. Other primitives are read from JSON strings, using their `from_string()`.
+ *
+ * Example usage:
+ *
+ *     ReflectStruct(Layer,( (std::string)(name), (int)(width,height), (std::vector<int>)(data), ))
+ *     Layer layer = Refl::FromJson<Layer>(text);
+ */
+
+namespace Refl
+{
+    namespace impl
+    {
+        // Adds a path segment to an error message, the same way `from_string_low()` does.
+        [[noreturn]] inline void rethrow_with_json_path(const std::exception &e, std::string segment)
+        {
+            std::string msg = e.what();
+            if (msg[0] != '.')
+                segment += ": ";
+            Program::Error(segment + msg);
+        }
+
+        // Whether `T` is an associative container with `std::string` keys. Those are read from JSON objects.
+        template <typename T, typename = void> inline constexpr bool is_string_keyed_map = false;
+        template <typename T> inline constexpr bool is_string_keyed_map<T, Meta::void_type<typename T::key_type, typename T::mapped_type>> = std::is_same_v<typename T::key_type, std::string>;
+
+        // The first token of the value must already be read.
+        template <typename T> void from_json_low(T &object, JsonReader &reader, FromStringMode mode)
+        {
+            using refl = Interface<T &>;
+            refl interface(object);
+
+            if constexpr (refl::is_primitive)
+            {
+                if constexpr (std::is_same_v<T, bool>)
+                {
+                    object = reader.GetBool();
+                }
+                else if constexpr (std::is_integral_v<T>)
+                {
+                    int value = reader.GetInt();
+                    if (RobustCompare::int_not_in_inclusive_range(value, std::numeric_limits<T>::min(), std::numeric_limits<T>::max()))
+                        Program::Error("The value is out of range.");
+                    object = value;
+                }
+                else if constexpr (std::is_floating_point_v<T>)
+                {
+                    object = reader.GetReal();
+                }
+                else if constexpr (std::is_same_v<T, std::string>)
+                {
+                    object = reader.GetStringView();
+                }
+                else
+                {
+                    interface.from_string(reader.GetString());
+                }
+            }
+            else if constexpr (refl::is_structure && !refl::is_structure_tuple)
+            {
+                reader.CheckToken(JsonReader::begin_object);
+
+                // Make functions to parse fields.
+                constexpr auto field_parsers = Meta::cexpr_generate_array<refl::field_count()>(
+                    [](auto index)
+                    {
+                        constexpr int i = index.value;
+
+                        return +[](const refl &interface, JsonReader &reader, FromStringMode mode)
+                        {
+                            from_json_low(interface.template field_value<i>(), reader, mode);
+                        };
+                    }
+                );
+
+                // Flags for existing fields.
+                std::array<bool, refl::field_count()> existing_fields{};
+
+                while (reader.Next() == JsonReader::key)
+                {
+                    int index = refl::field_index_from_name(reader.GetStringView());
+                    if (index == -1)
+                    {
+                        reader.SkipValue();
+                        continue;
+                    }
+
+                    std::string_view name = refl::field_name(index); // The key itself can be invalidated by reading the value.
+
+                    if (existing_fields[index])
+                        Program::Error("Duplicate field named `", name, "`.");
+
+                    try
+                    {
+                        reader.Next();
+                        field_parsers[index](interface, reader, mode);
+                    }
+                    catch (std::exception &e)
+                    {
+                        rethrow_with_json_path(e, "." + std::string(name));
+                    }
+
+                    existing_fields[index] = 1;
+                }
+
+                // Check for uninitialized fields.
+                if (mode == full)
+                {
+                    std::string missing;
+                    for (int i = 0; i < refl::field_count(); i++)
+                    {
+                        if (refl::field_category(i) == FieldCategory::optional || existing_fields[i])
+                            continue;
+                        if (missing.size() > 0)
+                            missing += ", ";
+                        missing += '`';
+                        missing += refl::field_name(i);
+                        missing += '`';
+                    }
+                    if (missing.size() > 0)
+                        Program::Error("Following fields are missing: ", missing, ".");
+                }
+            }
+            else if constexpr (refl::is_structure)
+            {
+                reader.CheckToken(JsonReader::begin_array);
+
+                refl::for_each_field([&](auto index)
+                {
+                    constexpr int i = index.value;
+
+                    try
+                    {
+                        reader.Next();
+                        from_json_low(interface.template field_value<i>(), reader, mode);
+                    }
+                    catch (std::exception &e)
+                    {
+                        rethrow_with_json_path(e, "." + std::string(refl::field_name(i)) + "(" + std::to_string(i) + ")");
+                    }
+                });
+
+                reader.Expect(JsonReader::end_array);
+            }
+            else if constexpr (is_string_keyed_map<T>)
+            {
+                reader.CheckToken(JsonReader::begin_object);
+
+                object = {};
+
+                while (reader.Next() == JsonReader::key)
+                {
+                    typename refl::mutable_element_type tmp{};
+                    tmp.first = reader.GetStringView(); // The key itself can be invalidated by reading the value.
+
+                    try
+                    {
+                        reader.Next();
+                        from_json_low(tmp.second, reader, mode);
+                    }
+                    catch (std::exception &e)
+                    {
+                        rethrow_with_json_path(e, "." + tmp.first);
+                    }
+
+                    std::string key = tmp.first;
+                    if (!interface.insert(std::move(tmp)))
+                        Program::Error("Duplicate key `", key, "`.");
+                }
+            }
+            else // is_container
+            {
+                reader.CheckToken(JsonReader::begin_array);
+
+                object = {};
+
+                int index = 0;
+                while (reader.Next() != JsonReader::end_array)
+                {
+                    try
+                    {
+                        typename refl::mutable_element_type tmp{};
+                        from_json_low(tmp, reader, mode);
+                        if (!interface.insert(std::move(tmp)))
+                            Program::Error("Invalid element.");
+                    }
+                    catch (std::exception &e)
+                    {
+                        rethrow_with_json_path(e, "." + std::to_string(index));
+                    }
+
+                    index++;
+                }
+            }
+        }
+    }
+
+    // Reads the next value from `reader` into `object`.
+    template <typename T> void FromJson(T &object, JsonReader &reader, FromStringMode mode = full)
+    {
+        try
+        {
+            reader.Next();
+            impl::from_json_low(object, reader, mode);
+        }
+        catch (std::exception &e)
+        {
+            std::string msg = e.what();
+            if (msg[0] == '.')
+            {
+                msg.erase(msg.begin());
+                msg = "At " + msg;
+            }
+            msg = "Unable to parse reflected object from JSON:\n" + msg;
+            Program::Error(msg);
+        }
+    }
+
+    // Reads `object` from a JSON string. The string must contain nothing else.
+    template <typename T> void FromJson(T &object, std::string_view text, FromStringMode mode = full)
+    {
+        JsonReader reader = JsonReader::FromString(text);
+        FromJson(object, reader, mode);
+        reader.Expect(JsonReader::end);
+    }
+    template <typename T> [[nodiscard]] T FromJson(std::string_view text)
+    {
+        T ret{};
+        FromJson(ret, text);
+        return ret;
+    }
+
+    // Reads `object` from a JSON file, chunk by chunk.
+    template <typename T> void FromJsonFile(T &object, std::string file_name, FromStringMode mode = full)
+    {
+        JsonReader reader = JsonReader::FromFile(file_name);
+        FromJson(object, reader, mode);
+        reader.Expect(JsonReader::end);
+    }
+}
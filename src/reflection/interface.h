@@ -2,13 +2,17 @@
 
 #include <array>
 #include <cstddef>
+#include <cstdint>
 #include <map>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "program/errors.h"
+#include "utils/memory_access.h"
 #include "utils/meta.h"
 
 namespace Refl
@@ -16,6 +20,106 @@ namespace Refl
     enum class FieldCategory {mandatory, optional, default_category = mandatory};
     enum FromStringMode {full, partial};
 
+    // Accumulates the binary representation of reflected objects.
+    // Numbers are stored as little-endian, sizes as unsigned LEB128 varints.
+    class BinaryWriter
+    {
+        std::vector<uint8_t> bytes;
+
+      public:
+        BinaryWriter() {}
+
+        template <typename T> void write_little(T value)
+        {
+            static_assert(std::is_arithmetic_v<T>);
+            std::size_t pos = bytes.size();
+            bytes.resize(pos + sizeof(T));
+            Memory::WriteLittle<T>(bytes.data() + pos, value);
+        }
+
+        void write_varint(uint64_t value)
+        {
+            while (value >= 0x80)
+            {
+                bytes.push_back(uint8_t(value | 0x80));
+                value >>= 7;
+            }
+            bytes.push_back(uint8_t(value));
+        }
+
+        void write_bytes(const void *data, std::size_t size)
+        {
+            bytes.insert(bytes.end(), (const uint8_t *)data, (const uint8_t *)data + size);
+        }
+
+        void write_string(std::string_view str) // Writes the length, then the bytes.
+        {
+            write_varint(str.size());
+            write_bytes(str.data(), str.size());
+        }
+
+        [[nodiscard]] const std::vector<uint8_t> &data() const
+        {
+            return bytes;
+        }
+        [[nodiscard]] std::vector<uint8_t> take_data()
+        {
+            return std::move(bytes);
+        }
+    };
+
+    // Reads the binary representation of reflected objects. Throws if there's not enough data.
+    // Doesn't copy the data, so `read_bytes()` and `read_string_view()` return pointers into the original buffer.
+    class BinaryReader
+    {
+        const uint8_t *cur = 0, *end = 0;
+
+      public:
+        BinaryReader() {}
+        BinaryReader(const uint8_t *begin, const uint8_t *end) : cur(begin), end(end) {}
+
+        [[nodiscard]] std::size_t remaining() const
+        {
+            return end - cur;
+        }
+
+        [[nodiscard]] const uint8_t *read_bytes(std::size_t size)
+        {
+            if (remaining() < size)
+                Program::Error("Unexpected end of binary data.");
+            const uint8_t *ret = cur;
+            cur += size;
+            return ret;
+        }
+
+        template <typename T> [[nodiscard]] T read_little()
+        {
+            static_assert(std::is_arithmetic_v<T>);
+            return Memory::ReadLittle<T>(read_bytes(sizeof(T)));
+        }
+
+        [[nodiscard]] uint64_t read_varint()
+        {
+            uint64_t ret = 0;
+            for (int shift = 0; shift < 64; shift += 7)
+            {
+                uint8_t byte = *read_bytes(1);
+                ret |= uint64_t(byte & 0x7f) << shift;
+                if (!(byte & 0x80))
+                    return ret;
+            }
+            Program::Error("Invalid varint in binary data.");
+        }
+
+        [[nodiscard]] std::string_view read_string_view() // The view points into the original buffer.
+        {
+            uint64_t size = read_varint();
+            if (size > remaining())
+                Program::Error("Unexpected end of binary data.");
+            return std::string_view((const char *)read_bytes(size), size);
+        }
+    };
+
     namespace Custom
     {
         template <typename T> using not_specialized_tag = typename T::not_specialized_tag;
@@ -36,6 +140,10 @@ namespace Refl
             // On success, returns 1, changes the referenced object, and advances the char pointer.
             // On failure, returns 0. Values of the object and the char pointer are unspecfified.
             static bool from_string(T &, const char *&) {return 0;}
+
+            // Optional. If those are missing, the binary representation is the same as `to_string()`, stored as a string.
+            // static void to_binary(const T &, BinaryWriter &);
+            // static void from_binary(T &, BinaryReader &); // Throws on failure.
         };
 
         template <typename T, typename = void> struct Structure
@@ -48,7 +156,7 @@ namespace Refl
             static constexpr bool is_tuple = 0; // Forces `to_string` and `from_string` to use a terse syntax without field names (in this case field categories are ignored, all fields are considered mandatory).
             static constexpr int field_count = 0;
             template <int I> static constexpr void field(T &); // When specialized, should return `auto &`.
-            static std::string field_name(int index) {(void)index; return "??";}
+            static constexpr std::string_view field_name(int index) {(void)index; return "??";}
             static constexpr FieldCategory field_category(int index) {(void)index; return FieldCategory::default_category;}
         };
 
@@ -95,6 +203,227 @@ namespace Refl
         };
 
 
+        template <typename L, typename T> using primitive_to_binary = decltype(L::to_binary(std::declval<const T &>(), std::declval<BinaryWriter &>()));
+        template <typename L, typename T> using primitive_from_binary = decltype(L::from_binary(std::declval<T &>(), std::declval<BinaryReader &>()));
+
+        // A hash for field names, used by `field_index_from_name()`.
+        [[nodiscard]] constexpr uint64_t name_hash(std::string_view name, uint32_t seed)
+        {
+            uint64_t ret = 0xcbf29ce484222325 ^ (seed * uint64_t(0x9e3779b97f4a7c15));
+            for (char ch : name)
+            {
+                ret ^= (unsigned char)ch;
+                ret *= 0x100000001b3;
+            }
+            ret ^= ret >> 29;
+            ret *= 0xbf58476d1ce4e5b9;
+            return ret ^ (ret >> 32);
+        }
+
+        [[nodiscard]] constexpr int name_hash_table_size(int name_count)
+        {
+            int ret = 1;
+            while (ret < name_count * 2)
+                ret *= 2;
+            return ret;
+        }
+
+        // Structures with more fields than this use a sorted name list with a binary search, instead of a perfect hash table.
+        inline constexpr int max_name_hash_table_names = 256;
+
+        // A perfect hash table, mapping names to their indices, built with the "hash and displace" method.
+        // Names are split into buckets by the hash. Each bucket gets a displacement, chosen so that its names land in free slots.
+        template <int N> struct name_hash_table
+        {
+            static constexpr int size = name_hash_table_size(N);
+            static constexpr int bucket_count = N / 2 + 1;
+
+            bool ok = false; // False if the table couldn't be built. This shouldn't happen in practice.
+            uint32_t seed = 0;
+            std::array<uint32_t, bucket_count> displacements{};
+            std::array<int, size> slots{}; // Name indices, or -1 for empty slots.
+
+            [[nodiscard]] static constexpr uint32_t bucket(uint64_t hash)
+            {
+                return uint32_t(hash >> 32) % bucket_count;
+            }
+            [[nodiscard]] static constexpr int slot(uint64_t hash, uint32_t displacement)
+            {
+                return (uint32_t(hash) + displacement * (uint32_t(hash >> 16) | 1)) & (size - 1);
+            }
+
+            [[nodiscard]] constexpr int find(std::string_view name) const // Returns the only index that can correspond to this name, or -1.
+            {
+                uint64_t hash = name_hash(name, seed);
+                return slots[slot(hash, displacements[bucket(hash)])];
+            }
+        };
+
+        // `get_name(i)` should return the `i`-th name as a `std::string_view`. The names must be unique.
+        // The search is bounded: if it fails, `ok` is set to false in the result.
+        template <int N, typename F> [[nodiscard]] constexpr name_hash_table<N> make_name_hash_table(F get_name)
+        {
+            using table_t = name_hash_table<N>;
+            constexpr int max_seeds = 16, max_displacement = table_t::size * 4;
+
+            table_t ret;
+            for (ret.seed = 0; ret.seed < max_seeds; ret.seed++)
+            {
+                std::array<uint64_t, N> hashes{};
+                std::array<int, table_t::bucket_count + 1> bucket_begin{}; // Indices into `members`.
+                for (int i = 0; i < N; i++)
+                {
+                    hashes[i] = name_hash(get_name(i), ret.seed);
+                    bucket_begin[table_t::bucket(hashes[i]) + 1]++;
+                }
+
+                // Group the names by bucket.
+                for (int b = 0; b < table_t::bucket_count; b++)
+                    bucket_begin[b + 1] += bucket_begin[b];
+                std::array<int, N> members{};
+                std::array<int, table_t::bucket_count> bucket_fill{};
+                for (int i = 0; i < N; i++)
+                {
+                    int b = table_t::bucket(hashes[i]);
+                    members[bucket_begin[b] + bucket_fill[b]++] = i;
+                }
+
+                for (int &slot : ret.slots)
+                    slot = -1;
+
+                // Place larger buckets first, since they're harder to place.
+                int max_bucket_size = 0;
+                for (int b = 0; b < table_t::bucket_count; b++)
+                    max_bucket_size = bucket_fill[b] > max_bucket_size ? bucket_fill[b] : max_bucket_size;
+
+                bool ok = true;
+                for (int bucket_size = max_bucket_size; ok && bucket_size > 0; bucket_size--)
+                for (int b = 0; ok && b < table_t::bucket_count; b++)
+                {
+                    if (bucket_fill[b] != bucket_size)
+                        continue;
+
+                    ok = false;
+                    for (uint32_t d = 0; !ok && d < max_displacement; d++)
+                    {
+                        // Check that the names land in distinct free slots.
+                        int placed = 0;
+                        for (; placed < bucket_size; placed++)
+                        {
+                            int &slot = ret.slots[table_t::slot(hashes[members[bucket_begin[b] + placed]], d)];
+                            if (slot != -1)
+                                break;
+                            slot = members[bucket_begin[b] + placed];
+                        }
+
+                        if (placed == bucket_size)
+                        {
+                            ret.displacements[b] = d;
+                            ok = true;
+                        }
+                        else
+                        {
+                            // Undo the partial placement.
+                            for (int k = 0; k < placed; k++)
+                                ret.slots[table_t::slot(hashes[members[bucket_begin[b] + k]], d)] = -1;
+                        }
+                    }
+                }
+
+                if (ok)
+                {
+                    ret.ok = true;
+                    return ret;
+                }
+            }
+
+            return ret;
+        }
+
+        // A sorted list of names, for structures with too many fields for `name_hash_table`.
+        template <int N> struct sorted_names
+        {
+            std::array<std::string_view, N> names{};
+            std::array<int, N> indices{};
+
+            [[nodiscard]] constexpr int find(std::string_view name) const // Returns the only index that can correspond to this name, or -1.
+            {
+                int begin = 0, end = N;
+                while (begin < end)
+                {
+                    int mid = begin + (end - begin) / 2;
+                    if (names[mid] < name)
+                        begin = mid + 1;
+                    else
+                        end = mid;
+                }
+                return begin < N ? indices[begin] : -1;
+            }
+        };
+
+        template <int N, typename F> [[nodiscard]] constexpr sorted_names<N> make_sorted_names(F get_name)
+        {
+            sorted_names<N> ret;
+            for (int i = 0; i < N; i++)
+            {
+                // Insertion sort.
+                std::string_view name = get_name(i);
+                int j = i;
+                while (j > 0 && name < ret.names[j-1])
+                {
+                    ret.names[j] = ret.names[j-1];
+                    ret.indices[j] = ret.indices[j-1];
+                    j--;
+                }
+                ret.names[j] = name;
+                ret.indices[j] = i;
+            }
+            return ret;
+        }
+
+        // Makes a table of decimal numbers, to be used as field names.
+        template <int N> struct index_names
+        {
+            std::array<std::array<char, 12>, N> storage{};
+            std::array<int, N> lengths{};
+
+            constexpr index_names()
+            {
+                for (int i = 0; i < N; i++)
+                {
+                    char digits[12]{};
+                    int len = 0;
+                    int value = i;
+                    do
+                    {
+                        digits[len++] = char('0' + value % 10);
+                        value /= 10;
+                    }
+                    while (value);
+                    for (int j = 0; j < len; j++)
+                        storage[i][j] = digits[len - 1 - j];
+                    lengths[i] = len;
+                }
+            }
+
+            [[nodiscard]] constexpr std::string_view operator[](int index) const
+            {
+                return std::string_view(storage[index].data(), lengths[index]);
+            }
+        };
+
+        // 64-bit FNV-1a.
+        [[nodiscard]] inline uint64_t fnv1a(std::string_view str)
+        {
+            uint64_t ret = 0xcbf29ce484222325;
+            for (char ch : str)
+            {
+                ret ^= (unsigned char)ch;
+                ret *= 0x100000001b3;
+            }
+            return ret;
+        }
+
         inline constexpr bool is_alphanum(char ch)
         {
             return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') || ch == '_';
@@ -391,9 +720,10 @@ namespace Refl
                         }
 
                         // Read field name.
-                        std::string name;
+                        const char *name_begin = str;
                         while (impl::is_alphanum(*str))
-                            name += *str++;
+                            str++;
+                        std::string_view name(name_begin, str - name_begin);
 
                         // Stop if field name is empty.
                         if (name.empty()) Program::Error("Expected field name.");
@@ -421,7 +751,8 @@ namespace Refl
                         {
                             std::string msg = e.what();
                             std::string append;
-                            append = "." + name;
+                            append = ".";
+                            append += name;
                             if (msg[0] != '.')
                                 append += ": ";
                             msg = append + msg;
@@ -487,7 +818,7 @@ namespace Refl
                         {
                             std::string msg = e.what();
                             std::string append;
-                            append = "." + field_name(i) + "(" + std::to_string(i) + ")";
+                            append = "." + std::string(field_name(i)) + "(" + std::to_string(i) + ")";
                             if (msg[0] != '.')
                                 append += ": ";
                             msg = append + msg;
@@ -606,6 +937,142 @@ namespace Refl
             }
         }
 
+        // A description of the binary layout. Changes whenever a type name, a field name, or a field order changes.
+        static const std::string &binary_schema()
+        {
+            static const std::string ret = []{
+                std::string ret;
+                // Tuple-like structures are described only by their fields, since their names (e.g. for vectors) can depend on other static variables, which might not be initialized yet.
+                if constexpr (!is_structure_tuple)
+                    ret = type_name();
+                if constexpr (is_structure)
+                {
+                    ret += is_structure_tuple ? '(' : '{';
+                    for_each_field([&](auto index)
+                    {
+                        constexpr int i = index.value;
+                        if constexpr (i != 0)
+                            ret += ',';
+                        if constexpr (!is_structure_tuple)
+                        {
+                            ret += field_name(i);
+                            ret += ':';
+                        }
+                        ret += Interface<field_type<i> &>::binary_schema();
+                    });
+                    ret += is_structure_tuple ? ')' : '}';
+                }
+                else if constexpr (is_container)
+                {
+                    ret += '[';
+                    ret += Interface<mutable_element_type &>::binary_schema();
+                    ret += ']';
+                }
+                return ret;
+            }();
+            return ret;
+        }
+        static uint64_t binary_schema_hash()
+        {
+            static const uint64_t ret = impl::fnv1a(binary_schema());
+            return ret;
+        }
+
+        // Structures are stored as their fields in order, without names. Containers are stored as a size followed by the elements.
+        void to_binary_low(BinaryWriter &writer) const
+        {
+            if constexpr (is_primitive)
+            {
+                if constexpr (Meta::is_detected<impl::primitive_to_binary, low, type_no_cvref>)
+                    low::to_binary(*ptr, writer);
+                else
+                    writer.write_string(to_string());
+            }
+            else if constexpr (is_structure)
+            {
+                for_each_field([&](auto index)
+                {
+                    field<index.value>().to_binary_low(writer);
+                });
+            }
+            else // is_container
+            {
+                writer.write_varint(size());
+                for_each_element([&](auto it)
+                {
+                    Interface<element_type>(*it).to_binary_low(writer); // We have to use `Refl::Interface` instead of `Interface` for template argument deduction to work.
+                });
+            }
+        }
+        void from_binary_low(BinaryReader &reader)
+        {
+            static_assert(is_mutable);
+
+            if constexpr (is_primitive)
+            {
+                if constexpr (Meta::is_detected<impl::primitive_from_binary, low, type_no_cvref>)
+                {
+                    low::from_binary(*ptr, reader);
+                }
+                else
+                {
+                    std::string_view str = reader.read_string_view();
+                    std::string copy(str); // `from_string()` needs a null-terminated string.
+                    const char *cur = copy.c_str();
+                    if (!low::from_string(*ptr, cur) || cur != copy.c_str() + copy.size())
+                        Program::Error("Primitive type parsing failed.");
+                }
+            }
+            else if constexpr (is_structure)
+            {
+                for_each_field([&](auto index)
+                {
+                    field<index.value>().from_binary_low(reader);
+                });
+            }
+            else // is_container
+            {
+                *ptr = {};
+                uint64_t count = reader.read_varint();
+                for (uint64_t i = 0; i < count; i++)
+                {
+                    mutable_element_type tmp{};
+                    Interface<mutable_element_type>(tmp).from_binary_low(reader);
+                    if (!insert(std::move(tmp)))
+                        Program::Error("Invalid element.");
+                }
+            }
+        }
+
+        // Returns the schema hash (8 bytes, little-endian) followed by the object.
+        [[nodiscard]] std::vector<uint8_t> to_binary() const
+        {
+            BinaryWriter writer;
+            writer.write_little<uint64_t>(binary_schema_hash());
+            to_binary_low(writer);
+            return writer.take_data();
+        }
+        void from_binary(const uint8_t *begin, const uint8_t *end)
+        {
+            try
+            {
+                BinaryReader reader(begin, end);
+                if (reader.read_little<uint64_t>() != binary_schema_hash())
+                    Program::Error("The binary data was written for a different version of this type.");
+                from_binary_low(reader);
+                if (reader.remaining() != 0)
+                    Program::Error("Unexpected data at the end of binary data.");
+            }
+            catch (std::exception &e)
+            {
+                Program::Error("Unable to parse reflected object from binary data:\n", e.what());
+            }
+        }
+        void from_binary(const std::vector<uint8_t> &data)
+        {
+            from_binary(data.data(), data.data() + data.size());
+        }
+
         template <typename F> static constexpr void for_each_field(F &&func) // `func` receives indices as `std::integral_constant<int,i>`.
         {
             static_assert(is_structure);
@@ -634,7 +1101,7 @@ namespace Refl
             static_assert(is_structure);
             return Interface<decltype(field_value<I>())>(field_value<I>()); // We have to use `Refl::Interface` instead of `Interface` for template argument deduction to work.
         }
-        static std::string field_name(int index)
+        static constexpr std::string_view field_name(int index)
         {
             static_assert(is_structure);
             if (index < 0 || index >= field_count())
@@ -648,27 +1115,24 @@ namespace Refl
                 return FieldCategory::default_category;
             return low::field_category(index);
         }
-        static int field_index_from_name(std::string name) // Returns -1 if no such field.
+        static constexpr int field_index_from_name(std::string_view name) // Returns -1 if no such field.
         {
-            if constexpr (!is_lvalue || !is_mutable)
+            static_assert(is_structure);
+            int index = -1;
+            if constexpr (field_count() <= impl::max_name_hash_table_names)
             {
-                return Interface<type_no_cvref &>::field_index_from_name(name);
+                constexpr auto table = impl::make_name_hash_table<field_count()>([](int i){return low::field_name(i);});
+                static_assert(table.ok, "Unable to build a perfect hash table for the field names. Make sure they are unique.");
+                index = table.find(name);
             }
             else
             {
-                static const auto map = Meta::cexpr_generate<std::map<std::string, int>, field_count()>(
-                    [](auto index)
-                    {
-                        constexpr int i = index.value;
-                        return std::pair{field_name(i), i};
-                    }
-                );
-
-                if (auto it = map.find(name); it != map.end())
-                    return it->second;
-                else
-                    return -1;
+                constexpr auto table = impl::make_sorted_names<field_count()>([](int i){return low::field_name(i);});
+                index = table.find(name);
             }
+            if (index == -1 || low::field_name(index) != name)
+                return -1;
+            return index;
         }
 
         // Container-specific
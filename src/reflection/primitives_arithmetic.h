@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -118,5 +119,31 @@ namespace Refl::Custom
                 return 1;
             }
         }
+
+        // The binary representation doesn't depend on the platform: types with platform-dependent sizes are stored as fixed-width types.
+        using binary_type = std::conditional_t<std::is_same_v<T, bool>, uint8_t,
+                            std::conditional_t<std::is_same_v<T, long>, int64_t,
+                            std::conditional_t<std::is_same_v<T, unsigned long>, uint64_t,
+                            std::conditional_t<std::is_same_v<T, wchar_t>, uint32_t,
+                            std::conditional_t<std::is_same_v<T, long double>, double, // This drops precision where `long double` is larger, but also doesn't write its padding bytes.
+                            T>>>>>;
+
+        static void to_binary(const T &object, BinaryWriter &writer)
+        {
+            writer.write_little<binary_type>(object);
+        }
+
+        static void from_binary(T &object, BinaryReader &reader)
+        {
+            binary_type value = reader.read_little<binary_type>();
+
+            if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool> && sizeof(T) < sizeof(binary_type))
+            {
+                if (RobustCompare::int_not_in_inclusive_range(value, std::numeric_limits<T>::min(), std::numeric_limits<T>::max()))
+                    Program::Error("Integer ", value, " is out of range for `", name, "`.");
+            }
+
+            object = value;
+        }
     };
 }
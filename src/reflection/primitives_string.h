@@ -120,5 +120,15 @@ namespace Refl::Custom
             string++; // Skip `"`.
             return 1;
         }
+
+        static void to_binary(const std::string &object, BinaryWriter &writer)
+        {
+            writer.write_string(object);
+        }
+
+        static void from_binary(std::string &object, BinaryReader &reader)
+        {
+            object = reader.read_string_view();
+        }
     };
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <type_traits>
 
 #include "interface.h"
@@ -14,13 +15,14 @@ namespace Refl::Custom
 
         static constexpr bool is_tuple = 1;
         static constexpr int field_count = std::extent_v<T>;
+        static constexpr Refl::impl::index_names<field_count> field_names{};
         template <int I> static constexpr auto &field(T &object)
         {
             return object[I];
         }
-        static std::string field_name(int index)
+        static constexpr std::string_view field_name(int index)
         {
-            return std::to_string(index);
+            return field_names[index];
         }
         static constexpr FieldCategory field_category(int index)
         {
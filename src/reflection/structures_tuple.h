@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <type_traits>
 
@@ -16,13 +17,14 @@ namespace Refl::Custom
 
         static constexpr bool is_tuple = 1;
         static constexpr int field_count = std::tuple_size_v<T>;
+        static constexpr Refl::impl::index_names<field_count> field_names{};
         template <int I> static constexpr auto &field(T &object)
         {
             return std::get<I>(object);
         }
-        static std::string field_name(int index)
+        static constexpr std::string_view field_name(int index)
         {
-            return std::to_string(index);
+            return field_names[index];
         }
         static constexpr FieldCategory field_category(int index)
         {
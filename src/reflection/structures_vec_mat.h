@@ -2,6 +2,7 @@
 
 #include <array>
 #include <string>
+#include <string_view>
 
 #include "interface.h"
 
@@ -12,7 +13,7 @@ namespace Refl::Custom
     template <typename T> struct Structure<T, std::enable_if_t<Math::is_vector_v<T>>>
     {
         // Field indices are guaranteed to be in valid range.
-        inline static const std::string name = "vec" + std::to_string(T::size) + "<" + Refl::Interface<typename T::type>::name() + ">";
+        inline static const std::string name = "vec" + std::to_string(T::size) + "<" + Refl::Interface<typename T::type>::type_name() + ">";
 
         static constexpr bool is_tuple = 1;
         static constexpr int field_count = T::size;
@@ -23,9 +24,9 @@ namespace Refl::Custom
             if constexpr (I == 2) return object.z;
             if constexpr (I == 3) return object.w;
         }
-        static std::string field_name(int index)
+        static constexpr std::string_view field_name(int index)
         {
-            return std::array<const char *, 4>{"x","y","z","w"}[index];
+            return std::array<std::string_view, 4>{"x","y","z","w"}[index];
         }
         static constexpr FieldCategory field_category(int index)
         {
@@ -37,7 +38,7 @@ namespace Refl::Custom
     template <typename T> struct Structure<T, std::enable_if_t<Math::is_matrix_v<T>>>
     {
         // Field indices are guaranteed to be in valid range.
-        inline static const std::string name = "mat" + std::to_string(T::width) + "x" + std::to_string(T::width) + "<" + Refl::Interface<typename T::type>::name() + ">";
+        inline static const std::string name = "mat" + std::to_string(T::width) + "x" + std::to_string(T::height) + "<" + Refl::Interface<typename T::type>::type_name() + ">";
 
         static constexpr bool is_tuple = 1;
         static constexpr int field_count = T::width * T::height;
@@ -75,12 +76,16 @@ namespace Refl::Custom
                 if constexpr (x == 3) return object.w.w;
             }
         }
-        static std::string field_name(int index)
+        static constexpr std::string_view field_name(int index)
         {
             int x = index % T::width;
             int y = index / T::width;
-            std::array<const char *, 4> names{"x","y","z","w"};
-            return std::string(names[x]) + "." + names[y];
+            return std::array<std::string_view, 16>{
+                "x.x","y.x","z.x","w.x",
+                "x.y","y.y","z.y","w.y",
+                "x.z","y.z","z.z","w.z",
+                "x.w","y.w","z.w","w.w",
+            }[y * 4 + x];
         }
         static constexpr FieldCategory field_category(int index)
         {
@@ -9,7 +9,12 @@ namespace ByteOrder
 {
     enum Order {little, big};
 
-    inline constexpr Order native = OnPlatform(LITTLE_ENDIAN)( little ) OnPlatform(BIG_ENDIAN)( big );
+    // We don't use `OnPlatform(LITTLE_ENDIAN)` here, because some standard headers define `LITTLE_ENDIAN` and `BIG_ENDIAN` as macros, which breaks it.
+    #ifdef PLATFORM_BIG_ENDIAN
+    inline constexpr Order native = big;
+    #else
+    inline constexpr Order native = little;
+    #endif
 
     inline void SwapBytes(std::uint8_t *data, std::size_t len)
     {
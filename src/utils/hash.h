@@ -1,11 +1,18 @@
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <functional>
 #include <initializer_list>
+#include <string_view>
 #include <tuple>
+#include <type_traits>
 #include <utility>
 
+#include "utils/memory_access.h"
+#include "utils/memory_file.h"
 #include "utils/meta.h"
 
 namespace Hash
@@ -88,6 +95,180 @@ namespace Hash
     };
 
 
+    // Stable hashes of byte sequences.
+    // Unlike `Compute()`, the results don't depend on the platform or the standard library, so they can be saved to files.
+    // The algorithm is similar to wyhash: three independent lanes consume 48 bytes per step, using 64x64->128 bit multiplication.
+
+    struct Hash128
+    {
+        std::uint64_t low = 0;
+        std::uint64_t high = 0;
+
+        [[nodiscard]] friend bool operator==(const Hash128 &a, const Hash128 &b) {return a.low == b.low && a.high == b.high;}
+        [[nodiscard]] friend bool operator!=(const Hash128 &a, const Hash128 &b) {return !(a == b);}
+    };
+
+    namespace impl
+    {
+        inline constexpr std::uint64_t secret[4] = {0xa0761d6478bd642f, 0xe7037ed1a0b428db, 0x8ebc6af09c88c6e3, 0x589965cc75374cc3};
+
+        // Multiplies two numbers, and returns the low and high halves of the 128-bit product in `a` and `b` respectively.
+        inline void MultiplyFull(std::uint64_t &a, std::uint64_t &b)
+        {
+            #if defined(__SIZEOF_INT128__)
+            __extension__ using uint128_t = unsigned __int128;
+            uint128_t product = uint128_t(a) * b;
+            a = std::uint64_t(product);
+            b = std::uint64_t(product >> 64);
+            #else
+            std::uint64_t a_hi = a >> 32, a_lo = std::uint32_t(a), b_hi = b >> 32, b_lo = std::uint32_t(b);
+            std::uint64_t hh = a_hi * b_hi, hl = a_hi * b_lo, lh = a_lo * b_hi, ll = a_lo * b_lo;
+            std::uint64_t mid = (ll >> 32) + std::uint32_t(hl) + std::uint32_t(lh);
+            a = (mid << 32) | std::uint32_t(ll);
+            b = hh + (hl >> 32) + (lh >> 32) + (mid >> 32);
+            #endif
+        }
+
+        [[nodiscard]] inline std::uint64_t Mix(std::uint64_t a, std::uint64_t b)
+        {
+            MultiplyFull(a, b);
+            return a ^ b;
+        }
+
+        [[nodiscard]] inline std::uint64_t Read64(const std::uint8_t *ptr)
+        {
+            return Memory::ReadLittle<std::uint64_t>(ptr);
+        }
+    }
+
+    // Incrementally computes a stable hash. Splitting the data into chunks doesn't affect the result.
+    class Stream
+    {
+      public:
+        static constexpr std::size_t block_size = 48;
+
+      private:
+        std::uint64_t lanes[3]{};
+        std::uint64_t total_size = 0;
+        std::uint8_t buffer[block_size]{};
+        std::size_t buffer_size = 0;
+
+        void ProcessBlock(const std::uint8_t *ptr)
+        {
+            for (int i = 0; i < 3; i++)
+                lanes[i] = impl::Mix(impl::Read64(ptr + i * 16) ^ impl::secret[i + 1], impl::Read64(ptr + i * 16 + 8) ^ lanes[i]);
+        }
+
+        // Mixes the unprocessed bytes (at most one block) into two separate states.
+        void Finish(std::uint64_t &a, std::uint64_t &b) const
+        {
+            std::uint64_t state_a = lanes[0] ^ lanes[1] ^ lanes[2];
+            std::uint64_t state_b = impl::Mix(lanes[0] ^ impl::secret[2], lanes[1] ^ impl::Mix(lanes[2], impl::secret[3]));
+
+            // Pad the tail with zeroes to a multiple of 16 bytes. The total size is mixed in at the end, so padding can't cause collisions.
+            std::uint8_t tail[block_size]{};
+            std::memcpy(tail, buffer, buffer_size);
+            std::size_t tail_size = std::max(std::size_t(16), (buffer_size + 15) / 16 * 16);
+            for (std::size_t i = 0; i < tail_size; i += 16)
+            {
+                std::uint64_t x = impl::Read64(tail + i), y = impl::Read64(tail + i + 8);
+                state_a = impl::Mix(x ^ impl::secret[1], y ^ state_a);
+                state_b = impl::Mix(x ^ impl::secret[2], y ^ state_b);
+            }
+
+            a = impl::Mix(state_a ^ impl::secret[0] ^ total_size, state_b ^ impl::secret[1]);
+            b = impl::Mix(state_b ^ impl::secret[3] ^ total_size, a ^ impl::secret[2]);
+        }
+
+      public:
+        Stream(std::uint64_t seed = 0)
+        {
+            seed ^= impl::Mix(seed ^ impl::secret[0], impl::secret[1]);
+            for (std::uint64_t &lane : lanes)
+                lane = seed;
+        }
+
+        void Append(const void *data, std::size_t size)
+        {
+            const std::uint8_t *ptr = static_cast<const std::uint8_t *>(data);
+            total_size += size;
+
+            // The last block is kept in the buffer, since `Finish()` handles it differently. So we only process a block when we know more data follows it.
+            if (buffer_size + size <= block_size)
+            {
+                if (size > 0) // `ptr` can be null in this case.
+                    std::memcpy(buffer + buffer_size, ptr, size);
+                buffer_size += size;
+                return;
+            }
+
+            if (buffer_size > 0)
+            {
+                std::size_t part = block_size - buffer_size;
+                std::memcpy(buffer + buffer_size, ptr, part);
+                ProcessBlock(buffer);
+                ptr += part;
+                size -= part;
+            }
+
+            while (size > block_size)
+            {
+                ProcessBlock(ptr);
+                ptr += block_size;
+                size -= block_size;
+            }
+
+            std::memcpy(buffer, ptr, size);
+            buffer_size = size;
+        }
+        void Append(std::string_view data)
+        {
+            Append(data.data(), data.size());
+        }
+
+        [[nodiscard]] std::uint64_t Get64() const
+        {
+            std::uint64_t a, b;
+            Finish(a, b);
+            return a;
+        }
+        [[nodiscard]] Hash128 Get128() const
+        {
+            Hash128 ret;
+            Finish(ret.low, ret.high);
+            return ret;
+        }
+    };
+
+    [[nodiscard]] inline std::uint64_t Bytes64(std::string_view data, std::uint64_t seed = 0)
+    {
+        Stream stream(seed);
+        stream.Append(data);
+        return stream.Get64();
+    }
+    template <typename T, std::enable_if_t<std::is_same_v<T, MemoryFile>, bool> = true> // A template to prevent implicit conversions from strings, which would load files.
+    [[nodiscard]] std::uint64_t Bytes64(const T &file, std::uint64_t seed = 0)
+    {
+        Stream stream(seed);
+        stream.Append(file.data(), file.size());
+        return stream.Get64();
+    }
+
+    [[nodiscard]] inline Hash128 Bytes128(std::string_view data, std::uint64_t seed = 0)
+    {
+        Stream stream(seed);
+        stream.Append(data);
+        return stream.Get128();
+    }
+    template <typename T, std::enable_if_t<std::is_same_v<T, MemoryFile>, bool> = true> // A template to prevent implicit conversions from strings, which would load files.
+    [[nodiscard]] Hash128 Bytes128(const T &file, std::uint64_t seed = 0)
+    {
+        Stream stream(seed);
+        stream.Append(file.data(), file.size());
+        return stream.Get128();
+    }
+
+
     // Custom hashes.
     namespace Custom
     {
@@ -1,95 +1,92 @@
 #include "json.h"
 
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
 #include <cstring>
-#include <limits>
 #include <ostream>
 
 #include "utils/strings.h"
 
-void Json::ParseSkipWhitespace(const char *&cur)
+struct Json::Parser
 {
-    while (*cur > '\0' && *cur <= ' ')
-        cur++;
-}
-
-std::string Json::ParseStringLow(const char *&cur)
-{
-    ParseSkipWhitespace(cur);
+    Json &json;
 
-    if (*cur != '"')
-        Program::Error("Expected `\"`.");
-    cur++;
+    // Elements and members of the containers that are currently being parsed. When a container ends, its part is moved to the document.
+    std::vector<int> element_stack;
+    std::vector<Member> member_stack;
 
-    const char *begin = cur;
-    bool backslash_preceding = 0;
+    static void SkipWhitespace(char *&cur)
+    {
+        while (*cur > '\0' && *cur <= ' ')
+            cur++;
+    }
 
-    while (1)
+    // Unescapes the string in place, and returns a view of the result.
+    static std::string_view ParseString(char *&cur)
     {
-        // Stop on `"`.
-        if (*cur == '"' && !backslash_preceding)
-            break;
+        SkipWhitespace(cur);
 
-        // Handle `\`.
-        backslash_preceding = (*cur == '\\' && !backslash_preceding);
+        if (*cur != '"')
+            Program::Error("Expected `\"`.");
+        cur++;
 
-        // Error if no more data.
-        if (*cur == '\0')
+        char *begin = cur;
+        char *out = cur; // The unescaped string is never longer than the source, so we can write over it.
+
+        while (1)
         {
-            cur = begin; // We do this to get a better error message.
-            Program::Error("This string lacks a terminating `\"` character.");
-        }
+            char ch = *cur;
 
-        // Error on non-printable character.
-        if (*cur > '\0' && *cur < ' ')
-            Program::Error("Invalid character in a string: 0x", std::hex, std::setfill('0'), std::setw(2), (int)(unsigned char)*cur, ".");
+            if (ch == '"')
+                break;
 
-        cur++;
-    }
+            if ((unsigned char)ch < ' ')
+            {
+                if (ch == '\0')
+                {
+                    cur = begin; // We do this to get a better error message.
+                    Program::Error("This string lacks a terminating `\"` character.");
+                }
+                Program::Error("Invalid character in a string: 0x", std::hex, std::setfill('0'), std::setw(2), (int)(unsigned char)ch, ".");
+            }
 
-    const char *end = cur;
+            if (ch != '\\')
+            {
+                *out++ = ch;
+                cur++;
+                continue;
+            }
 
-    std::string ret;
-    for (cur = begin; cur != end; cur++)
-    {
-        if (*cur != '\\')
-        {
-            ret += *cur;
-        }
-        else
-        {
             cur++;
-            if (cur == end)
-                Program::Error("Expected an escape character before `\"`.");
             switch (*cur)
             {
               case '\\':
               case '/':
               case '"':
-                ret += *cur;
+                *out++ = *cur;
                 break;
               case 'b':
-                ret += '\b';
+                *out++ = '\b';
                 break;
               case 'f':
-                ret += '\f';
+                *out++ = '\f';
                 break;
               case 'n':
-                ret += '\n';
+                *out++ = '\n';
                 break;
               case 'r':
-                ret += '\r';
+                *out++ = '\r';
                 break;
               case 't':
-                ret += '\t';
+                *out++ = '\t';
                 break;
               case 'u':
                 {
-                    cur++;
-                    if (end - cur < 4)
-                        Program::Error("Expected four hex digits after `\\u`.");
                     int value = 0;
                     for (int i = 0; i < 4; i++)
                     {
+                        cur++;
                         int digit;
                         if (*cur >= '0' && *cur <= '9')
                             digit = *cur - '0';
@@ -100,266 +97,328 @@ std::string Json::ParseStringLow(const char *&cur)
                         else
                             Program::Error("Expected four hex digits after `\\u`.");
                         value = value * 16 + digit;
-                        cur++;
                     }
                     if (value < 128)
                     {
-                        ret += char(value);
+                        *out++ = char(value);
                     }
                     else if (value < 2048) // 2048 = 2^11
                     {
-                        ret += char(0b1100'0000 + (value >> 6));
-                        ret += char(0b1000'0000 + (value & 0b0011'1111));
+                        *out++ = char(0b1100'0000 + (value >> 6));
+                        *out++ = char(0b1000'0000 + (value & 0b0011'1111));
                     }
                     else
                     {
-                        ret += char(0b1110'0000 + (value >> 12));
-                        ret += char(0b1000'0000 + ((value >> 6) & 0b0011'1111));
-                        ret += char(0b1000'0000 + (value & 0b0011'1111));
+                        *out++ = char(0b1110'0000 + (value >> 12));
+                        *out++ = char(0b1000'0000 + ((value >> 6) & 0b0011'1111));
+                        *out++ = char(0b1000'0000 + (value & 0b0011'1111));
                     }
-                    cur--; // This is needed because of the auto increment at the end of loop.
                 }
+                break;
+              case '\0':
+                cur = begin; // We do this to get a better error message.
+                Program::Error("This string lacks a terminating `\"` character.");
+                break;
+              default:
+                Program::Error("Invalid escape sequence.");
+                break;
             }
+            cur++;
         }
+
+        cur++; // Skip the `"`.
+        return std::string_view(begin, out - begin);
     }
 
-    cur++; // Skip the `"`.
-    return ret;
-}
+    // Returns false if there is no number at `cur`.
+    static bool ParseNumber(char *&cur, Node &node)
+    {
+        const char *begin = cur;
+        bool real = 0;
 
-Json Json::ParseLow(const char *&cur, int allowed_depth)
-{
-    if (allowed_depth < 0)
-        Program::Error("Too many nested elements.");
+        if (*cur == '-')
+            cur++;
 
-    auto TryGetString = [&](std::string string) -> bool
-    {
-        if (std::strncmp(string.c_str(), cur, string.size()) == 0)
-        {
-            cur += string.size();
-            return true;
-        }
-        else
+        const char *digits_begin = cur;
+        while (*cur >= '0' && *cur <= '9')
+            cur++;
+
+        if (cur == digits_begin)
         {
+            cur = (char *)begin;
             return false;
         }
-    };
-
-    ParseSkipWhitespace(cur);
-
-    switch (*cur)
-    {
-      case 'n': // null
-        if (TryGetString("null"))
-            return FromVariant(std::monostate{});
-        break;
-
-      case 'f': // boolean, false
-        if (TryGetString("false"))
-            return FromVariant(false);
-        break;
 
-      case 't': // boolean, true
-        if (TryGetString("true"))
-            return FromVariant(true);
-        break;
-
-      default: // number
+        if (*cur == '.')
         {
-            std::string str;
-            bool real = 0;
-
-            if (*cur == '-')
-            {
-                str += '-';
-                cur++;
-            }
+            cur++;
+            real = 1;
 
+            if (!(*cur >= '0' && *cur <= '9'))
+                Program::Error("Expected a digit after decimal point.");
             while (*cur >= '0' && *cur <= '9')
-                str += *cur++;
-
-            if (str.empty())
-                break;
-
-            if (*cur == '.')
-            {
                 cur++;
+        }
 
-                real = 1;
-                str += '.';
-
-                while (*cur >= '0' && *cur <= '9')
-                    str += *cur++;
+        if (*cur == 'e' || *cur == 'E')
+        {
+            cur++;
+            real = 1;
 
-                if (str.back() == '.')
-                    Program::Error("Expected a digit after decimal point.");
-            }
+            if (*cur == '+' || *cur == '-')
+                cur++;
 
-            if (*cur == 'e' || *cur == 'E')
-            {
+            if (!(*cur >= '0' && *cur <= '9'))
+                Program::Error("Expected a digit after `e`, possibly after a sign.");
+            while (*cur >= '0' && *cur <= '9')
                 cur++;
+        }
 
-                real = 1;
-                str += 'e';
+        // The syntax is already validated, so `from_chars()` can only fail on out-of-range values.
+        if (real)
+        {
+            node.type = num_real;
+            // Out of range doubles are not an error, `strtod()` used to return infinity or zero in that case, and we do the same.
+            if (std::from_chars(begin, cur, node.value_real).ec == std::errc::result_out_of_range)
+                node.value_real = std::strtod(begin, 0);
+        }
+        else
+        {
+            node.type = num_int;
+            if (std::from_chars(begin, cur, node.value_int).ec != std::errc{})
+                Program::Error("Overflow in integral constant.");
+        }
+        return true;
+    }
 
-                if (*cur == '+' || *cur == '-')
-                    str += *cur++;
+    // Returns the node index.
+    int ParseValue(char *&cur, int parent, int allowed_depth)
+    {
+        if (allowed_depth < 0)
+            Program::Error("Too many nested elements.");
 
-                while (*cur >= '0' && *cur <= '9')
-                    str += *cur++;
+        SkipWhitespace(cur);
 
-                if (str.back() == 'e' || str.back() == '+' || str.back() == '-')
-                    Program::Error("Expected a digit after `e`, possibly after a sign.");
-            }
+        int index = json.nodes.size();
+        json.nodes.emplace_back().parent = parent;
 
-            if (real)
+        auto TryGetString = [&](std::string_view string) -> bool
+        {
+            if (std::strncmp(string.data(), cur, string.size()) == 0)
             {
-                char *end = 0;
-                double num = std::strtod(str.c_str(), &end);
-                if (end == str.c_str())
-                    Program::Error("Unable to parse a number.");
-
-                return FromVariant(num);
+                cur += string.size();
+                return true;
             }
             else
             {
-                char *end = 0;
-                long num = std::strtol(str.c_str(), &end, 10);
-                if (end == str.c_str())
-                    Program::Error("Unable to parse a number.");
+                return false;
+            }
+        };
 
-                if constexpr (sizeof(int) < sizeof(long))
-                    if (num < std::numeric_limits<int>::min() || num > std::numeric_limits<int>::max())
-                        Program::Error("Overflow in integral constant.");
+        switch (*cur)
+        {
+          case 'n': // null
+            if (TryGetString("null"))
+                return index;
+            break;
 
-                return FromVariant(int(num));
+          case 'f': // boolean, false
+            if (TryGetString("false"))
+            {
+                json.nodes[index].type = boolean;
+                json.nodes[index].value_bool = false;
+                return index;
             }
-        }
-        break;
+            break;
 
-      case '"': // string
-        return FromVariant(ParseStringLow(cur));
-        break;
+          case 't': // boolean, true
+            if (TryGetString("true"))
+            {
+                json.nodes[index].type = boolean;
+                json.nodes[index].value_bool = true;
+                return index;
+            }
+            break;
 
-      case '[': // array
-        {
-            const char *begin = cur;
-            cur++; // Skip `[`.
+          default: // number
+            if (ParseNumber(cur, json.nodes[index]))
+                return index;
+            break;
 
-            array_t vec;
+          case '"': // string
+            {
+                std::string_view str = ParseString(cur);
+                json.nodes[index].type = string;
+                json.nodes[index].value_string = str.data();
+                json.nodes[index].size = str.size();
+                return index;
+            }
+            break;
 
-            bool first = 1;
-            while (1)
+          case '[': // array
             {
-                ParseSkipWhitespace(cur);
+                const char *begin = cur;
+                cur++; // Skip `[`.
 
-                if (*cur == ']')
-                    break;
+                std::size_t stack_pos = element_stack.size();
 
-                if (first)
+                bool first = 1;
+                while (1)
                 {
-                    first = 0;
-                }
-                else
-                {
-                    if (*cur != ',')
-                        Program::Error("Expected `,`.");
-                    cur++;
-                    ParseSkipWhitespace(cur);
+                    SkipWhitespace(cur);
 
                     if (*cur == ']')
                         break;
-                }
 
-                if (*cur == '\0')
-                {
-                    cur = begin; // We do this to get a better error message.
-                    Program::Error("This array lacks a terminating `]` character.");
-                }
+                    if (first)
+                    {
+                        first = 0;
+                    }
+                    else
+                    {
+                        if (*cur != ',')
+                            Program::Error("Expected `,`.");
+                        cur++;
+                        SkipWhitespace(cur);
 
-                vec.push_back(ParseLow(cur, allowed_depth-1));
-            }
+                        if (*cur == ']')
+                            break;
+                    }
 
-            cur++; // Skip `]`.
-            return FromVariant(std::move(vec));
-        }
-        break;
+                    if (*cur == '\0')
+                    {
+                        cur = (char *)begin; // We do this to get a better error message.
+                        Program::Error("This array lacks a terminating `]` character.");
+                    }
 
-      case '{': // object
-        {
-            const char *begin = cur;
-            cur++; // Skip `{`.
+                    int elem = ParseValue(cur, index, allowed_depth-1);
+                    element_stack.push_back(elem);
+                }
 
-            object_t map;
+                cur++; // Skip `]`.
 
-            bool first = 1;
-            while (1)
+                Node &node = json.nodes[index];
+                node.type = array;
+                node.first = json.elements.size();
+                node.size = element_stack.size() - stack_pos;
+                json.elements.insert(json.elements.end(), element_stack.begin() + stack_pos, element_stack.end());
+                element_stack.resize(stack_pos);
+                return index;
+            }
+            break;
+
+          case '{': // object
             {
-                ParseSkipWhitespace(cur);
+                const char *begin = cur;
+                cur++; // Skip `{`.
 
-                if (*cur == '}')
-                    break;
+                std::size_t stack_pos = member_stack.size();
 
-                if (first)
-                {
-                    first = 0;
-                }
-                else
+                bool first = 1;
+                while (1)
                 {
-                    if (*cur != ',')
-                        Program::Error("Expected `,`.");
-                    cur++;
-                    ParseSkipWhitespace(cur);
+                    SkipWhitespace(cur);
 
                     if (*cur == '}')
                         break;
-                }
 
-                if (*cur == '\0')
-                {
-                    cur = begin; // We do this to get a better error message.
-                    Program::Error("This array lacks a terminating `]` character.");
-                }
+                    if (first)
+                    {
+                        first = 0;
+                    }
+                    else
+                    {
+                        if (*cur != ',')
+                            Program::Error("Expected `,`.");
+                        cur++;
+                        SkipWhitespace(cur);
+
+                        if (*cur == '}')
+                            break;
+                    }
 
-                std::string name = ParseStringLow(cur);
+                    if (*cur == '\0')
+                    {
+                        cur = (char *)begin; // We do this to get a better error message.
+                        Program::Error("This object lacks a terminating `}` character.");
+                    }
 
-                ParseSkipWhitespace(cur);
+                    std::string_view name = ParseString(cur);
 
-                if (*cur != ':')
-                    Program::Error("Expected `:`.");
-                cur++;
+                    SkipWhitespace(cur);
 
-                // No need to skip whitespace here, nested ParseLow() will do that.
+                    if (*cur != ':')
+                        Program::Error("Expected `:`.");
+                    cur++;
 
-                map.insert({name, ParseLow(cur, allowed_depth-1)});
-            }
+                    // No need to skip whitespace here, nested ParseValue() will do that.
 
-            cur++; // Skip `}`.
-            return FromVariant(std::move(map));
+                    int elem = ParseValue(cur, index, allowed_depth-1);
+                    member_stack.push_back({name, elem});
+                }
+
+                cur++; // Skip `}`.
+
+                // Sort the members for the binary search. Stable sort and `std::unique()` keep the first of the duplicate members.
+                auto members_begin = member_stack.begin() + stack_pos;
+                std::stable_sort(members_begin, member_stack.end());
+                auto members_end = std::unique(members_begin, member_stack.end(), [](const Member &a, const Member &b){return a.name == b.name;});
+
+                Node &node = json.nodes[index];
+                node.type = object;
+                node.first = json.members.size();
+                node.size = members_end - members_begin;
+                json.members.insert(json.members.end(), members_begin, members_end);
+                member_stack.resize(stack_pos);
+                return index;
+            }
+            break;
         }
-        break;
+
+        Program::Error("Unknown entity.");
     }
+};
 
-    Program::Error("Unknown entity.");
-}
+Json::Json(const char *string, int allowed_depth) : Json(std::string_view(string), allowed_depth) {}
 
-Json::Json(const char *string, int allowed_depth)
+Json::Json(std::string_view string, int allowed_depth)
 {
-    const char *begin = string;
+    source = std::make_unique<char[]>(string.size() + 1);
+    std::memcpy(source.get(), string.data(), string.size());
+    source[string.size()] = '\0';
+
+    // A rough guess to avoid most reallocations.
+    nodes.reserve(string.size() / 8 + 1);
+
+    char *cur = source.get();
     try
     {
-        *this = ParseLow(string, allowed_depth);
-        ParseSkipWhitespace(string);
-        if (*string != '\0')
+        Parser parser{*this, {}, {}};
+        parser.ParseValue(cur, -1, allowed_depth);
+        Parser::SkipWhitespace(cur);
+        if (*cur != '\0')
             Program::Error("Unexpected data after JSON.");
     }
     catch (std::exception &e)
     {
-        auto pos = Strings::GetSymbolPosition(begin, string);
+        // Strings before `cur` could've been unescaped in place, so we compute the position in the original string.
+        auto pos = Strings::GetSymbolPosition(string.data(), string.data() + (cur - source.get()));
         Program::Error("JSON parsing failed, at ", pos.ToString(), ": ", e.what());
     }
 }
 
+const Json::Member *Json::View::FindMember(std::string_view key) const
+{
+    if (!IsObject())
+        ThrowExpectedType("an object");
+    const Node &obj = GetNode();
+    const Member *begin = ptr->members.data() + obj.first, *end = begin + obj.size;
+    const Member *it = std::lower_bound(begin, end, key);
+    if (it == end || it->name != key)
+        return 0;
+    return it;
+}
+
 void Json::View::DebugPrint(std::ostream &stream) const
 {
     switch (Type())
@@ -377,37 +436,37 @@ void Json::View::DebugPrint(std::ostream &stream) const
         stream << GetReal();
         break;
       case string:
-        stream << '"' << GetString() << '"';
+        stream << '"' << GetStringView() << '"';
         break;
       case array:
         {
-            const array_t &obj = *std::get_if<int(array)>(&ptr->variant);
             bool first = 1;
             stream << '[';
-            for (const auto &it : obj)
+            ForEachArrayElement([&](const View &elem)
             {
                 if (first)
                     first = 0;
                 else
                     stream << ',';
-                it.GetView().DebugPrint(stream);
-            }
+                elem.DebugPrint(stream);
+            });
             stream << ']';
         }
         break;
       case object:
         {
-            const object_t &obj = *std::get_if<int(object)>(&ptr->variant);
+            const Node &obj = GetNode();
             bool first = 1;
             stream << '{';
-            for (const auto &it : obj)
+            for (int i = 0; i < obj.size; i++)
             {
+                const Member &member = ptr->members[obj.first + i];
                 if (first)
                     first = 0;
                 else
                     stream << ',';
-                stream << "\"" << it.first << "\":";
-                it.second.GetView().DebugPrint(stream);
+                stream << "\"" << member.name << "\":";
+                View(ptr, member.node, root_name).DebugPrint(stream);
             }
             stream << '}';
         }
@@ -2,83 +2,138 @@
 
 #include <iosfwd>
 #include <exception>
-#include <map>
+#include <memory>
 #include <string>
-#include <variant>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 #include "program/errors.h"
 
+/* A parsed JSON document.
+ *
+ * All nodes are stored in a single flat array. Elements of arrays and members of objects are stored contiguously in separate arrays,
+ * so indexing is O(1), and member lookup is a binary search (members are sorted by name).
+ * The source is copied once, and strings are unescaped in place, so string values and member names are views into that copy.
+ */
+
 class Json
 {
   public:
-    // Sync order with `variant_t`.
     enum type_t {null, boolean, num_int, num_real, string, array, object};
 
   private:
-    using array_t = std::vector<Json>;
-    using object_t = std::map<std::string, Json>;
-
-    // Sync order with `enum type_t`.
-    using variant_t = std::variant<
-        std::monostate, // type_t::null
-        bool,           // type_t::boolean
-        int,            // type_t::num_int
-        double,         // type_t::num_real
-        std::string,    // type_t::string
-        array_t,        // type_t::array
-        object_t        // type_t::object
-    >;
-
-    variant_t variant;
-
-    static Json FromVariant(const variant_t &var)
+    struct Node
     {
-        Json ret;
-        ret.variant = var;
-        return ret;
-    }
+        type_t type = null;
+        int size = 0; // Length of a string, or the number of array elements or object members.
+        int parent = -1; // Used to build paths for error messages.
+        union
+        {
+            int first = 0; // Index of the first element in `elements` or `members`.
+            bool value_bool;
+            int value_int;
+            double value_real;
+            const char *value_string;
+        };
+    };
 
-    static void ParseSkipWhitespace(const char *&cur);
-    static std::string ParseStringLow(const char *&cur);
-    static Json ParseLow(const char *&cur, int allowed_depth);
+    struct Member
+    {
+        std::string_view name;
+        int node = 0;
+
+        // Used for binary search by name.
+        friend bool operator<(const Member &a, const Member &b) {return a.name < b.name;}
+        friend bool operator<(const Member &a, std::string_view b) {return a.name < b;}
+    };
+
+    std::unique_ptr<char[]> source; // Null-terminated. Strings point into it.
+    std::vector<Node> nodes; // The root is at index 0.
+    std::vector<int> elements; // Node indices of array elements.
+    std::vector<Member> members; // Object members, sorted by name in each object. Duplicate names are removed, the first one is kept.
+
+    struct Parser;
 
   public:
-    Json() {}
+    Json() : nodes(1) {}
     Json(const char *string, int allowed_depth);
+    Json(std::string_view string, int allowed_depth);
 
     class View
     {
         const Json *ptr = 0;
-        std::string path;
+        int node = 0;
+        std::string root_name;
 
-        void ThrowExpectedType(std::string type) const
+        // We don't store a path in each view, since building it for every element would be expensive. Instead we reconstruct it from the node parents.
+        std::string Path() const
         {
-            Program::Error("Expected JSON element `", path, "` to be ", type, ".");
+            std::vector<std::pair<bool, std::string>> segments; // `first` is true for array indices.
+            for (int index = node; ptr->nodes[index].parent != -1; index = ptr->nodes[index].parent)
+            {
+                const Node &parent = ptr->nodes[ptr->nodes[index].parent];
+                if (parent.type == array)
+                {
+                    for (int i = 0; i < parent.size; i++)
+                    {
+                        if (ptr->elements[parent.first + i] == index)
+                        {
+                            segments.push_back({true, std::to_string(i)});
+                            break;
+                        }
+                    }
+                }
+                else
+                {
+                    for (int i = 0; i < parent.size; i++)
+                    {
+                        const Member &member = ptr->members[parent.first + i];
+                        if (member.node == index)
+                        {
+                            segments.push_back({false, std::string(member.name)});
+                            break;
+                        }
+                    }
+                }
+            }
+
+            std::string ret = root_name;
+            for (auto it = segments.rbegin(); it != segments.rend(); it++)
+            {
+                if (it->first)
+                {
+                    ret += '[';
+                    ret += it->second;
+                    ret += ']';
+                }
+                else
+                {
+                    if (!ret.empty())
+                        ret += '.';
+                    ret += it->second;
+                }
+            }
+            return ret;
         }
 
-        std::string AppendElementIndexToPath(int index) const
+        void ThrowExpectedType(std::string type) const
         {
-            std::string ret = path;
-            ret += '[';
-            ret += std::to_string(index);
-            ret += ']';
-            return ret;
+            Program::Error("Expected JSON element `", Path(), "` to be ", type, ".");
         }
-        std::string AppendElementNameToPath(std::string name) const
+
+        const Node &GetNode() const
         {
-            if (path.empty())
-                return name;
-            std::string ret = path;
-            ret += '.';
-            ret += name;
-            return ret;
+            return ptr->nodes[node];
         }
+
+        View(const Json *ptr, int node, const std::string &root_name) : ptr(ptr), node(node), root_name(root_name) {}
+
       public:
         View() {}
 
         // Passed object has to remain alive.
-        View(const Json &json, std::string name = "") : ptr(&json), path(std::move(name)) {}
+        View(const Json &json, std::string name = "") : ptr(&json), root_name(std::move(name)) {}
         View(Json &&, std::string = "") = delete;
 
         explicit operator bool() const
@@ -86,14 +141,14 @@ class Json
             return bool(ptr);
         }
 
-        const Json &Target() const
+        const Json &Target() const // Returns the whole document.
         {
             return *ptr;
         }
 
         type_t Type() const
         {
-            return type_t(ptr->variant.index());
+            return GetNode().type;
         }
 
         bool IsNull()   const {return !ptr || Type() == null;}
@@ -108,13 +163,13 @@ class Json
         {
             if (!IsBool())
                 ThrowExpectedType("a boolean");
-            return *std::get_if<int(boolean)>(&ptr->variant);
+            return GetNode().value_bool;
         }
         int GetInt() const
         {
             if (!IsInt())
                 ThrowExpectedType("an integer");
-            return *std::get_if<int(num_int)>(&ptr->variant);
+            return GetNode().value_int;
         }
         double GetReal() const
         {
@@ -123,37 +178,41 @@ class Json
 
             if (!IsReal())
                 ThrowExpectedType("a real number");
-            return *std::get_if<int(num_real)>(&ptr->variant);
+            return GetNode().value_real;
         }
         std::string GetString() const
+        {
+            return std::string(GetStringView());
+        }
+        std::string_view GetStringView() const // The view remains valid as long as the document is alive.
         {
             if (!IsString())
                 ThrowExpectedType("a string");
-            return *std::get_if<int(string)>(&ptr->variant);
+            return std::string_view(GetNode().value_string, GetNode().size);
         }
 
         int GetArraySize() const
         {
             if (!IsArray())
                 ThrowExpectedType("an array");
-            return std::get_if<int(array)>(&ptr->variant)->size();
+            return GetNode().size;
         }
         View GetElement(int index) const
         {
             if (!IsArray())
                 ThrowExpectedType("an array");
-            const array_t &arr = *std::get_if<int(array)>(&ptr->variant);
-            if (index < 0 || decltype(arr.size())(index) >= arr.size())
-                Program::Error("Attempt to access element #", index, " of JSON object `", path, "`, but it only contains ", arr.size(), " elements.");
-            return View(arr[index], AppendElementIndexToPath(index));
+            const Node &arr = GetNode();
+            if (index < 0 || index >= arr.size)
+                Program::Error("Attempt to access element #", index, " of JSON object `", Path(), "`, but it only contains ", arr.size, " elements.");
+            return View(ptr, ptr->elements[arr.first + index], root_name);
         }
         template <typename F> void ForEachArrayElement(F &&func) const // `func` should be `void func(const View &elem)`.
         {
             if (!IsArray())
                 ThrowExpectedType("an array");
-            const array_t &arr = *std::get_if<int(array)>(&ptr->variant);
-            for (array_t::size_type i = 0; i < arr.size(); i++)
-                func(View(arr[i], AppendElementIndexToPath(i)));
+            const Node &arr = GetNode();
+            for (int i = 0; i < arr.size; i++)
+                func(View(ptr, ptr->elements[arr.first + i], root_name));
         }
         bool HasElement(int index) const
         {
@@ -164,33 +223,29 @@ class Json
         {
             if (!IsObject())
                 ThrowExpectedType("an object");
-            return std::get_if<int(object)>(&ptr->variant)->size();
+            return GetNode().size;
         }
-        View GetElement(std::string key) const
+        View GetElement(std::string_view key) const
         {
-            if (!IsObject())
-                ThrowExpectedType("an object");
-            const object_t &obj = *std::get_if<int(object)>(&ptr->variant);
-            auto it = obj.find(key);
-            if (it == obj.end())
-                Program::Error("Attempt to access nonexistent element `", key, "` of JSON object `", path, "`.");
-            return View(it->second, AppendElementNameToPath(key));
+            const Member *member = FindMember(key);
+            if (!member)
+                Program::Error("Attempt to access nonexistent element `", key, "` of JSON object `", Path(), "`.");
+            return View(ptr, member->node, root_name);
         }
-        template <typename F> void ForEachObjectElement(F &&func) const // `func` should be `void func(const std::string &name, const View &elem)`.
+        template <typename F> void ForEachObjectElement(F &&func) const // `func` should be `void func(std::string_view name, const View &elem)`. Elements are sorted by name.
         {
             if (!IsObject())
                 ThrowExpectedType("an object");
-            const object_t &obj = *std::get_if<int(object)>(&ptr->variant);
-            for (const auto &elem : obj)
-                func(View(elem.second, AppendElementNameToPath(elem.first)));
+            const Node &obj = GetNode();
+            for (int i = 0; i < obj.size; i++)
+            {
+                const Member &member = ptr->members[obj.first + i];
+                func(member.name, View(ptr, member.node, root_name));
+            }
         }
-        bool HasElement(std::string key) const
+        bool HasElement(std::string_view key) const
         {
-            if (!IsObject())
-                ThrowExpectedType("an object");
-            const object_t &obj = *std::get_if<int(object)>(&ptr->variant);
-            auto it = obj.find(key);
-            return it != obj.end();
+            return bool(FindMember(key));
         }
 
         View operator[](int index) const // Same as GetElement(int).
@@ -198,12 +253,16 @@ class Json
             return GetElement(index);
         }
 
-        View operator[](std::string key) const // Same as GetElement(std::string).
+        View operator[](std::string_view key) const // Same as GetElement(std::string_view).
         {
             return GetElement(key);
         }
 
         void DebugPrint(std::ostream &stream) const;
+
+      private:
+        // Returns null if there is no such member.
+        const Member *FindMember(std::string_view key) const;
     };
 
     View GetView() const
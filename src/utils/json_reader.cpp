@@ -0,0 +1,501 @@
+#include "json_reader.h"
+
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <istream>
+
+#include "utils/strings.h"
+
+JsonReader::JsonReader(ReadFunc read_func, std::size_t chunk_size, int allowed_depth, const char *begin, const char *end)
+    : read_func(std::move(read_func)), allowed_depth(allowed_depth)
+{
+    if (this->read_func)
+    {
+        if (chunk_size == 0)
+            Program::Error("Invalid JSON reader chunk size.");
+        buffer = std::make_unique<char[]>(chunk_size);
+        buffer_size = chunk_size;
+        chunk_begin = cur = end_ptr = buffer.get();
+    }
+    else
+    {
+        chunk_begin = cur = begin;
+        end_ptr = end;
+        eof = true;
+    }
+}
+
+JsonReader JsonReader::FromMemoryFile(const MemoryFile &file, int allowed_depth)
+{
+    std::string_view text((const char *)file.data(), file.size());
+    // Files loaded from disk have a null-terminator at the end.
+    if (text.size() > 0 && text.back() == '\0')
+        text.remove_suffix(1);
+    return FromString(text, allowed_depth);
+}
+
+JsonReader JsonReader::FromStream(std::istream &stream, int allowed_depth, std::size_t chunk_size)
+{
+    return JsonReader([&stream](char *buffer, std::size_t size) -> std::size_t
+    {
+        stream.read(buffer, size);
+        return stream.gcount();
+    }, allowed_depth, chunk_size);
+}
+
+JsonReader JsonReader::FromFile(std::string file_name, int allowed_depth, std::size_t chunk_size)
+{
+    std::shared_ptr<FILE> file(std::fopen(file_name.c_str(), "rb"), [](FILE *file){if (file) std::fclose(file);});
+    if (!file)
+        Program::Error("Unable to open file `", file_name, "`.");
+
+    return JsonReader([file, file_name = std::move(file_name)](char *buffer, std::size_t size) -> std::size_t
+    {
+        std::size_t ret = std::fread(buffer, 1, size, file.get());
+        if (ret == 0 && std::ferror(file.get()))
+            Program::Error("Unable to read from file `", file_name, "`.");
+        return ret;
+    }, allowed_depth, chunk_size);
+}
+
+const char *JsonReader::TokenName(token_t token)
+{
+    static constexpr const char *token_names[] = {"null", "a boolean", "an integer", "a real number", "a string", "`[`", "`]`", "`{`", "`}`", "a key", "the end of input"};
+    return token_names[token];
+}
+
+void JsonReader::ThrowError(std::string message) const
+{
+    Program::Error("JSON parsing failed, at byte ", Offset(), ": ", message);
+}
+
+void JsonReader::ThrowExpectedToken(std::string_view what) const
+{
+    ThrowError(Str("Expected ", what, ", but got ", TokenName(token), "."));
+}
+
+bool JsonReader::Refill()
+{
+    if (!read_func || eof)
+        return false;
+
+    // The last key can be in the buffer while we look for `:`, so we preserve it.
+    if (value_string.data() >= buffer.get() && value_string.data() < buffer.get() + buffer_size)
+    {
+        string_storage = value_string;
+        value_string = string_storage;
+    }
+
+    consumed += end_ptr - chunk_begin;
+    std::size_t size = read_func(buffer.get(), buffer_size);
+    chunk_begin = cur = end_ptr = buffer.get();
+    if (size == 0)
+    {
+        eof = true;
+        return false;
+    }
+    end_ptr += size;
+    return true;
+}
+
+int JsonReader::SkipWhitespaceAndPeek()
+{
+    while (1)
+    {
+        while (cur != end_ptr)
+        {
+            if (*cur <= '\0' || *cur > ' ')
+                return (unsigned char)*cur;
+            cur++;
+        }
+        if (!Refill())
+            return -1;
+    }
+}
+
+void JsonReader::ParseLiteral(std::string_view literal)
+{
+    for (char ch : literal)
+    {
+        if (PeekChar() != (unsigned char)ch)
+            ThrowError("Unknown entity.");
+        cur++;
+    }
+}
+
+void JsonReader::ParseNumber()
+{
+    string_storage.clear();
+    bool real = 0;
+
+    auto IsDigit = [&]{int ch = PeekChar(); return ch >= '0' && ch <= '9';};
+    auto ReadDigits = [&]
+    {
+        while (IsDigit())
+            string_storage += *cur++;
+    };
+
+    if (PeekChar() == '-')
+        string_storage += *cur++;
+
+    if (!IsDigit())
+        ThrowError("Unknown entity.");
+    ReadDigits();
+
+    if (PeekChar() == '.')
+    {
+        string_storage += *cur++;
+        real = 1;
+        if (!IsDigit())
+            ThrowError("Expected a digit after decimal point.");
+        ReadDigits();
+    }
+
+    if (PeekChar() == 'e' || PeekChar() == 'E')
+    {
+        string_storage += *cur++;
+        real = 1;
+        if (PeekChar() == '+' || PeekChar() == '-')
+            string_storage += *cur++;
+        if (!IsDigit())
+            ThrowError("Expected a digit after `e`, possibly after a sign.");
+        ReadDigits();
+    }
+
+    const char *begin = string_storage.data(), *end = begin + string_storage.size();
+    if (real)
+    {
+        token = num_real;
+        // Out of range doubles are not an error, same as in `Json`.
+        if (std::from_chars(begin, end, value_real).ec == std::errc::result_out_of_range)
+            value_real = std::strtod(begin, 0);
+    }
+    else
+    {
+        token = num_int;
+        if (std::from_chars(begin, end, value_int).ec != std::errc{})
+            ThrowError("Overflow in integral constant.");
+    }
+}
+
+void JsonReader::ParseString()
+{
+    // If the string has no escapes and doesn't cross a chunk boundary, we return a view into the buffer.
+    const char *begin = cur;
+    for (const char *ptr = cur; ptr != end_ptr; ptr++)
+    {
+        if (*ptr == '"')
+        {
+            value_string = std::string_view(begin, ptr - begin);
+            cur = ptr + 1;
+            return;
+        }
+        if (*ptr == '\\' || (unsigned char)*ptr < ' ')
+            break;
+    }
+
+    // Otherwise we copy it to the storage.
+    string_storage.clear();
+    while (1)
+    {
+        const char *run_begin = cur;
+        while (cur != end_ptr && *cur != '"' && *cur != '\\' && (unsigned char)*cur >= ' ')
+            cur++;
+        string_storage.append(run_begin, cur);
+
+        int ch = PeekChar();
+        if (ch == -1)
+            ThrowError("This string lacks a terminating `\"` character.");
+
+        if (ch != '"' && ch != '\\' && ch >= ' ')
+            continue; // We've reached the end of the chunk, and the next one was loaded.
+        cur++;
+
+        if (ch == '"')
+            break;
+
+        if (ch < ' ')
+            ThrowError(Str("Invalid character in a string: 0x", std::hex, std::setfill('0'), std::setw(2), ch, "."));
+
+        // Otherwise it's a backslash.
+        ch = PeekChar();
+        if (ch == -1)
+            ThrowError("This string lacks a terminating `\"` character.");
+        cur++;
+        switch (ch)
+        {
+          case '\\':
+          case '/':
+          case '"':
+            string_storage += char(ch);
+            break;
+          case 'b':
+            string_storage += '\b';
+            break;
+          case 'f':
+            string_storage += '\f';
+            break;
+          case 'n':
+            string_storage += '\n';
+            break;
+          case 'r':
+            string_storage += '\r';
+            break;
+          case 't':
+            string_storage += '\t';
+            break;
+          case 'u':
+            {
+                int value = 0;
+                for (int i = 0; i < 4; i++)
+                {
+                    int digit = PeekChar();
+                    if (digit >= '0' && digit <= '9')
+                        digit -= '0';
+                    else if (digit >= 'a' && digit <= 'f')
+                        digit -= 'a' - 10;
+                    else if (digit >= 'A' && digit <= 'F')
+                        digit -= 'A' - 10;
+                    else
+                        ThrowError("Expected four hex digits after `\\u`.");
+                    cur++;
+                    value = value * 16 + digit;
+                }
+                if (value < 128)
+                {
+                    string_storage += char(value);
+                }
+                else if (value < 2048) // 2048 = 2^11
+                {
+                    string_storage += char(0b1100'0000 + (value >> 6));
+                    string_storage += char(0b1000'0000 + (value & 0b0011'1111));
+                }
+                else
+                {
+                    string_storage += char(0b1110'0000 + (value >> 12));
+                    string_storage += char(0b1000'0000 + ((value >> 6) & 0b0011'1111));
+                    string_storage += char(0b1000'0000 + (value & 0b0011'1111));
+                }
+            }
+            break;
+          default:
+            ThrowError("Invalid escape sequence.");
+            break;
+        }
+    }
+
+    value_string = string_storage;
+}
+
+JsonReader::token_t JsonReader::ParseValue()
+{
+    if (int(containers.size()) > allowed_depth)
+        ThrowError("Too many nested elements.");
+
+    int ch = SkipWhitespaceAndPeek();
+    switch (ch)
+    {
+      case -1:
+        ThrowError("Unexpected end of input.");
+        break;
+      case '[':
+      case '{':
+        cur++;
+        containers.push_back(ch);
+        state = ch == '[' ? state_array_first : state_object_first;
+        return token = (ch == '[' ? begin_array : begin_object);
+      case '"':
+        cur++;
+        ParseString();
+        token = string;
+        break;
+      case 'n':
+        ParseLiteral("null");
+        token = null;
+        break;
+      case 't':
+        ParseLiteral("true");
+        token = boolean;
+        value_bool = true;
+        break;
+      case 'f':
+        ParseLiteral("false");
+        token = boolean;
+        value_bool = false;
+        break;
+      default:
+        ParseNumber();
+        break;
+    }
+
+    state = containers.empty() ? state_done : state_after_value;
+    return token;
+}
+
+JsonReader::token_t JsonReader::Next()
+{
+    value_string = {};
+
+    // Closes the current container, if `ch` is its closing bracket.
+    auto TryClose = [&](int ch) -> bool
+    {
+        if (containers.empty() || ch != (containers.back() == '[' ? ']' : '}'))
+            return false;
+        cur++;
+        token = containers.back() == '[' ? end_array : end_object;
+        containers.pop_back();
+        state = containers.empty() ? state_done : state_after_value;
+        return true;
+    };
+
+    auto ParseKey = [&]
+    {
+        if (SkipWhitespaceAndPeek() != '"')
+            ThrowError("Expected `\"`.");
+        cur++;
+        ParseString();
+        if (SkipWhitespaceAndPeek() != ':')
+            ThrowError("Expected `:`.");
+        cur++;
+        token = key;
+        state = state_value;
+    };
+
+    switch (state)
+    {
+      case state_value:
+        return ParseValue();
+
+      case state_array_first:
+      case state_object_first:
+        if (TryClose(SkipWhitespaceAndPeek()))
+            return token;
+        if (state == state_array_first)
+            return ParseValue();
+        ParseKey();
+        return token;
+
+      case state_after_value:
+        {
+            int ch = SkipWhitespaceAndPeek();
+            if (TryClose(ch))
+                return token;
+            if (ch == -1)
+                ThrowError(containers.back() == '[' ? "This array lacks a terminating `]` character." : "This object lacks a terminating `}` character.");
+            if (ch != ',')
+                ThrowError("Expected `,`.");
+            cur++;
+
+            if (TryClose(SkipWhitespaceAndPeek())) // Trailing commas are allowed, same as in `Json`.
+                return token;
+            if (containers.back() == '[')
+                return ParseValue();
+            ParseKey();
+            return token;
+        }
+
+      case state_done:
+        if (SkipWhitespaceAndPeek() != -1)
+            ThrowError("Unexpected data after JSON.");
+        token = end;
+        return token;
+    }
+
+    return token; // Unreachable.
+}
+
+void JsonReader::Expect(token_t expected_token)
+{
+    Next();
+    CheckToken(expected_token);
+}
+
+void JsonReader::CheckToken(token_t expected_token) const
+{
+    if (token != expected_token && !(expected_token == num_real && token == num_int))
+        ThrowExpectedToken(TokenName(expected_token));
+}
+
+void JsonReader::SkipValue()
+{
+    switch (Next())
+    {
+      case begin_array:
+      case begin_object:
+        SkipContainer();
+        break;
+      case end_array:
+      case end_object:
+      case key:
+      case end:
+        ThrowExpectedToken("a value");
+        break;
+      default:
+        break;
+    }
+}
+
+void JsonReader::SkipContainer()
+{
+    if (containers.empty())
+        ThrowError("Attempt to skip a container when not in one.");
+
+    // We only track the nesting depth and strings, which is enough to find the matching bracket.
+    int depth = 1;
+    bool in_string = false;
+    bool escape = false;
+    while (1)
+    {
+        if (cur == end_ptr && !Refill())
+            ThrowError(containers.back() == '[' ? "This array lacks a terminating `]` character." : "This object lacks a terminating `}` character.");
+
+        const char *ptr = cur;
+        if (in_string)
+        {
+            for (; ptr != end_ptr; ptr++)
+            {
+                if (escape)
+                    escape = false;
+                else if (*ptr == '\\')
+                    escape = true;
+                else if (*ptr == '"')
+                    break;
+            }
+            if (ptr != end_ptr)
+            {
+                in_string = false;
+                ptr++;
+            }
+        }
+        else
+        {
+            for (; ptr != end_ptr; ptr++)
+            {
+                char ch = *ptr;
+                if (ch == '"')
+                {
+                    in_string = true;
+                    ptr++;
+                    break;
+                }
+                if (ch == '[' || ch == '{')
+                {
+                    depth++;
+                }
+                else if (ch == ']' || ch == '}')
+                {
+                    if (--depth == 0)
+                    {
+                        cur = ptr + 1;
+                        token = containers.back() == '[' ? end_array : end_object;
+                        containers.pop_back();
+                        state = containers.empty() ? state_done : state_after_value;
+                        return;
+                    }
+                }
+            }
+        }
+        cur = ptr;
+    }
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "program/errors.h"
+#include "utils/memory_file.h"
+
+/* A pull parser for JSON. Unlike `Json`, it doesn't build a document, and it can read the input in chunks,
+ * so the memory usage doesn't depend on the input size (only on the nesting depth and the longest string).
+ *
+ * Example usage:
+ *
+ *     JsonReader reader = JsonReader::FromFile("map.json");
+ *     reader.Expect(JsonReader::begin_object);
+ *     while (reader.Next() == JsonReader::key)
+ *     {
+ *         if (reader.GetStringView() == "width")
+ *             width = reader.ReadInt();
+ *         else
+ *             reader.SkipValue();
+ *     }
+ *
+ * Strings returned by `GetStringView()` remain valid until the next call that advances the reader.
+ * The syntax is the same as accepted by `Json`, except `SkipValue()` doesn't validate the contents of the skipped containers.
+ */
+
+class JsonReader
+{
+  public:
+    enum token_t {null, boolean, num_int, num_real, string, begin_array, end_array, begin_object, end_object, key, end};
+
+    using ReadFunc = std::function<std::size_t(char *buffer, std::size_t size)>; // Should return the number of bytes read. 0 means the end of input.
+
+    static constexpr std::size_t default_chunk_size = 1 << 16;
+
+  private:
+    enum state_t
+    {
+        state_value,        // At the beginning, or after a key.
+        state_array_first,  // After `[`.
+        state_object_first, // After `{`.
+        state_after_value,  // Expecting `,` or the end of the current container.
+        state_done,         // After the top-level value.
+    };
+
+    ReadFunc read_func;
+    std::unique_ptr<char[]> buffer;
+    std::size_t buffer_size = 0;
+    const char *chunk_begin = 0, *cur = 0, *end_ptr = 0;
+    std::size_t consumed = 0; // Bytes before `chunk_begin`, for error messages.
+    bool eof = false;
+
+    int allowed_depth = 0;
+    std::vector<char> containers; // `[` or `{` for each open container.
+    state_t state = state_value;
+
+    token_t token = end;
+    bool value_bool = false;
+    int value_int = 0;
+    double value_real = 0;
+    std::string_view value_string;
+    std::string string_storage; // Holds strings that cross chunk boundaries or contain escapes.
+
+    JsonReader(ReadFunc read_func, std::size_t chunk_size, int allowed_depth, const char *begin, const char *end);
+
+    static const char *TokenName(token_t token);
+    [[noreturn]] void ThrowError(std::string message) const;
+    [[noreturn]] void ThrowExpectedToken(std::string_view what) const;
+
+    bool Refill(); // Returns false if there's no more data.
+    int PeekChar() // Returns -1 at the end of input.
+    {
+        if (cur == end_ptr && !Refill())
+            return -1;
+        return (unsigned char)*cur;
+    }
+    int SkipWhitespaceAndPeek();
+
+    void ParseLiteral(std::string_view literal);
+    void ParseNumber();
+    void ParseString(); // Expects the opening `"` to be already consumed.
+    token_t ParseValue();
+
+  public:
+    JsonReader() {}
+
+    // Reads from a chunked source.
+    JsonReader(ReadFunc read_func, int allowed_depth = 64, std::size_t chunk_size = default_chunk_size)
+        : JsonReader(std::move(read_func), chunk_size, allowed_depth, nullptr, nullptr) {}
+
+    // Reads from memory. The string has to remain alive. It doesn't have to be null-terminated.
+    [[nodiscard]] static JsonReader FromString(std::string_view text, int allowed_depth = 64)
+    {
+        return JsonReader(nullptr, 0, allowed_depth, text.data(), text.data() + text.size());
+    }
+    // Reads from memory. The file has to remain alive.
+    [[nodiscard]] static JsonReader FromMemoryFile(const MemoryFile &file, int allowed_depth = 64);
+    // Reads from a stream. The stream has to remain alive.
+    [[nodiscard]] static JsonReader FromStream(std::istream &stream, int allowed_depth = 64, std::size_t chunk_size = default_chunk_size);
+    // Reads a file chunk by chunk, without loading it into memory at once.
+    [[nodiscard]] static JsonReader FromFile(std::string file_name, int allowed_depth = 64, std::size_t chunk_size = default_chunk_size);
+
+    JsonReader(JsonReader &&) = default;
+    JsonReader &operator=(JsonReader &&) = default;
+
+    // Advances to the next token and returns it. After the top-level value, returns `end`.
+    token_t Next();
+
+    // Calls `Next()` and throws if it returns a different token.
+    void Expect(token_t expected_token);
+    // Throws if the current token is different. `num_real` also accepts `num_int`.
+    void CheckToken(token_t expected_token) const;
+
+    // Skips the next value. If it's a container, its contents are skipped quickly, without full validation.
+    void SkipValue();
+    // Skips the rest of the current container, including its closing bracket.
+    void SkipContainer();
+
+    [[nodiscard]] token_t Token() const {return token;}
+    [[nodiscard]] int Depth() const {return containers.size();}
+    [[nodiscard]] std::size_t Offset() const {return consumed + (cur - chunk_begin);} // Bytes consumed so far.
+
+    [[nodiscard]] bool GetBool() const
+    {
+        if (token != boolean)
+            ThrowExpectedToken("a boolean");
+        return value_bool;
+    }
+    [[nodiscard]] int GetInt() const
+    {
+        if (token != num_int)
+            ThrowExpectedToken("an integer");
+        return value_int;
+    }
+    [[nodiscard]] double GetReal() const
+    {
+        if (token == num_int)
+            return value_int;
+        if (token != num_real)
+            ThrowExpectedToken("a real number");
+        return value_real;
+    }
+    [[nodiscard]] std::string_view GetStringView() const // Works for strings and keys.
+    {
+        if (token != string && token != key)
+            ThrowExpectedToken("a string");
+        return value_string;
+    }
+    [[nodiscard]] std::string GetString() const
+    {
+        return std::string(GetStringView());
+    }
+
+    // Those call `Next()` and then the corresponding getter.
+    bool ReadBool() {Next(); return GetBool();}
+    int ReadInt() {Next(); return GetInt();}
+    double ReadReal() {Next(); return GetReal();}
+    std::string_view ReadStringView() {Next(); return GetStringView();}
+    std::string ReadString() {Next(); return GetString();}
+};
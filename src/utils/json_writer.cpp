@@ -0,0 +1,317 @@
+#include "json_writer.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <exception>
+
+#if defined(__SSE2__)
+#define JSON_WRITER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // Returns true if the character has to be escaped in a JSON string.
+    [[nodiscard]] inline bool NeedsEscaping(char ch)
+    {
+        return (unsigned char)ch < ' ' || ch == '"' || ch == '\\';
+    }
+
+    // Returns the length of the prefix that doesn't need escaping.
+    [[nodiscard]] std::size_t SafePrefixLength(const char *data, std::size_t size)
+    {
+        std::size_t i = 0;
+
+        #ifdef JSON_WRITER_SSE2
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        for (; i + 16 <= size; i += 16)
+        {
+            __m128i chunk = _mm_loadu_si128((const __m128i *)(data + i));
+            // Unsigned `ch < ' '` is the same as `min(ch, ' ' - 1) == ch`.
+            __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(chunk, _mm_set1_epi8(' ' - 1)), chunk);
+            __m128i mask = _mm_or_si128(control, _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)));
+            int bits = _mm_movemask_epi8(mask);
+            if (bits)
+                return i + __builtin_ctz(bits);
+        }
+        #endif
+
+        for (; i < size; i++)
+        {
+            if (NeedsEscaping(data[i]))
+                return i;
+        }
+        return size;
+    }
+}
+
+JsonWriter JsonWriter::ToFile(std::string file_name, int indent, std::size_t flush_size)
+{
+    JsonWriter ret(indent);
+    ret.file = std::shared_ptr<FILE>(std::fopen(file_name.c_str(), "wb"), [](FILE *file){if (file) std::fclose(file);});
+    if (!ret.file)
+        Program::Error("Unable to open file `", file_name, "` for writing.");
+    ret.file_name = std::move(file_name);
+    ret.flush_size = flush_size;
+    ret.buffer.reserve(flush_size + 256);
+    return ret;
+}
+
+JsonWriter::~JsonWriter()
+{
+    // We can't throw from a destructor, so write errors are ignored here. Call `Finish()` to detect them.
+    if (file && std::uncaught_exceptions() == 0)
+    {
+        std::fwrite(buffer.data(), 1, buffer.size(), file.get());
+    }
+}
+
+void JsonWriter::NewLine()
+{
+    buffer += '\n';
+    buffer.append(containers.size() * indent, ' ');
+}
+
+void JsonWriter::BeginValue()
+{
+    if (expecting_value)
+    {
+        expecting_value = false;
+        return;
+    }
+
+    if (containers.empty())
+    {
+        if (wrote_top_level_value)
+            Program::Error("Attempt to write more than one top-level JSON value.");
+        wrote_top_level_value = true;
+        return;
+    }
+
+    Container &container = containers.back();
+    if (container.is_object)
+        Program::Error("Expected a JSON key before a value.");
+    if (!container.empty)
+        buffer += ',';
+    container.empty = false;
+    if (indent > 0)
+        NewLine();
+}
+
+void JsonWriter::EndValue()
+{
+    if (file && buffer.size() >= flush_size)
+        Flush();
+}
+
+void JsonWriter::BeginArray()
+{
+    BeginValue();
+    buffer += '[';
+    containers.push_back({false, true});
+}
+
+void JsonWriter::EndArray()
+{
+    if (containers.empty() || containers.back().is_object || expecting_value)
+        Program::Error("Unexpected end of a JSON array.");
+    bool empty = containers.back().empty;
+    containers.pop_back();
+    if (indent > 0 && !empty)
+        NewLine();
+    buffer += ']';
+    EndValue();
+}
+
+void JsonWriter::BeginObject()
+{
+    BeginValue();
+    buffer += '{';
+    containers.push_back({true, true});
+}
+
+void JsonWriter::EndObject()
+{
+    if (containers.empty() || !containers.back().is_object || expecting_value)
+        Program::Error("Unexpected end of a JSON object.");
+    bool empty = containers.back().empty;
+    containers.pop_back();
+    if (indent > 0 && !empty)
+        NewLine();
+    buffer += '}';
+    EndValue();
+}
+
+void JsonWriter::Key(std::string_view name)
+{
+    if (containers.empty() || !containers.back().is_object || expecting_value)
+        Program::Error("Unexpected JSON key `", name, "`.");
+
+    Container &container = containers.back();
+    if (!container.empty)
+        buffer += ',';
+    container.empty = false;
+    if (indent > 0)
+        NewLine();
+
+    WriteEscapedString(name);
+    buffer += ':';
+    if (indent > 0)
+        buffer += ' ';
+    expecting_value = true;
+}
+
+void JsonWriter::Null()
+{
+    BeginValue();
+    buffer += "null";
+    EndValue();
+}
+
+void JsonWriter::Bool(bool value)
+{
+    BeginValue();
+    buffer += value ? "true" : "false";
+    EndValue();
+}
+
+void JsonWriter::Int(long long value)
+{
+    BeginValue();
+    char str[24];
+    buffer.append(str, std::to_chars(str, str + sizeof str, value).ptr);
+    EndValue();
+}
+
+void JsonWriter::Real(double value)
+{
+    if (!std::isfinite(value))
+    {
+        Null();
+        return;
+    }
+
+    BeginValue();
+    char str[32];
+    char *end = std::to_chars(str, str + sizeof str, value).ptr; // The shortest representation that round-trips.
+    buffer.append(str, end);
+    if (std::find_if(str, end, [](char ch){return ch == '.' || ch == 'e';}) == end)
+        buffer += ".0"; // Otherwise whole numbers would be read back as integers.
+    EndValue();
+}
+
+void JsonWriter::String(std::string_view value)
+{
+    BeginValue();
+    WriteEscapedString(value);
+    EndValue();
+}
+
+void JsonWriter::Value(const Json::View &value)
+{
+    switch (value.Type())
+    {
+      case Json::null:
+        Null();
+        break;
+      case Json::boolean:
+        Bool(value.GetBool());
+        break;
+      case Json::num_int:
+        Int(value.GetInt());
+        break;
+      case Json::num_real:
+        Real(value.GetReal());
+        break;
+      case Json::string:
+        String(value.GetStringView());
+        break;
+      case Json::array:
+        BeginArray();
+        value.ForEachArrayElement([&](const Json::View &elem)
+        {
+            Value(elem);
+        });
+        EndArray();
+        break;
+      case Json::object:
+        BeginObject();
+        value.ForEachObjectElement([&](std::string_view name, const Json::View &elem)
+        {
+            Key(name);
+            Value(elem);
+        });
+        EndObject();
+        break;
+    }
+}
+
+void JsonWriter::WriteEscapedString(std::string_view str)
+{
+    buffer += '"';
+    while (1)
+    {
+        std::size_t len = SafePrefixLength(str.data(), str.size());
+        buffer.append(str.data(), len);
+        if (len == str.size())
+            break;
+
+        char ch = str[len];
+        str.remove_prefix(len + 1);
+        switch (ch)
+        {
+          case '"':
+            buffer += "\\\"";
+            break;
+          case '\\':
+            buffer += "\\\\";
+            break;
+          case '\b':
+            buffer += "\\b";
+            break;
+          case '\f':
+            buffer += "\\f";
+            break;
+          case '\n':
+            buffer += "\\n";
+            break;
+          case '\r':
+            buffer += "\\r";
+            break;
+          case '\t':
+            buffer += "\\t";
+            break;
+          default:
+            {
+                static constexpr char hex_digits[] = "0123456789abcdef";
+                buffer += "\\u00";
+                buffer += hex_digits[(unsigned char)ch >> 4];
+                buffer += hex_digits[(unsigned char)ch & 15];
+            }
+            break;
+        }
+    }
+    buffer += '"';
+}
+
+void JsonWriter::Flush()
+{
+    if (!file || buffer.empty())
+        return;
+    if (std::fwrite(buffer.data(), 1, buffer.size(), file.get()) != buffer.size())
+        Program::Error("Unable to write to file `", file_name, "`.");
+    buffer.clear();
+}
+
+void JsonWriter::Finish()
+{
+    if (!containers.empty() || expecting_value)
+        Program::Error("Attempt to finish writing JSON with unclosed containers.");
+    if (indent > 0)
+        buffer += '\n';
+    Flush();
+    if (file && std::fflush(file.get()) != 0)
+        Program::Error("Unable to write to file `", file_name, "`.");
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "program/errors.h"
+#include "utils/json.h"
+
+/* Writes JSON into a memory buffer or a file.
+ *
+ * Example usage:
+ *
+ *     JsonWriter writer(4); // Pretty printing with 4-space indentation. 0 means compact output.
+ *     writer.BeginObject();
+ *     writer.Key("runs");
+ *     writer.BeginArray();
+ *     writer.Int(42);
+ *     writer.EndArray();
+ *     writer.EndObject();
+ *     std::string result = writer.TakeBuffer();
+ *
+ * When writing to a file, the buffer is flushed to the file whenever it gets large, and when `Finish()` is called (or when the writer is destroyed).
+ * Incorrect call sequences (such as a value where a key is expected) throw.
+ */
+
+class JsonWriter
+{
+  public:
+    static constexpr std::size_t default_flush_size = 1 << 16;
+
+  private:
+    struct Container
+    {
+        bool is_object = false;
+        bool empty = true;
+    };
+
+    std::string buffer;
+    std::vector<Container> containers;
+    int indent = 0;
+    bool expecting_value = false; // After a key.
+    bool wrote_top_level_value = false;
+
+    std::shared_ptr<FILE> file; // Null if we're writing to memory.
+    std::string file_name;
+    std::size_t flush_size = default_flush_size;
+
+    void NewLine();
+    void BeginValue(); // Writes a separator and indentation if needed.
+    void EndValue(); // Flushes the buffer if needed.
+    void WriteEscapedString(std::string_view str);
+
+  public:
+    JsonWriter(int indent = 0) : indent(indent) {}
+
+    [[nodiscard]] static JsonWriter ToFile(std::string file_name, int indent = 0, std::size_t flush_size = default_flush_size);
+
+    JsonWriter(JsonWriter &&) = default;
+    JsonWriter &operator=(JsonWriter &&) = default;
+
+    ~JsonWriter();
+
+    void BeginArray();
+    void EndArray();
+    void BeginObject();
+    void EndObject();
+    void Key(std::string_view name);
+
+    void Null();
+    void Bool(bool value);
+    void Int(long long value);
+    void Real(double value); // Infinities and NaNs are written as `null`, since JSON doesn't support them.
+    void String(std::string_view value);
+    void Value(const Json::View &value); // Writes a parsed element, recursively.
+
+    // Returns the written data. Only useful when writing to memory.
+    [[nodiscard]] const std::string &Buffer() const
+    {
+        return buffer;
+    }
+    [[nodiscard]] std::string TakeBuffer()
+    {
+        std::string ret = std::move(buffer);
+        buffer = {};
+        return ret;
+    }
+
+    // Writes the buffered data to the file. Does nothing when writing to memory.
+    void Flush();
+    // Checks that all containers were closed, and flushes the buffer. Throws on failure.
+    void Finish();
+};
@@ -29,11 +29,11 @@ namespace Memory
         std::memcpy(ptr, &object, sizeof(T));
         ByteOrder::ConvertBytes(ptr, sizeof(T), order);
     }
-    template <typename T> void WriteLittle(const uint8_t *ptr, const std::enable_if_t<1, T> &object)
+    template <typename T> void WriteLittle(uint8_t *ptr, const std::enable_if_t<1, T> &object)
     {
         Write<T>(ptr, object, ByteOrder::little);
     }
-    template <typename T> void WriteBig(const uint8_t *ptr, const std::enable_if_t<1, T> &object)
+    template <typename T> void WriteBig(uint8_t *ptr, const std::enable_if_t<1, T> &object)
     {
         Write<T>(ptr, object, ByteOrder::big);
     }
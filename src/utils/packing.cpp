@@ -1,52 +1,247 @@
 #include "packing.h"
 
 #include <algorithm>
-#include <memory>
-#include <vector>
-
-#include <stb_rect_pack.h>
+#include <numeric>
 
 namespace Packing
 {
-    int PackRects(ivec2 target_size, Rect *data, int count, int inner_gaps, int outer_gaps)
+    // Returns rectangle indices sorted from the tallest one. Inserting them in this order keeps the skyline flat.
+    static std::vector<int> InsertionOrder(const Rect *data, int count)
+    {
+        std::vector<int> order(count);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b)
+        {
+            if (data[a].size.y != data[b].size.y)
+                return data[a].size.y > data[b].size.y;
+            return data[a].size.x > data[b].size.x;
+        });
+        return order;
+    }
+
+    Page::Page(ivec2 size, int inner_gaps, int outer_gaps) : inner_gaps(inner_gaps), outer_gaps(outer_gaps)
+    {
+        // The inner gaps are added to every rectangle, so the box is enlarged by one gap to compensate for the last rectangle in each row and column.
+        this->size = size - 2 * outer_gaps + inner_gaps;
+        Clear();
+    }
+
+    int Page::FitOnSkyline(int index, ivec2 rect_size) const
     {
-        // Adjust size.
-        target_size -= 2 * outer_gaps;
-        target_size += inner_gaps;
+        if (skyline[index].x + rect_size.x > size.x)
+            return -1;
 
-        // Make rectangle vector.
-        std::vector<stbrp_rect> rects(count);
-        for (int i = 0; i < count; i++)
+        int y = 0;
+        int width_left = rect_size.x;
+        for (int i = index; width_left > 0; i++)
         {
-            ivec2 rect_size = data[i].size + inner_gaps;
-            rects[i].w = rect_size.x;
-            rects[i].h = rect_size.y;
+            y = std::max(y, skyline[i].y);
+            if (y + rect_size.y > size.y)
+                return -1;
+            width_left -= skyline[i].width;
         }
+        return y;
+    }
 
-        // Allocate a buffer.
-        // Comments on `stb_rect_pack` say we need the amount of elements equal to target width.
-        int buffer_size = target_size.x;
-        auto packing_buffer = std::make_unique<stbrp_node[]>(buffer_size);
+    void Page::AddSkylineLevel(int index, ivec2 pos, ivec2 rect_size)
+    {
+        skyline.insert(skyline.begin() + index, Node{pos.x, pos.y + rect_size.y, rect_size.x});
 
-        // Make a context.
-        stbrp_context context;
-        stbrp_init_target(&context, target_size.x, target_size.y, packing_buffer.get(), buffer_size); // No cleanup is needed.
+        // Shrink or remove the nodes covered by the new one.
+        int end_x = pos.x + rect_size.x;
+        for (std::size_t i = index + 1; i < skyline.size();)
+        {
+            Node &node = skyline[i];
+            if (node.x >= end_x)
+                break;
 
-        // Try packing.
-        bool ok = stbrp_pack_rects(&context, rects.data(), rects.size());
+            int overlap = end_x - node.x;
+            if (overlap >= node.width)
+            {
+                skyline.erase(skyline.begin() + i);
+                continue;
+            }
 
-        // Counts rectangles that weren't packed.
-        int rects_not_packed = 0;
-        if (!ok)
-            rects_not_packed = std::count_if(rects.begin(), rects.end(), [](const stbrp_rect &rect){return !rect.was_packed;});
+            node.x += overlap;
+            node.width -= overlap;
+            break;
+        }
+
+        // Merge neighboring nodes of the same height.
+        for (std::size_t i = 0; i + 1 < skyline.size();)
+        {
+            if (skyline[i].y == skyline[i+1].y)
+            {
+                skyline[i].width += skyline[i+1].width;
+                skyline.erase(skyline.begin() + i + 1);
+                continue;
+            }
+            i++;
+        }
+    }
+
+    bool Page::Insert(Rect &rect)
+    {
+        ivec2 rect_size = rect.size + inner_gaps;
+        rect.was_packed = false;
+
+        if (rect_size.x > size.x || rect_size.y > size.y)
+            return false;
+
+        // Empty rectangles don't occupy any space.
+        if (rect_size.x <= 0 || rect_size.y <= 0)
+        {
+            rect.pos = ivec2(outer_gaps);
+            rect.was_packed = true;
+            return true;
+        }
+
+        // Try the freed regions first, picking the smallest one that fits.
+        int best_free = -1;
+        for (std::size_t i = 0; i < free_rects.size(); i++)
+        {
+            const Rect &free_rect = free_rects[i];
+            if (free_rect.size.x < rect_size.x || free_rect.size.y < rect_size.y)
+                continue;
+            if (best_free == -1 || free_rect.size.prod() < free_rects[best_free].size.prod())
+                best_free = i;
+        }
+
+        if (best_free != -1)
+        {
+            Rect free_rect = free_rects[best_free];
+            free_rects.erase(free_rects.begin() + best_free);
+
+            // Split the remaining L-shaped space into two rectangles, cutting along the shorter leftover side.
+            ivec2 leftover = free_rect.size - rect_size;
+            Rect right, bottom;
+            if (leftover.x < leftover.y)
+            {
+                right.pos = free_rect.pos.add_x(rect_size.x);
+                right.size = ivec2(leftover.x, rect_size.y);
+                bottom.pos = free_rect.pos.add_y(rect_size.y);
+                bottom.size = ivec2(free_rect.size.x, leftover.y);
+            }
+            else
+            {
+                right.pos = free_rect.pos.add_x(rect_size.x);
+                right.size = ivec2(leftover.x, free_rect.size.y);
+                bottom.pos = free_rect.pos.add_y(rect_size.y);
+                bottom.size = ivec2(rect_size.x, leftover.y);
+            }
+            if (right.size.x > 0 && right.size.y > 0)
+                free_rects.push_back(right);
+            if (bottom.size.x > 0 && bottom.size.y > 0)
+                free_rects.push_back(bottom);
+
+            rect.pos = free_rect.pos + outer_gaps;
+            rect.was_packed = true;
+            used_area += rect_size.prod();
+            return true;
+        }
+
+        // Bottom-left heuristic: pick the lowest position, then the leftmost one.
+        int best_index = -1;
+        ivec2 best_pos;
+        for (std::size_t i = 0; i < skyline.size(); i++)
+        {
+            int y = FitOnSkyline(i, rect_size);
+            if (y == -1)
+                continue;
+            if (best_index == -1 || y < best_pos.y)
+            {
+                best_index = i;
+                best_pos = ivec2(skyline[i].x, y);
+            }
+        }
 
-        // Output data.
-        for (int i = 0; i < count; i++)
+        if (best_index == -1)
+            return false;
+
+        AddSkylineLevel(best_index, best_pos, rect_size);
+
+        rect.pos = best_pos + outer_gaps;
+        rect.was_packed = true;
+        used_area += rect_size.prod();
+        return true;
+    }
+
+    void Page::Free(ivec2 pos, ivec2 rect_size)
+    {
+        Rect free_rect;
+        free_rect.pos = pos - outer_gaps;
+        free_rect.size = rect_size + inner_gaps;
+        if (free_rect.size.x <= 0 || free_rect.size.y <= 0)
+            return;
+        used_area -= free_rect.size.prod();
+        free_rects.push_back(free_rect);
+    }
+
+    void Page::Clear()
+    {
+        skyline.clear();
+        skyline.push_back(Node{0, 0, size.x});
+        free_rects.clear();
+        used_area = 0;
+    }
+
+
+    bool MultiPagePacker::Insert(Rect &rect)
+    {
+        for (std::size_t i = 0; i < pages.size(); i++)
         {
-            data[i].pos = ivec2(rects[i].x, rects[i].y) + outer_gaps;
-            data[i].was_packed = rects[i].was_packed;
+            if (pages[i].Insert(rect))
+            {
+                rect.page = i;
+                return true;
+            }
         }
 
+        Page &new_page = pages.emplace_back(page_size, inner_gaps, outer_gaps);
+        if (!new_page.Insert(rect))
+        {
+            // The rectangle is larger than a page, don't keep the empty page.
+            pages.pop_back();
+            return false;
+        }
+        rect.page = pages.size() - 1;
+        return true;
+    }
+
+    int MultiPagePacker::Insert(Rect *data, int count)
+    {
+        std::vector<int> order = InsertionOrder(data, count);
+
+        int rects_not_packed = 0;
+        for (int index : order)
+        {
+            if (!Insert(data[index]))
+                rects_not_packed++;
+        }
+        return rects_not_packed;
+    }
+
+    void MultiPagePacker::Free(const Rect &rect)
+    {
+        if (!rect.was_packed || rect.page < 0 || rect.page >= int(pages.size()))
+            return;
+        pages[rect.page].Free(rect.pos, rect.size);
+    }
+
+
+    int PackRects(ivec2 target_size, Rect *data, int count, int inner_gaps, int outer_gaps)
+    {
+        Page page(target_size, inner_gaps, outer_gaps);
+
+        std::vector<int> order = InsertionOrder(data, count);
+
+        int rects_not_packed = 0;
+        for (int index : order)
+        {
+            data[index].page = 0;
+            if (!page.Insert(data[index]))
+                rects_not_packed++;
+        }
         return rects_not_packed;
     }
 }
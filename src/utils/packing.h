@@ -1,5 +1,7 @@
 #pragma once
 
+#include <vector>
+
 #include "utils/mat.h"
 
 namespace Packing
@@ -12,12 +14,75 @@ namespace Packing
         // Output:
         ivec2 pos = ivec2(0);
         bool was_packed = 0;
+        int page = 0; // Only set by `MultiPagePacker`.
 
         Rect() {}
         Rect(ivec2 size) : size(size) {}
     };
 
+    // A single box that rectangles can be inserted into one at a time, using the skyline bottom-left heuristic.
+    // Freed regions are remembered and reused by later insertions.
+    class Page
+    {
+        struct Node
+        {
+            int x = 0, y = 0, width = 0;
+        };
+
+        ivec2 size = ivec2(0); // Usable size, with the gaps already applied.
+        int inner_gaps = 0, outer_gaps = 0;
+        std::vector<Node> skyline;
+        std::vector<Rect> free_rects; // Regions released by `Free()`, in the inner coordinates.
+        long long used_area = 0;
+
+        // Returns the minimal Y the rectangle can be placed at, with its left side on the node `index`. Returns -1 if it doesn't fit there.
+        int FitOnSkyline(int index, ivec2 rect_size) const;
+        void AddSkylineLevel(int index, ivec2 pos, ivec2 rect_size);
+
+      public:
+        Page() {}
+        Page(ivec2 size, int inner_gaps = 0, int outer_gaps = 0);
+
+        [[nodiscard]] explicit operator bool() const {return skyline.size() > 0;}
+
+        // Returns false if the rectangle doesn't fit. Otherwise sets `rect.pos` and `rect.was_packed`.
+        bool Insert(Rect &rect);
+        // Releases a region previously returned by `Insert()`. Pass the same position and size.
+        void Free(ivec2 pos, ivec2 rect_size);
+        // Removes all rectangles.
+        void Clear();
+        // Returns true if a rectangle of this size fits into the page when it's empty. Larger rectangles are always rejected by `Insert()`.
+        [[nodiscard]] bool CanEverFit(ivec2 rect_size) const {return (rect_size + inner_gaps <= size).all();}
+
+        [[nodiscard]] ivec2 Size() const {return size - inner_gaps + 2 * outer_gaps;}
+        // Returns the fraction of the usable area currently occupied by rectangles (including their inner gaps).
+        [[nodiscard]] float Occupancy() const {return size.x > 0 && size.y > 0 ? used_area / float(size.prod()) : 0;}
+    };
+
+    // Packs rectangles into as many pages of the same size as needed, appending a new page when none of the existing ones has enough space.
+    class MultiPagePacker
+    {
+        ivec2 page_size = ivec2(0);
+        int inner_gaps = 0, outer_gaps = 0;
+        std::vector<Page> pages;
+
+      public:
+        MultiPagePacker() {}
+        MultiPagePacker(ivec2 page_size, int inner_gaps = 0, int outer_gaps = 0) : page_size(page_size), inner_gaps(inner_gaps), outer_gaps(outer_gaps) {}
+
+        // Returns false only if the rectangle is larger than a whole page. Otherwise sets `rect.pos`, `rect.page` and `rect.was_packed`.
+        bool Insert(Rect &rect);
+        // Returns the amount of rectangles that are too large to fit into a page.
+        // Rectangles are inserted from the tallest one, which gives tighter results than inserting them in the original order.
+        int Insert(Rect *data, int count);
+        void Free(const Rect &rect);
+        void Clear() {pages.clear();}
+
+        [[nodiscard]] ivec2 PageSize() const {return page_size;}
+        [[nodiscard]] int PageCount() const {return pages.size();}
+        [[nodiscard]] const Page &GetPage(int index) const {return pages[index];}
+    };
+
     // Returns 0 on success. On failure returns the amount of rectangles that didn't fit into the box.
-    // Note that coordinates outside of [0;65535] range are not supported by default. This can be changed in `stb_rect_pack.h`.
     int PackRects(ivec2 target_size, Rect *data, int count, int inner_gaps = 0, int outer_gaps = 0);
 }
@@ -1,44 +1,305 @@
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
 #include <map>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "utils/mat.h"
 
-template <typename T> class RangeSet
+/* A set of integers, stored as a list of non-overlapping inclusive ranges.
+ *
+ * The storage is selected by the second template parameter:
+ *   RangeSetStorage::Map    - `std::map`, the default.
+ *   RangeSetStorage::Vector - a sorted vector. Fast lookups and iteration, but each `Add()` is linear. Use it for sets that rarely change.
+ *   RangeSetStorage::BTree  - a two-level B-tree: a sorted list of small sorted blocks. Use it for large sets that change often.
+ *
+ * `Contains()` and `Add()` take logarithmic time (plus a linear memory move for `Vector`).
+ * Set operations (`+`, `&`, `-`) and `FromSorted()` take linear time, regardless of the storage.
+ */
+
+namespace RangeSetStorage
 {
-    static_assert(std::is_integral_v<T>, "The template parameter must be integral.");
+    namespace impl
+    {
+        // Returns true if the range ending at `last` is located before `value`, and doesn't touch it.
+        template <typename T> [[nodiscard]] bool IsBefore(const T &last, const T &value)
+        {
+            return last < value && last + 1 != value; // `last + 1` can't overflow here.
+        }
+        // Returns true if the range starting at `first` is located after `value`, and doesn't touch it.
+        template <typename T> [[nodiscard]] bool IsAfter(const T &first, const T &value)
+        {
+            return IsBefore(value, first);
+        }
 
-    std::map<T, T> map; // This map countains non-overlapping inclusive ranges.
-    T values = 0;
+        // Returns the number of values in a range.
+        template <typename T> [[nodiscard]] T RangeSize(const T &first, const T &last)
+        {
+            return last - first + 1; // This should work even with unsigned wraparound.
+        }
+    }
 
-    using iterator_t = typename decltype(map)::iterator;
+    // All storages hold sorted non-overlapping non-adjacent inclusive ranges.
 
-    void SetEndOfRange(iterator_t it, const T &new_end)
-    {
-        values += new_end - it->second; // This should work even with unsigned wraparound.
-        it->second = new_end;
-    }
-    void SetEndOfRangeToMax(iterator_t it, const T &new_end)
+    template <typename T> class Map
     {
-        if (new_end > it->second)
-            SetEndOfRange(it, new_end);
-    }
-    void EraseRange(iterator_t it)
+        std::map<T, T> map;
+
+      public:
+        [[nodiscard]] std::size_t Size() const
+        {
+            return map.size();
+        }
+
+        // Replaces the contents with the ranges, which must be sorted and normalized.
+        void Assign(std::vector<std::pair<T, T>> ranges)
+        {
+            map = {};
+            for (const auto &range : ranges)
+                map.emplace_hint(map.end(), range);
+        }
+
+        template <typename F> void ForEachRange(F &&func) const
+        {
+            for (const auto &[first, last] : map)
+                func(first, last);
+        }
+
+        [[nodiscard]] bool Contains(const T &value) const
+        {
+            auto it = map.upper_bound(value);
+            return it != map.begin() && std::prev(it)->second >= value;
+        }
+
+        // Inserts a range, merging it with the overlapping and adjacent ones. Returns the number of added values.
+        T Add(T first, T last)
+        {
+            auto lo = map.upper_bound(first);
+            if (lo != map.begin() && !impl::IsBefore(std::prev(lo)->second, first))
+                lo--;
+            auto hi = map.upper_bound(last);
+            if (hi != map.end() && !impl::IsAfter(hi->first, last))
+                hi++;
+
+            T removed = 0;
+            if (lo != hi)
+            {
+                first = std::min(first, lo->first);
+                last = std::max(last, std::prev(hi)->second);
+                for (auto it = lo; it != hi; it++)
+                    removed += impl::RangeSize(it->first, it->second);
+            }
+            map.emplace_hint(map.erase(lo, hi), first, last);
+            return impl::RangeSize(first, last) - removed;
+        }
+    };
+
+    template <typename T> class Vector
     {
-        values -= it->second - it->first + 1;
-        map.erase(it);
-    }
+        std::vector<std::pair<T, T>> ranges;
 
-    void TryMergingAdjacent(iterator_t a, iterator_t &b) // Makes `b` equal to `a` if the ranges had to be merged. Note that only `b` is passed by reference.
+      public:
+        [[nodiscard]] std::size_t Size() const
+        {
+            return ranges.size();
+        }
+
+        void Assign(std::vector<std::pair<T, T>> new_ranges)
+        {
+            ranges = std::move(new_ranges);
+        }
+
+        template <typename F> void ForEachRange(F &&func) const
+        {
+            for (const auto &[first, last] : ranges)
+                func(first, last);
+        }
+
+        [[nodiscard]] bool Contains(const T &value) const
+        {
+            auto it = std::partition_point(ranges.begin(), ranges.end(), [&](const std::pair<T, T> &range){return range.second < value;});
+            return it != ranges.end() && it->first <= value;
+        }
+
+        T Add(T first, T last)
+        {
+            auto lo = std::partition_point(ranges.begin(), ranges.end(), [&](const std::pair<T, T> &range){return impl::IsBefore(range.second, first);});
+            auto hi = std::partition_point(lo, ranges.end(), [&](const std::pair<T, T> &range){return !impl::IsAfter(range.first, last);});
+
+            if (lo == hi)
+            {
+                ranges.insert(lo, {first, last});
+                return impl::RangeSize(first, last);
+            }
+
+            T removed = 0;
+            for (auto it = lo; it != hi; it++)
+                removed += impl::RangeSize(it->first, it->second);
+            *lo = {std::min(first, lo->first), std::max(last, std::prev(hi)->second)};
+            ranges.erase(lo + 1, hi);
+            return impl::RangeSize(lo->first, lo->second) - removed;
+        }
+    };
+
+    template <typename T> class BTree
     {
-        if (a->second >= b->first-1)
+        static constexpr std::size_t max_block_size = 64;
+
+        std::vector<std::vector<std::pair<T, T>>> blocks; // Those are never empty.
+        std::size_t size = 0;
+
+        // Returns the index of the first block with a range for which `pred` returns false, or `blocks.size()` if there's none.
+        template <typename F> [[nodiscard]] std::size_t FindBlock(F &&pred) const
         {
-            SetEndOfRangeToMax(a, b->second);
-            EraseRange(b);
-            b = a;
+            return std::partition_point(blocks.begin(), blocks.end(), [&](const std::vector<std::pair<T, T>> &block){return pred(block.back());}) - blocks.begin();
         }
+
+        void SplitBlockIfNeeded(std::size_t index)
+        {
+            if (blocks[index].size() <= max_block_size)
+                return;
+            std::vector<std::pair<T, T>> &block = blocks[index];
+            std::vector<std::pair<T, T>> second_half(block.begin() + block.size() / 2, block.end());
+            block.resize(block.size() / 2);
+            blocks.insert(blocks.begin() + index + 1, std::move(second_half));
+        }
+
+      public:
+        [[nodiscard]] std::size_t Size() const
+        {
+            return size;
+        }
+
+        void Assign(std::vector<std::pair<T, T>> ranges)
+        {
+            blocks = {};
+            size = ranges.size();
+            // Leave some free space in each block.
+            for (std::size_t i = 0; i < ranges.size(); i += max_block_size / 2)
+                blocks.emplace_back(ranges.begin() + i, ranges.begin() + std::min(ranges.size(), i + max_block_size / 2));
+        }
+
+        template <typename F> void ForEachRange(F &&func) const
+        {
+            for (const auto &block : blocks)
+            for (const auto &[first, last] : block)
+                func(first, last);
+        }
+
+        [[nodiscard]] bool Contains(const T &value) const
+        {
+            auto pred = [&](const std::pair<T, T> &range){return range.second < value;};
+            std::size_t block_index = FindBlock(pred);
+            if (block_index == blocks.size())
+                return false;
+            const auto &block = blocks[block_index];
+            return std::partition_point(block.begin(), block.end(), pred)->first <= value;
+        }
+
+        T Add(T first, T last)
+        {
+            auto pred_lo = [&](const std::pair<T, T> &range){return impl::IsBefore(range.second, first);};
+            auto pred_hi = [&](const std::pair<T, T> &range){return !impl::IsAfter(range.first, last);};
+
+            std::size_t lo_block = FindBlock(pred_lo);
+            if (lo_block == blocks.size())
+            {
+                // Insert after all existing ranges.
+                if (blocks.empty())
+                    blocks.emplace_back();
+                blocks.back().push_back({first, last});
+                size++;
+                SplitBlockIfNeeded(blocks.size() - 1);
+                return impl::RangeSize(first, last);
+            }
+            std::size_t lo = std::partition_point(blocks[lo_block].begin(), blocks[lo_block].end(), pred_lo) - blocks[lo_block].begin();
+
+            std::size_t hi_block = FindBlock(pred_hi);
+            std::size_t hi = hi_block == blocks.size() ? 0 : std::partition_point(blocks[hi_block].begin(), blocks[hi_block].end(), pred_hi) - blocks[hi_block].begin();
+
+            if (lo_block == hi_block && lo == hi)
+            {
+                // Nothing to merge with.
+                blocks[lo_block].insert(blocks[lo_block].begin() + lo, {first, last});
+                size++;
+                SplitBlockIfNeeded(lo_block);
+                return impl::RangeSize(first, last);
+            }
+
+            // Find the last merged range.
+            const std::pair<T, T> &last_merged = hi > 0 ? blocks[hi_block][hi - 1] : blocks[hi_block - 1].back();
+            std::pair<T, T> merged(std::min(first, blocks[lo_block][lo].first), std::max(last, last_merged.second));
+
+            T removed = 0;
+            if (lo_block == hi_block)
+            {
+                auto &block = blocks[lo_block];
+                for (std::size_t i = lo; i < hi; i++)
+                    removed += impl::RangeSize(block[i].first, block[i].second);
+                block[lo] = merged;
+                block.erase(block.begin() + lo + 1, block.begin() + hi);
+                size -= hi - lo - 1;
+                return impl::RangeSize(merged.first, merged.second) - removed;
+            }
+
+            // The merged ranges span several blocks.
+            auto &block = blocks[lo_block];
+            for (std::size_t i = lo; i < block.size(); i++)
+                removed += impl::RangeSize(block[i].first, block[i].second);
+            size -= block.size() - lo - 1;
+            block.resize(lo + 1);
+            block[lo] = merged;
+
+            if (hi_block < blocks.size()) // This block can't become empty, since it contains the range after the merged ones.
+            {
+                auto &hi_block_ranges = blocks[hi_block];
+                for (std::size_t i = 0; i < hi; i++)
+                    removed += impl::RangeSize(hi_block_ranges[i].first, hi_block_ranges[i].second);
+                size -= hi;
+                hi_block_ranges.erase(hi_block_ranges.begin(), hi_block_ranges.begin() + hi);
+            }
+
+            for (std::size_t i = lo_block + 1; i < hi_block; i++)
+            {
+                for (const auto &range : blocks[i])
+                    removed += impl::RangeSize(range.first, range.second);
+                size -= blocks[i].size();
+            }
+            blocks.erase(blocks.begin() + lo_block + 1, blocks.begin() + hi_block);
+
+            return impl::RangeSize(merged.first, merged.second) - removed;
+        }
+    };
+}
+
+template <typename T, template <typename> typename Storage = RangeSetStorage::Map> class RangeSet
+{
+    static_assert(std::is_integral_v<T>, "The template parameter must be integral.");
+
+    Storage<T> storage;
+    T values = 0;
+
+    void AssignNormalized(std::vector<std::pair<T, T>> ranges)
+    {
+        values = 0;
+        for (const auto &range : ranges)
+            values += RangeSetStorage::impl::RangeSize(range.first, range.second);
+        storage.Assign(std::move(ranges));
+    }
+
+    // Appends a range to a sorted list of normalized ranges, merging it with the last one if needed.
+    // The range must not start before the last range in the list.
+    static void AppendRange(std::vector<std::pair<T, T>> &ranges, const std::pair<T, T> &range)
+    {
+        if (ranges.size() > 0 && !RangeSetStorage::impl::IsBefore(ranges.back().second, range.first))
+            ranges.back().second = std::max(ranges.back().second, range.second);
+        else
+            ranges.push_back(range);
     }
 
   public:
@@ -57,8 +318,24 @@ template <typename T> class RangeSet
     }
     RangeSet(std::initializer_list<std::pair<T,T>> ranges)
     {
-        for (auto range : ranges)
-            Add(range);
+        *this = FromSorted(std::vector<std::pair<T, T>>(ranges));
+    }
+
+    // Constructs a set from a list of ranges in linear time. The ranges can overlap.
+    // If they're not sorted by the first value, they're sorted first, which is slower.
+    [[nodiscard]] static RangeSet FromSorted(std::vector<std::pair<T, T>> ranges)
+    {
+        if (!std::is_sorted(ranges.begin(), ranges.end(), [](const auto &a, const auto &b){return a.first < b.first;}))
+            std::sort(ranges.begin(), ranges.end());
+
+        std::vector<std::pair<T, T>> normalized;
+        normalized.reserve(ranges.size());
+        for (const auto &range : ranges)
+            AppendRange(normalized, range);
+
+        RangeSet ret;
+        ret.AssignNormalized(std::move(normalized));
+        return ret;
     }
 
     void Add(const T &value)
@@ -67,27 +344,7 @@ template <typename T> class RangeSet
     }
     void Add(const T &first, const T &last) // The range is inclusive.
     {
-        // Try inserting.
-        auto [it_cur, inserted] = map.insert({first, last});
-
-        if (inserted)
-        {
-            // Update value count.
-            values += last - first + 1;
-
-            // Check for intersections with previous range.
-            if (it_cur != map.begin())
-                TryMergingAdjacent(std::prev(it_cur), it_cur);
-        }
-        else
-        {
-            // Update end of the existing range.
-            SetEndOfRangeToMax(it_cur, last);
-        }
-
-        // Check for intersections with next range.
-        if (auto it_next = std::next(it_cur); it_next != map.end())
-            TryMergingAdjacent(it_cur, it_next);
+        values += storage.Add(first, last);
     }
     void Add(const std::pair<T,T> &range)
     {
@@ -101,13 +358,18 @@ template <typename T> class RangeSet
 
     void Clear()
     {
-        map = {};
+        storage = {};
         values = 0;
     }
 
+    [[nodiscard]] bool Contains(const T &value) const
+    {
+        return storage.Contains(value);
+    }
+
     int RangeCount() const
     {
-        return map.size();
+        return storage.Size();
     }
     T ValueCount() const
     {
@@ -116,25 +378,118 @@ template <typename T> class RangeSet
 
     template <typename F> void ForEachRange(F &&func/* void(const T &begin, const T &end) */) const // Both ends of ranges are inclusive.
     {
-        for (auto [begin, end] : map)
-            func(begin, end);
+        storage.ForEachRange(func);
     }
     template <typename F> void ForEachValue(F &&func/* void(const T &value) */) const
     {
-        for (auto [begin, end] : map)
-        for (auto it = begin; it <= end; it++)
-            func(it);
+        storage.ForEachRange([&](const T &begin, const T &end)
+        {
+            T it = begin;
+            while (1)
+            {
+                func(it);
+                if (it == end) // Checking this before incrementing prevents an overflow if `end` is the max value.
+                    break;
+                it++;
+            }
+        });
     }
 
-    [[nodiscard]] RangeSet operator+(const RangeSet &other) const
+    // Returns the ranges in order.
+    [[nodiscard]] std::vector<std::pair<T, T>> Ranges() const
     {
-        RangeSet ret = *this;
-        ret += other;
+        std::vector<std::pair<T, T>> ret;
+        ret.reserve(storage.Size());
+        storage.ForEachRange([&](const T &first, const T &last){ret.emplace_back(first, last);});
         return ret;
     }
-    RangeSet &operator+=(const RangeSet &other)
+
+    // Union.
+    template <template <typename> typename S> [[nodiscard]] RangeSet operator+(const RangeSet<T, S> &other) const
+    {
+        std::vector<std::pair<T, T>> a = Ranges(), b = other.Ranges(), ret;
+        ret.reserve(a.size() + b.size());
+        auto it_a = a.begin(), it_b = b.begin();
+        while (it_a != a.end() || it_b != b.end())
+        {
+            if (it_b == b.end() || (it_a != a.end() && it_a->first < it_b->first))
+                AppendRange(ret, *it_a++);
+            else
+                AppendRange(ret, *it_b++);
+        }
+
+        RangeSet set;
+        set.AssignNormalized(std::move(ret));
+        return set;
+    }
+    template <template <typename> typename S> RangeSet &operator+=(const RangeSet<T, S> &other)
+    {
+        *this = *this + other;
+        return *this;
+    }
+
+    // Intersection.
+    template <template <typename> typename S> [[nodiscard]] RangeSet operator&(const RangeSet<T, S> &other) const
+    {
+        std::vector<std::pair<T, T>> a = Ranges(), b = other.Ranges(), ret;
+        auto it_a = a.begin(), it_b = b.begin();
+        while (it_a != a.end() && it_b != b.end())
+        {
+            T first = std::max(it_a->first, it_b->first);
+            T last = std::min(it_a->second, it_b->second);
+            if (first <= last)
+                ret.emplace_back(first, last); // This can't be adjacent to the previous range, since the source ranges aren't adjacent.
+            if (it_a->second < it_b->second)
+                it_a++;
+            else
+                it_b++;
+        }
+
+        RangeSet set;
+        set.AssignNormalized(std::move(ret));
+        return set;
+    }
+    template <template <typename> typename S> RangeSet &operator&=(const RangeSet<T, S> &other)
+    {
+        *this = *this & other;
+        return *this;
+    }
+
+    // Difference.
+    template <template <typename> typename S> [[nodiscard]] RangeSet operator-(const RangeSet<T, S> &other) const
+    {
+        std::vector<std::pair<T, T>> a = Ranges(), b = other.Ranges(), ret;
+        auto it_b = b.begin();
+        for (auto [first, last] : a)
+        {
+            // Skip the ranges that end before this one.
+            while (it_b != b.end() && it_b->second < first)
+                it_b++;
+
+            bool empty = false;
+            // Cut the ranges that start inside of this one.
+            for (auto it = it_b; it != b.end() && it->first <= last; it++)
+            {
+                if (it->first > first)
+                    ret.emplace_back(first, it->first - 1);
+                if (it->second >= last)
+                {
+                    empty = true;
+                    break;
+                }
+                first = it->second + 1; // This can't overflow, since `it->second < last`.
+            }
+            if (!empty)
+                ret.emplace_back(first, last);
+        }
+
+        RangeSet set;
+        set.AssignNormalized(std::move(ret));
+        return set;
+    }
+    template <template <typename> typename S> RangeSet &operator-=(const RangeSet<T, S> &other)
     {
-        for (auto range : other.map)
-            Add(range.first, range.second);
+        *this = *this - other;
+        return *this;
     }
 };
@@ -1,20 +1,138 @@
 #pragma once
 
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
 #include <iomanip>
+#include <limits>
 #include <string>
 #include <string_view>
 #include <sstream>
+#include <type_traits>
 #include <utility>
 
 #include "utils/unicode.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace Strings
 {
+    namespace impl
+    {
+        // Types that `Str()` can append without a stream. Other types (including stream manipulators) make it fall back to `std::ostringstream`.
+        template <typename T> inline constexpr bool is_char = std::is_same_v<T, char> || std::is_same_v<T, signed char> || std::is_same_v<T, unsigned char>;
+        template <typename T> inline constexpr bool is_string = std::is_convertible_v<const T &, std::string_view> && !std::is_pointer_v<T>;
+        template <typename T> inline constexpr bool is_char_pointer = std::is_same_v<T, const char *> || std::is_same_v<T, char *>;
+        template <typename T> inline constexpr bool is_wide_char = std::is_same_v<T, wchar_t> || std::is_same_v<T, char16_t> || std::is_same_v<T, char32_t>;
+        template <typename T> inline constexpr bool is_fast_str_type = is_char<T> || is_string<T> || is_char_pointer<T> || (std::is_arithmetic_v<T> && !is_wide_char<T>);
+
+        // Collects the output of `Str()`. It starts on the stack, and moves to the heap only if the result is long.
+        // Results up to 256 bytes are then allocated once with the exact size, and ones that fit into the small string buffer aren't allocated at all.
+        class StrBuffer
+        {
+            char stack_buffer[256];
+            std::size_t stack_size = 0;
+            std::string heap_buffer;
+            bool on_heap = false;
+
+          public:
+            void Append(const char *data, std::size_t size)
+            {
+                if (!on_heap)
+                {
+                    if (size <= sizeof stack_buffer - stack_size)
+                    {
+                        std::memcpy(stack_buffer + stack_size, data, size);
+                        stack_size += size;
+                        return;
+                    }
+                    heap_buffer.reserve(stack_size + size + sizeof stack_buffer); // Leave some space for the remaining parameters.
+                    heap_buffer.assign(stack_buffer, stack_size);
+                    on_heap = true;
+                }
+                heap_buffer.append(data, size);
+            }
+
+            void Append(char ch)
+            {
+                if (!on_heap && stack_size < sizeof stack_buffer)
+                    stack_buffer[stack_size++] = ch;
+                else
+                    Append(&ch, 1);
+            }
+
+            // Calls `func(begin, end)`, which should write at most `N` bytes starting from `begin` and return the end pointer.
+            template <std::size_t N, typename F> void AppendWith(F &&func)
+            {
+                if (!on_heap && N <= sizeof stack_buffer - stack_size)
+                {
+                    stack_size = func(stack_buffer + stack_size, stack_buffer + sizeof stack_buffer) - stack_buffer;
+                    return;
+                }
+                char str[N];
+                Append(str, func(str, str + N) - str);
+            }
+
+            [[nodiscard]] std::string Take()
+            {
+                if (on_heap)
+                    return std::move(heap_buffer);
+                return std::string(stack_buffer, stack_size);
+            }
+        };
+
+        template <typename T> void StrAppend(StrBuffer &buffer, const T &param)
+        {
+            if constexpr (is_char<T>)
+            {
+                buffer.Append(char(param));
+            }
+            else if constexpr (std::is_same_v<T, bool>)
+            {
+                buffer.Append(param ? '1' : '0'); // Same as `std::ostream` without `std::boolalpha`.
+            }
+            else if constexpr (is_string<T>)
+            {
+                std::string_view view = param;
+                buffer.Append(view.data(), view.size());
+            }
+            else if constexpr (is_char_pointer<T>)
+            {
+                if (param)
+                    buffer.Append(param, std::strlen(param));
+            }
+            else
+            {
+                buffer.AppendWith<64>([&](char *begin, char *end)
+                {
+                    if constexpr (std::is_integral_v<T>)
+                        return std::to_chars(begin, end, param).ptr;
+                    else
+                        return std::to_chars(begin, end, param, std::chars_format::general, 6).ptr; // Same as `std::ostream` with the default precision.
+                });
+            }
+        }
+    }
+
+    // Concatenates string representations of the parameters, as if by `std::ostringstream`.
+    // Strings, characters and numbers are formatted without a stream, into a stack buffer. If any other types (or manipulators) are present, the stream is used for everything.
     template <typename ...P> [[nodiscard]] std::string Str(const P &... params)
     {
-        std::ostringstream stream;
-        (stream << ... << params);
-        return stream.str();
+        if constexpr ((impl::is_fast_str_type<P> && ...))
+        {
+            impl::StrBuffer buffer;
+            (impl::StrAppend(buffer, params), ...);
+            return buffer.Take();
+        }
+        else
+        {
+            std::ostringstream stream;
+            (stream << ... << params);
+            return stream.str();
+        }
     }
 
     [[nodiscard]] inline std::string_view Trim(std::string_view str)
@@ -55,48 +173,94 @@ namespace Strings
         }
     };
 
+    // Returns the line and column of `symbol`. `\r\n` and `\n\r` count as a single line end.
+    // If `use_unicode` is true, columns are counted in characters (as in `Unicode::Iterator`), otherwise in bytes.
     [[nodiscard]] inline SymbolPosition GetSymbolPosition(const char *start, const char *symbol, UseUnicode use_unicode = UseUnicode(1))
     {
         // For extra safety, we swap the pointers if they're ordered incorrectly.
         if (symbol < start)
             std::swap(symbol, start);
 
+        // A character cut off by `symbol` swallows the remaining bytes, including line ends. See `Unicode::Decode()`.
+        const char *lines_end = symbol;
+        if (bool(use_unicode))
+        {
+            for (const char *ptr = symbol - std::min(symbol - start, std::ptrdiff_t(3)); ptr < symbol; ptr++)
+            {
+                if (Unicode::CharacterLength(*ptr) > symbol - ptr)
+                {
+                    lines_end = ptr;
+                    break;
+                }
+            }
+        }
+
         SymbolPosition ret;
         ret.line = 1;
-        ret.column = 1;
-        std::uint32_t prev_line_end = 0;
 
-        auto lambda = [&](std::uint32_t ch)
+        const char *line_start = start;
+        char prev_line_end = 0;
+
+        auto lambda = [&](const char *ptr)
         {
-            if (ch != '\n' && ch != '\r')
-            {
-                ret.column++;
-                prev_line_end = 0;
-                return;
-            }
+            if (ptr != line_start)
+                prev_line_end = 0; // There's something between this line end and the previous one.
 
-            if (prev_line_end != 0 && ch != prev_line_end)
+            if (prev_line_end != 0 && *ptr != prev_line_end)
+                prev_line_end = 0; // Skip a second byte of a line end.
+            else
             {
-                prev_line_end = 0;
-                return; // Skip a second byte of a line end.
+                prev_line_end = *ptr;
+                ret.line++;
             }
 
-            prev_line_end = ch;
-            ret.line++;
-            ret.column = 1;
+            line_start = ptr + 1;
         };
 
-        if (bool(use_unicode))
+        const char *cur = start;
+
+        #if defined(__SSE2__)
+        for (; lines_end - cur >= 16; cur += 16)
         {
-            for (std::uint32_t ch : Unicode::Iterator(start, symbol))
-                lambda(ch);
+            __m128i chunk = _mm_loadu_si128((const __m128i *)cur);
+            unsigned int lf = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')));
+            unsigned int cr = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')));
+            if ((lf | cr) == 0)
+                continue;
+
+            if ((cr == 0 && prev_line_end != '\r') || (lf == 0 && prev_line_end != '\n'))
+            {
+                // Only one kind of line ends, each one is counted.
+                ret.line += __builtin_popcount(lf | cr);
+                prev_line_end = lf ? '\n' : '\r';
+                line_start = cur + 32 - __builtin_clz(lf | cr);
+            }
+            else if (lf == cr << 1 && !(cr & 1 && line_start == cur && prev_line_end == '\n'))
+            {
+                // Only `\r\n` pairs.
+                ret.line += __builtin_popcount(cr);
+                prev_line_end = 0;
+                line_start = cur + 32 - __builtin_clz(lf);
+            }
+            else
+            {
+                for (unsigned int mask = lf | cr; mask; mask &= mask - 1)
+                    lambda(cur + __builtin_ctz(mask));
+            }
         }
-        else
+        #endif
+
+        for (; cur < lines_end; cur++)
         {
-            for (const char *ptr = start; ptr < symbol; ptr++)
-                lambda((unsigned char)*ptr);
+            if (*cur == '\n' || *cur == '\r')
+                lambda(cur);
         }
 
+        if (bool(use_unicode))
+            ret.column = 1 + Unicode::CountCharacters(line_start, symbol);
+        else
+            ret.column = 1 + (symbol - line_start);
+
         return ret;
     }
 }
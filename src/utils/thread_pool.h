@@ -0,0 +1,199 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/* A fixed-size pool of worker threads.
+ *
+ * Example usage:
+ *
+ *     ThreadPool pool; // Uses one thread per core.
+ *     std::future<int> result = pool.Submit([]{return 42;});
+ *
+ *     std::vector<Image> images(file_names.size());
+ *     pool.ForEach(file_names.size(), [&](int i){images[i] = Image(file_names[i]);});
+ *
+ * `ForEach()` never queues more than one job per thread, so the amount of work in flight is bounded by the thread count.
+ */
+
+class ThreadPool
+{
+    struct Data
+    {
+        std::vector<std::thread> threads;
+        std::deque<std::function<void()>> queue;
+        std::mutex mutex;
+        std::condition_variable condvar;
+        bool stopping = false;
+    };
+    std::unique_ptr<Data> data;
+
+    static void WorkerLoop(Data &data)
+    {
+        while (true)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock lock(data.mutex);
+                data.condvar.wait(lock, [&]{return data.stopping || !data.queue.empty();});
+                if (data.queue.empty())
+                    return; // We're stopping and there's nothing left to do.
+                job = std::move(data.queue.front());
+                data.queue.pop_front();
+            }
+            job();
+        }
+    }
+
+    void Enqueue(std::function<void()> job)
+    {
+        {
+            std::lock_guard lock(data->mutex);
+            data->queue.push_back(std::move(job));
+        }
+        data->condvar.notify_one();
+    }
+
+  public:
+    ThreadPool(decltype(nullptr)) {}
+
+    ThreadPool(int thread_count = 0) // If `thread_count <= 0`, one thread per core is used.
+    {
+        if (thread_count <= 0)
+            thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+        data = std::make_unique<Data>();
+        data->threads.reserve(thread_count);
+        for (int i = 0; i < thread_count; i++)
+            data->threads.emplace_back(WorkerLoop, std::ref(*data));
+    }
+
+    ThreadPool(ThreadPool &&other) noexcept : data(std::move(other.data)) {}
+    ThreadPool &operator=(ThreadPool other) noexcept
+    {
+        std::swap(data, other.data);
+        return *this;
+    }
+
+    ~ThreadPool() // Finishes all queued jobs before returning.
+    {
+        if (!data)
+            return;
+
+        {
+            std::lock_guard lock(data->mutex);
+            data->stopping = true;
+        }
+        data->condvar.notify_all();
+        for (std::thread &thread : data->threads)
+            thread.join();
+    }
+
+    explicit operator bool() const
+    {
+        return bool(data);
+    }
+
+    int ThreadCount() const
+    {
+        return data ? data->threads.size() : 0;
+    }
+
+    // A lazily constructed pool with one thread per core.
+    [[nodiscard]] static ThreadPool &Global()
+    {
+        static ThreadPool ret;
+        return ret;
+    }
+
+    // Runs `func()` on one of the worker threads. Exceptions are propagated through the returned future.
+    template <typename F> [[nodiscard]] std::future<std::invoke_result_t<F &>> Submit(F &&func)
+    {
+        using R = std::invoke_result_t<F &>;
+        // `std::function` needs a copyable functor, so the task is stored on the heap.
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(func));
+        std::future<R> ret = task->get_future();
+        Enqueue([task]{(*task)();});
+        return ret;
+    }
+
+    // Calls `func(i)` for each `i` in `[0; count)`, using the worker threads and the calling thread. Blocks until all calls finish.
+    // If some of the calls throw, the remaining indices are skipped and the first exception is rethrown.
+    // It's safe to call this from a worker thread, since the calling thread processes the indices itself if no workers are available.
+    template <typename F> void ForEach(int count, F &&func)
+    {
+        if (count <= 0)
+            return;
+
+        // Late helpers may outlive this call, so the shared state is reference-counted.
+        struct State
+        {
+            std::atomic<int> next_index = 0;
+            int count = 0;
+            int active_helpers = 0;
+            std::exception_ptr exception;
+            std::mutex mutex;
+            std::condition_variable condvar;
+        };
+        auto state = std::make_shared<State>();
+        state->count = count;
+
+        // Returns after the indices run out. `func` is only accessed while `next_index < count`, so it's never used after `ForEach()` returns.
+        auto process = [](State &state, F &func)
+        {
+            int index;
+            while ((index = state.next_index++) < state.count)
+            {
+                try
+                {
+                    func(index);
+                }
+                catch (...)
+                {
+                    std::lock_guard lock(state.mutex);
+                    if (!state.exception)
+                        state.exception = std::current_exception();
+                    state.next_index = state.count;
+                }
+            }
+        };
+
+        int helper_count = std::min(ThreadCount(), count - 1);
+        for (int i = 0; i < helper_count; i++)
+        {
+            Enqueue([state, &func, process]
+            {
+                {
+                    std::lock_guard lock(state->mutex);
+                    if (state->next_index >= state->count)
+                        return; // We're too late, `func` might no longer exist.
+                    state->active_helpers++;
+                }
+                process(*state, func);
+                {
+                    std::lock_guard lock(state->mutex);
+                    state->active_helpers--;
+                }
+                state->condvar.notify_all();
+            });
+        }
+
+        process(*state, func);
+
+        std::unique_lock lock(state->mutex);
+        state->condvar.wait(lock, [&]{return state->active_helpers == 0;});
+        if (state->exception)
+            std::rethrow_exception(state->exception);
+    }
+};
@@ -6,6 +6,10 @@
 #include <string>
 #include <string_view>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace Unicode
 {
     using std::uint32_t;
@@ -35,7 +39,7 @@ namespace Unicode
     {
         do
             data++;
-        while (data == end || !IsFirstByte(*data));
+        while (data != end && !IsFirstByte(*data));
 
         return data;
     }
@@ -116,6 +120,188 @@ namespace Unicode
     }
 
 
+    namespace impl
+    {
+        // Bit masks describing a block of 64 bytes. Bit `i` corresponds to byte `i`.
+        struct ByteMasks
+        {
+            std::uint64_t continuation = 0; // 10xxxxxx
+            std::uint64_t lead2 = 0; // 11xxxxxx, first bytes of characters that have at least 2 bytes.
+            std::uint64_t lead3 = 0; // 111xxxxx, at least 3 bytes.
+            std::uint64_t lead4 = 0; // 1111xxxx, 4 bytes.
+            std::uint64_t invalid = 0; // 11111xxx, never valid.
+            std::uint64_t special = 0; // First bytes that need extra checks to reject overlong encodings, surrogates and too large values: C0, C1, E0, ED, F0, F4 and larger.
+        };
+
+        #if defined(__SSE2__)
+        [[nodiscard]] inline __m128i GreaterOrEqual(__m128i x, unsigned char value) // Unsigned comparison.
+        {
+            return _mm_cmpeq_epi8(_mm_max_epu8(x, _mm_set1_epi8(value)), x);
+        }
+        [[nodiscard]] inline std::uint64_t Mask(__m128i x)
+        {
+            return (unsigned int)_mm_movemask_epi8(x);
+        }
+        #endif
+
+        [[nodiscard]] inline ByteMasks GetByteMasks(const char *data)
+        {
+            ByteMasks ret;
+
+            #if defined(__SSE2__)
+            for (int i = 0; i < 64; i += 16)
+            {
+                __m128i x = _mm_loadu_si128((const __m128i *)(data + i));
+                ret.continuation |= Mask(_mm_cmpeq_epi8(_mm_and_si128(x, _mm_set1_epi8(char(0xc0))), _mm_set1_epi8(char(0x80)))) << i;
+                ret.lead2 |= Mask(GreaterOrEqual(x, 0xc0)) << i;
+                ret.lead3 |= Mask(GreaterOrEqual(x, 0xe0)) << i;
+                ret.lead4 |= Mask(GreaterOrEqual(x, 0xf0)) << i;
+                ret.invalid |= Mask(GreaterOrEqual(x, 0xf8)) << i;
+                __m128i special = _mm_or_si128(_mm_cmpeq_epi8(_mm_and_si128(x, _mm_set1_epi8(char(0xfe))), _mm_set1_epi8(char(0xc0))), GreaterOrEqual(x, 0xf4));
+                special = _mm_or_si128(special, _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(char(0xe0))), _mm_cmpeq_epi8(x, _mm_set1_epi8(char(0xed)))));
+                special = _mm_or_si128(special, _mm_cmpeq_epi8(x, _mm_set1_epi8(char(0xf0))));
+                ret.special |= Mask(special) << i;
+            }
+            #else
+            for (int i = 0; i < 64; i++)
+            {
+                unsigned char byte = data[i];
+                std::uint64_t bit = std::uint64_t(1) << i;
+                if ((byte & 0xc0) == 0x80) ret.continuation |= bit;
+                if (byte >= 0xc0) ret.lead2 |= bit;
+                if (byte >= 0xe0) ret.lead3 |= bit;
+                if (byte >= 0xf0) ret.lead4 |= bit;
+                if (byte >= 0xf8) ret.invalid |= bit;
+                if (byte == 0xc0 || byte == 0xc1 || byte == 0xe0 || byte == 0xed || byte == 0xf0 || byte >= 0xf4) ret.special |= bit;
+            }
+            #endif
+
+            return ret;
+        }
+
+        // Returns a mask of bytes that break the UTF-8 structure: missing or unexpected continuation bytes, and invalid first bytes.
+        // Assumes that no character starts before the block. Sets `crosses_end` if the last character continues past the block.
+        [[nodiscard]] inline std::uint64_t StructureErrors(const ByteMasks &masks, bool &crosses_end)
+        {
+            std::uint64_t expected_continuation = masks.lead2 << 1 | masks.lead3 << 2 | masks.lead4 << 3;
+            crosses_end = (masks.lead2 >> 63 | masks.lead3 >> 62 | masks.lead4 >> 61) != 0;
+            return (expected_continuation ^ masks.continuation) | masks.invalid;
+        }
+
+        // Returns the length of the valid part of the block, stopping before a character that crosses its end.
+        [[nodiscard]] inline int WholeCharactersLength(const ByteMasks &masks, bool crosses_end)
+        {
+            if (!crosses_end)
+                return 64;
+            return 63 - __builtin_clzll(~masks.continuation); // The position of the last first byte.
+        }
+
+        // Returns the length of a valid character, or 0 if it's invalid, overlong, a surrogate, or larger than 0x10ffff.
+        [[nodiscard]] inline int ValidCharacterLength(const char *data, const char *end)
+        {
+            int len = CharacterLength(*data);
+            if (len == 0 || end - data < len)
+                return 0;
+            if (len == 1)
+                return 1;
+
+            uint32_t ch = (unsigned char)*data & (0xff >> len);
+            for (int i = 1; i < len; i++)
+            {
+                if (IsFirstByte(data[i]))
+                    return 0;
+                ch = ch << 6 | ((unsigned char)data[i] & 0b0011'1111);
+            }
+
+            static constexpr uint32_t min_values[] = {0, 0, 0x80, 0x800, 0x10000};
+            if (ch < min_values[len] || ch > 0x10ffff || (ch >= 0xd800 && ch <= 0xdfff))
+                return 0;
+            return len;
+        }
+    }
+
+    // Returns true if the range is valid UTF-8: no invalid bytes, no overlong encodings, no surrogates, and nothing above 0x10ffff.
+    // Processes 64 bytes at a time, falling back to per-character checks only for blocks with rare first bytes.
+    [[nodiscard]] inline bool IsValid(const char *begin, const char *end)
+    {
+        const char *cur = begin;
+        while (end - cur >= 64)
+        {
+            impl::ByteMasks masks = impl::GetByteMasks(cur);
+            bool crosses_end = false;
+            if ((impl::StructureErrors(masks, crosses_end) | masks.special) == 0)
+            {
+                cur += impl::WholeCharactersLength(masks, crosses_end);
+                continue;
+            }
+
+            const char *block_end = cur + 64;
+            while (cur < block_end)
+            {
+                int len = impl::ValidCharacterLength(cur, end);
+                if (len == 0)
+                    return false;
+                cur += len;
+            }
+        }
+
+        while (cur < end)
+        {
+            int len = impl::ValidCharacterLength(cur, end);
+            if (len == 0)
+                return false;
+            cur += len;
+        }
+        return true;
+    }
+    [[nodiscard]] inline bool IsValid(std::string_view str)
+    {
+        return IsValid(str.data(), str.data() + str.size());
+    }
+
+    // Returns the number of characters in the range. This is always the same as the number of iterations of `Iterator(begin, end)`,
+    // so each invalid sequence counts as one character, as if it was decoded to `default_char`.
+    [[nodiscard]] inline std::size_t CountCharacters(const char *begin, const char *end)
+    {
+        std::size_t ret = 0;
+        const char *cur = begin;
+        while (end - cur >= 64)
+        {
+            impl::ByteMasks masks = impl::GetByteMasks(cur);
+            bool crosses_end = false;
+            if (impl::StructureErrors(masks, crosses_end) == 0)
+            {
+                // In valid UTF-8 every character has exactly one first byte.
+                int len = impl::WholeCharactersLength(masks, crosses_end);
+                std::uint64_t first_bytes = ~masks.continuation;
+                if (len < 64)
+                    first_bytes &= (std::uint64_t(1) << len) - 1;
+                ret += __builtin_popcountll(first_bytes);
+                cur += len;
+                continue;
+            }
+
+            const char *block_end = cur + 64;
+            while (cur < block_end)
+            {
+                Decode(cur, end, &cur);
+                ret++;
+            }
+        }
+
+        while (cur < end)
+        {
+            Decode(cur, end, &cur);
+            ret++;
+        }
+        return ret;
+    }
+    [[nodiscard]] inline std::size_t CountCharacters(std::string_view str)
+    {
+        return CountCharacters(str.data(), str.data() + str.size());
+    }
+
+
     class Iterator
     {
         const char *cur = 0;
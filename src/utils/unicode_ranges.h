@@ -10,7 +10,7 @@ namespace Unicode
     using std::uint32_t;
 
     using CharRange = std::pair<uint32_t, uint32_t>;
-    using CharSet   = RangeSet<uint32_t>;
+    using CharSet   = RangeSet<uint32_t, RangeSetStorage::Vector>; // Those are built once and then only iterated over.
 
     namespace Ranges
     {